@@ -39,6 +39,10 @@ typedef	struct prng {
     char		shared;		/* FALSE if independent sequence */
 } prng;
 
+/* A 64-bit hash of the state of a game.
+ */
+typedef unsigned long long statehash;
+
 /*
  * Definitions used in game play.
  */
@@ -200,6 +204,7 @@ typedef	struct gamesetup {
 #define	SGF_HASPASSWD		0x0001	/* player knows the level's password */
 #define	SGF_REPLACEABLE		0x0002	/* solution is marked as replaceable */
 #define	SGF_SETNAME		0x0004	/* internal to solution.c */
+#define	SGF_UNSAVED		0x0008	/* changed since last saved to file */
 
 /* A structure for storing a message text.
  */
@@ -218,14 +223,19 @@ typedef	struct gameseries {
     int			ruleset;	/* the ruleset for the game file */
     int			gsflags;	/* series flags (see below) */
     gamesetup	       *games;		/* the array of levels */
+    int		       *levelindex;	/* hash index of the levels */
+    int			indexsize;	/* no. of buckets in said index */
     fileinfo		mapfile;	/* the file containing the levels */
     char	       *mapfilename;	/* the name of said file */
+    unsigned char      *mapdata;	/* said file mapped into memory */
+    unsigned long	mapsize;	/* the size of the mapping */
     fileinfo		savefile;	/* the file holding the solutions */
     char	       *savefilename;	/* non-default name for said file */
     taggedtext	       *messages;	/* the set of tagged messages */
     char	       *msgfilename;	/* the file providing the messages */
     int			currentlevel;	/* most recently visited level no. */
     int			solheadersize;	/* size of extra solution header */
+    int			solappended;	/* solutions appended to file */
     char		filebase[256];	/* the level set's filename */
     char		name[256];	/* the filename minus any path */
     unsigned char	solheader[256];	/* extra solution header bytes */
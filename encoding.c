@@ -7,6 +7,8 @@
 #include	<stdio.h>
 #include	<stdlib.h>
 #include	<string.h>
+#include	<stddef.h>
+#include	<pthread.h>
 #include	"defs.h"
 #include	"state.h"
 #include	"err.h"
@@ -305,11 +307,164 @@ static int expandmsdatlevel(gamestate *state)
     return FALSE;
 }
 
-/* Exported interface.
+/*
+ * The cache of decoded levels.
+ */
+
+/* The part of the gamestate that is filled in from the level data:
+ * the fields from trapcount through map, which are copied as a single
+ * block.
+ */
+#define	TEMPLATE_START	offsetof(gamestate, trapcount)
+#define	TEMPLATE_SIZE	(offsetof(gamestate, maphash) - TEMPLATE_START)
+
+/* The number of hash buckets used to find the cached levels.
+ */
+#define	TEMPLATE_BUCKETS	256
+
+/* The default memory limit of the cache.
+ */
+#define	LEVELCACHE_DEFAULT	(8L * 1024 * 1024)
+
+/* A level as it was decoded into the gamestate. A copy of the level
+ * data follows the structure in memory, so that levels whose data
+ * merely has the same hash value are not confused.
+ */
+typedef	struct leveltemplate {
+    struct leveltemplate *next;		/* the next template in the bucket */
+    unsigned long	hash;		/* the level data's hash value */
+    unsigned long	lastused;	/* when the template was last used */
+    int			size;		/* the size of the level data */
+    short		chipsneeded;	/* the number of chips needed */
+    short		badtiles;	/* TRUE if the map has bad tiles */
+    unsigned char	decoded[TEMPLATE_SIZE];	/* the decoded fields */
+} leveltemplate;
+
+/* The cached levels, shared by every thread.
+ */
+static leveltemplate   *templates[TEMPLATE_BUCKETS];
+static long		templatememory = 0;
+static long		templatebudget = LEVELCACHE_DEFAULT;
+static unsigned long	templateclock = 0;
+static unsigned long	templatehits = 0;
+static unsigned long	templatemisses = 0;
+static pthread_mutex_t	templatelock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Remove the least recently used template from the cache. FALSE is
+ * returned if the cache is empty. The caller must hold the lock.
+ */
+static int droptemplate(void)
+{
+    leveltemplate      **oldest = NULL;
+    leveltemplate      **pt;
+    leveltemplate       *t;
+    int			n;
+
+    for (n = 0 ; n < TEMPLATE_BUCKETS ; ++n)
+	for (pt = templates + n ; *pt ; pt = &(*pt)->next)
+	    if (!oldest || (*pt)->lastused < (*oldest)->lastused)
+		oldest = pt;
+    if (!oldest)
+	return FALSE;
+    t = *oldest;
+    *oldest = t->next;
+    templatememory -= sizeof *t + t->size;
+    free(t);
+    return TRUE;
+}
+
+/* Fill in the gamestate from a cached copy of the level, if there is
+ * one. FALSE is returned if the level is not in the cache.
+ */
+static int gettemplate(gamestate *state)
+{
+    gamesetup const    *setup = state->game;
+    leveltemplate      *t;
+
+    pthread_mutex_lock(&templatelock);
+    for (t = templates[setup->levelhash % TEMPLATE_BUCKETS] ; t ; t = t->next)
+	if (t->hash == setup->levelhash && t->size == setup->levelsize
+			&& !memcmp(t + 1, setup->leveldata, t->size))
+	    break;
+    if (t) {
+	memcpy((char*)state + TEMPLATE_START, t->decoded, TEMPLATE_SIZE);
+	state->chipsneeded = t->chipsneeded;
+	if (t->badtiles)
+	    state->statusflags |= SF_BADTILES;
+	t->lastused = ++templateclock;
+	++templatehits;
+    } else {
+	++templatemisses;
+    }
+    pthread_mutex_unlock(&templatelock);
+    return t != NULL;
+}
+
+/* Add a copy of the newly decoded level to the cache, discarding the
+ * least recently used levels as needed to stay within the budget.
+ */
+static void addtemplate(gamestate const *state)
+{
+    gamesetup const    *setup = state->game;
+    leveltemplate      *t;
+    long		size;
+
+    size = sizeof *t + setup->levelsize;
+    pthread_mutex_lock(&templatelock);
+    if (size <= templatebudget) {
+	while (templatememory + size > templatebudget)
+	    if (!droptemplate())
+		break;
+	if ((t = malloc(size))) {
+	    t->hash = setup->levelhash;
+	    t->size = setup->levelsize;
+	    t->chipsneeded = state->chipsneeded;
+	    t->badtiles = (state->statusflags & SF_BADTILES) != 0;
+	    memcpy(t->decoded, (char const*)state + TEMPLATE_START,
+		   TEMPLATE_SIZE);
+	    memcpy(t + 1, setup->leveldata, setup->levelsize);
+	    t->lastused = ++templateclock;
+	    t->next = templates[t->hash % TEMPLATE_BUCKETS];
+	    templates[t->hash % TEMPLATE_BUCKETS] = t;
+	    templatememory += size;
+	}
+    }
+    pthread_mutex_unlock(&templatelock);
+}
+
+/* Set the most memory that the cache may use.
+ */
+void setlevelcachesize(long bytes)
+{
+    pthread_mutex_lock(&templatelock);
+    templatebudget = bytes < 0 ? 0 : bytes;
+    while (templatememory > templatebudget)
+	if (!droptemplate())
+	    break;
+    pthread_mutex_unlock(&templatelock);
+}
+
+/* Return the number of levels found in and missing from the cache.
+ */
+void getlevelcachestats(unsigned long *hits, unsigned long *misses)
+{
+    pthread_mutex_lock(&templatelock);
+    *hits = templatehits;
+    *misses = templatemisses;
+    pthread_mutex_unlock(&templatelock);
+}
+
+/* Exported interface. A level that has been decoded before is copied
+ * from the cache.
  */
 int expandleveldata(gamestate *state)
 {
-    return expandmsdatlevel(state);
+    if (gettemplate(state))
+	return TRUE;
+    if (!expandmsdatlevel(state))
+	return FALSE;
+    addtemplate(state);
+    return TRUE;
 }
 
 /* Return the setup for a small level to display at the completion of
@@ -14,6 +14,18 @@
  */
 extern int expandleveldata(gamestate *state);
 
+/* Set the most memory, in bytes, that is used to keep copies of the
+ * levels that have already been decoded, so that a level that is
+ * started again can be copied instead of decoded. The least recently
+ * used levels are discarded first. Zero turns the cache off.
+ */
+extern void setlevelcachesize(long bytes);
+
+/* Return the number of times that a level was started from the cache
+ * and the number of times it had to be decoded.
+ */
+extern void getlevelcachestats(unsigned long *hits, unsigned long *misses);
+
 /* Return the setup for a small level, created at runtime, that can be
  * displayed at the completion of a series.
  */
@@ -4,15 +4,106 @@
  * License. No warranty. See COPYING for details.
  */
 
+#include	<stdio.h>
 #include	<stdlib.h>
 #include	<stdarg.h>
+#include	<string.h>
 #include	"oshw.h"
 #include	"err.h"
 
 /* "Hidden" arguments to _warn, _errmsg, and _die.
  */
-char const      *_err_cfile = NULL;
-unsigned long	_err_lineno = 0;
+THREADLOCAL char const	       *_err_cfile = NULL;
+THREADLOCAL unsigned long	_err_lineno = 0;
+
+/* One message that has been held back.
+ */
+struct errlogentry {
+    int			action;		/* NOTIFY_LOG or NOTIFY_ERR */
+    char	       *prefix;		/* the message's prefix, or NULL */
+    char const	       *cfile;		/* the source file issuing it */
+    unsigned long	lineno;		/* the line issuing it */
+    char	       *text;		/* the message, or NULL */
+};
+
+/* Where the calling thread's messages are being held, if anywhere.
+ */
+static THREADLOCAL errlog	       *heldlog = NULL;
+
+/* Return a copy of str, or NULL if str is NULL.
+ */
+static char *copystring(char const *str)
+{
+    char       *copy;
+
+    if (!str)
+	return NULL;
+    copy = malloc(strlen(str) + 1);
+    if (!copy)
+	memerrexit();
+    return strcpy(copy, str);
+}
+
+/* Add a message to the calling thread's log.
+ */
+static void holdmessage(int action, char const *prefix,
+			char const *fmt, va_list args)
+{
+    struct errlogentry *entry;
+    char		buf[1024];
+
+    if (fmt)
+	vsnprintf(buf, sizeof buf, fmt, args);
+    xalloc(heldlog->list, (heldlog->count + 1) * sizeof *heldlog->list);
+    entry = heldlog->list + heldlog->count++;
+    entry->action = action;
+    entry->prefix = copystring(prefix);
+    entry->cfile = _err_cfile;
+    entry->lineno = _err_lineno;
+    entry->text = fmt ? copystring(buf) : NULL;
+}
+
+/* Pass a message on to the user.
+ */
+static void showmessage(int action, char const *prefix,
+			char const *cfile, unsigned long lineno,
+			char const *fmt, ...)
+{
+    va_list	args;
+
+    va_start(args, fmt);
+    usermessage(action, prefix, cfile, lineno, fmt, args);
+    va_end(args);
+}
+
+/* Start or stop holding back the calling thread's messages.
+ */
+void holdmessages(errlog *log)
+{
+    heldlog = log;
+}
+
+/* Display the held messages in the order they were issued.
+ */
+void showheldmessages(errlog *log)
+{
+    struct errlogentry *entry;
+    int			i;
+
+    for (i = 0, entry = log->list ; i < log->count ; ++i, ++entry) {
+	if (entry->text)
+	    showmessage(entry->action, entry->prefix,
+			entry->cfile, entry->lineno, "%s", entry->text);
+	else
+	    showmessage(entry->action, entry->prefix,
+			entry->cfile, entry->lineno, NULL);
+	free(entry->prefix);
+	free(entry->text);
+    }
+    free(log->list);
+    log->list = NULL;
+    log->count = 0;
+}
 
 /* Log a warning message.
  */
@@ -21,7 +112,10 @@ void _warn(char const *fmt, ...)
     va_list	args;
 
     va_start(args, fmt);
-    usermessage(NOTIFY_LOG, NULL, _err_cfile, _err_lineno, fmt, args);
+    if (heldlog)
+	holdmessage(NOTIFY_LOG, NULL, fmt, args);
+    else
+	usermessage(NOTIFY_LOG, NULL, _err_cfile, _err_lineno, fmt, args);
     va_end(args);
     _err_cfile = NULL;
     _err_lineno = 0;
@@ -34,7 +128,10 @@ void _errmsg(char const *prefix, char const *fmt, ...)
     va_list	args;
 
     va_start(args, fmt);
-    usermessage(NOTIFY_ERR, prefix, _err_cfile, _err_lineno, fmt, args);
+    if (heldlog)
+	holdmessage(NOTIFY_ERR, prefix, fmt, args);
+    else
+	usermessage(NOTIFY_ERR, prefix, _err_cfile, _err_lineno, fmt, args);
     va_end(args);
     _err_cfile = NULL;
     _err_lineno = 0;
@@ -7,6 +7,8 @@
 #ifndef	_err_h_
 #define	_err_h_
 
+#include	"gen.h"
+
 /* Simple macros for dealing with memory allocation simply.
  */
 #define	memerrexit()	(die("out of memory"))
@@ -24,11 +26,29 @@ extern void _errmsg(char const *prefix, char const *fmt, ...);
  */
 extern void _die(char const *fmt, ...);
 
+/* Messages that have been held back instead of being displayed. An
+ * errlog must start out empty, with list NULL and count zero.
+ */
+typedef	struct errlog {
+    struct errlogentry *list;		/* the messages, in the order issued */
+    int			count;		/* the number of messages */
+} errlog;
+
+/* Hold back the warnings and error messages issued by the calling
+ * thread by adding them to log, until this is called again with log
+ * set to NULL. Fatal errors are still displayed at once.
+ */
+extern void holdmessages(errlog *log);
+
+/* Display the messages held in log, and empty it.
+ */
+extern void showheldmessages(errlog *log);
+
 /* A really ugly hack used to smuggle extra arguments into variadic
  * functions.
  */
-extern char const      *_err_cfile;
-extern unsigned long	_err_lineno;
+extern THREADLOCAL char const	       *_err_cfile;
+extern THREADLOCAL unsigned long	_err_lineno;
 #define	warn	(_err_cfile = __FILE__, _err_lineno = __LINE__, _warn)
 #define	errmsg	(_err_cfile = __FILE__, _err_lineno = __LINE__, _errmsg)
 #define	die	(_err_cfile = __FILE__, _err_lineno = __LINE__, _die)
@@ -11,6 +11,12 @@
 #include	<dirent.h>
 #include	<sys/types.h>
 #include	<sys/stat.h>
+#if defined __unix__ || defined __APPLE__
+#include	<unistd.h>
+#include	<sys/mman.h>
+#define	HAVE_MMAP
+#define	HAVE_FSYNC
+#endif
 #include	"err.h"
 #include	"fileio.h"
 
@@ -115,6 +121,41 @@ void fileclose(fileinfo *file, char const *msg)
     }
 }
 
+/* Flush the file to disk and close it, and then rename it to name,
+ * replacing any file already there. The file is removed if anything
+ * goes wrong.
+ */
+int filereplace(fileinfo *file, char const *name, char const *msg)
+{
+    int	f;
+
+    errno = 0;
+    f = !fflush(file->fp) && !ferror(file->fp);
+#ifdef HAVE_FSYNC
+    if (f && fsync(fileno(file->fp)))
+	f = FALSE;
+#endif
+    if (fclose(file->fp))
+	f = FALSE;
+    file->fp = NULL;
+    if (f) {
+#ifdef WIN32
+	remove(name);
+#endif
+	f = !rename(file->name, name);
+    }
+    if (!f) {
+	fileerr(file, msg);
+	remove(file->name);
+    }
+    if (file->alloc) {
+	free(file->name);
+	file->name = NULL;
+	file->alloc = FALSE;
+    }
+    return f;
+}
+
 /* fgetpos().
  */
 int filegetpos(fileinfo *file, fpos_t *pos, char const *msg)
@@ -154,6 +195,16 @@ int fileskip(fileinfo *file, int offset, char const *msg)
     return fileerr(file, msg);
 }
 
+/* fseek() to the end of the file.
+ */
+int fileseekend(fileinfo *file, char const *msg)
+{
+    errno = 0;
+    if (!fseek(file->fp, 0, SEEK_END))
+	return TRUE;
+    return fileerr(file, msg);
+}
+
 /* feof().
  */
 int filetestend(fileinfo *file)
@@ -202,6 +253,42 @@ void *filereadbuf(fileinfo *file, unsigned long size, char const *msg)
     return buf;
 }
 
+/* Map the file into memory, if the system allows it.
+ */
+void *filemap(fileinfo *file, unsigned long *size)
+{
+#ifdef HAVE_MMAP
+    struct stat	st;
+    void       *data;
+
+    if (!file->fp || fstat(fileno(file->fp), &st) || st.st_size <= 0)
+	return NULL;
+    data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		fileno(file->fp), 0);
+    if (data == MAP_FAILED)
+	return NULL;
+    *size = st.st_size;
+    return data;
+#else
+    (void)file;
+    (void)size;
+    return NULL;
+#endif
+}
+
+/* Release the mapping.
+ */
+void fileunmap(void *data, unsigned long size)
+{
+#ifdef HAVE_MMAP
+    if (data)
+	munmap(data, size);
+#else
+    (void)data;
+    (void)size;
+#endif
+}
+
 /* Read one full line from fp and store the first len characters,
  * including any trailing newline.
  */
@@ -416,6 +503,19 @@ int finddir(char const *dir)
     return stat(dir, &st) ? createdir(dir) : S_ISDIR(st.st_mode);
 }
 
+/* Return the size and modification time of the named file.
+ */
+int filestamp(char const *name, unsigned long *size, unsigned long *mtime)
+{
+    struct stat	st;
+
+    if (stat(name, &st))
+	return FALSE;
+    *size = st.st_size;
+    *mtime = st.st_mtime;
+    return TRUE;
+}
+
 /* Return the pathname for a directory and/or filename, using the
  * same algorithm to construct the path as openfileindir().
  */
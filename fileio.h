@@ -36,10 +36,23 @@ extern int filewrite(fileinfo *file, void const *data, unsigned long size,
 		     char const *msg);
 extern void fileclose(fileinfo *file, char const *msg);
 
+/* Finish writing a file that was created to take the place of the
+ * file called name. The data is flushed to disk, the file is closed,
+ * and it is then renamed, so that name refers either to the old
+ * contents or to the complete new contents, and never to a partial
+ * file. FALSE is returned, and the new file is deleted, if any step
+ * fails.
+ */
+extern int filereplace(fileinfo *file, char const *name, char const *msg);
+
 /* fileskip() works like fseek() with whence set to SEEK_CUR.
  */
 extern int fileskip(fileinfo *file, int offset, char const *msg);
 
+/* fileseekend() moves to the end of the file, so that writes append.
+ */
+extern int fileseekend(fileinfo *file, char const *msg);
+
 /* filetestend() forces a check for EOF by attempting to read a byte
  * from the file, and ungetting the byte if one is successfully read.
  */
@@ -67,6 +80,19 @@ extern int filewriteint32(fileinfo *file, unsigned long val32,
  */
 extern void *filereadbuf(fileinfo *file, unsigned long size, char const *msg);
 
+/* Map the entire contents of the given file into memory, and return
+ * a pointer to the mapping, storing its size in *size. The mapping is
+ * private, so changes made to it are not written back to the file,
+ * and it remains valid after the file is closed. NULL is returned,
+ * without displaying an error, if the file cannot be mapped; the
+ * caller is expected to fall back on reading the file.
+ */
+extern void *filemap(fileinfo *file, unsigned long *size);
+
+/* Release a mapping obtained from filemap().
+ */
+extern void fileunmap(void *data, unsigned long size);
+
 /* Read one full line from fp and store the first len characters,
  * including any trailing newline. len receives the length of the line
  * stored in buf, minus any trailing newline, upon return.
@@ -108,6 +134,12 @@ extern char *getpathforfileindir(char const *dir, char const *filename);
  */
 extern int finddir(char const *dir);
 
+/* Return the size and modification time of the named file through
+ * size and mtime. FALSE is returned if the file could not be examined.
+ */
+extern int filestamp(char const *name, unsigned long *size,
+		     unsigned long *mtime);
+
 /* Open a file, using dir as the directory if filename is not already
  * a complete pathname. FALSE is returned if the directory could not
  * be created.
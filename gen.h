@@ -16,6 +16,19 @@
 #define	FALSE	0
 #endif
 
+/* The storage class for static variables that each thread of
+ * execution needs to have its own copy of.
+ */
+#if defined __GNUC__
+#define	THREADLOCAL	__thread
+#elif defined _MSC_VER
+#define	THREADLOCAL	__declspec(thread)
+#elif __STDC_VERSION__ >= 201112L
+#define	THREADLOCAL	_Thread_local
+#else
+#define	THREADLOCAL
+#endif
+
 /* Definition of the contents and layout of a table.
  *
  * The strings making up the contents of a table are each prefixed
@@ -0,0 +1,89 @@
+/* hash.c: Hashing the state of a game in progress.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/*
+ * The map is hashed in the manner of a Zobrist hash: every possible
+ * contents of every location has its own 64-bit key, and the hash of
+ * the map is the exclusive-or of the keys of what is currently there.
+ * Instead of storing a table of random keys, each key is made by
+ * scrambling the location and the contents together, which gives the
+ * same result without the 8 MB table. The logic modules keep the map
+ * hash up to date as they change the map, and fold the rest of the
+ * state in at the end of each tick.
+ */
+
+#include	"gen.h"
+#include	"hash.h"
+
+/* Scramble the bits of a value so that every input bit affects every
+ * output bit. (This is the finalizer of the SplitMix64 generator.)
+ */
+static statehash mix(statehash v)
+{
+    v ^= v >> 30;
+    v *= 0xBF58476D1CE4E5B9ULL;
+    v ^= v >> 27;
+    v *= 0x94D049BB133111EBULL;
+    v ^= v >> 31;
+    return v;
+}
+
+/* Return the key for the given contents of the given location.
+ */
+statehash hashmapcell(int pos, mapcell const *cell)
+{
+    return mix(((statehash)pos << 32) | ((statehash)cell->top.id << 24)
+				      | ((statehash)cell->top.state << 16)
+				      | ((statehash)cell->bot.id << 8)
+				      | (statehash)cell->bot.state);
+}
+
+/* Combine the keys of every location on the map.
+ */
+statehash hashmap(mapcell const *map)
+{
+    statehash	hash = 0;
+    int		pos;
+
+    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos)
+	hash ^= hashmapcell(pos, map + pos);
+    return hash;
+}
+
+/* Fold a value into the hash. Unlike the map keys, the order in which
+ * values are folded in matters.
+ */
+statehash hashvalue(statehash hash, unsigned long value)
+{
+    return mix((hash ^ value) + 0x9E3779B97F4A7C15ULL);
+}
+
+/* Fold every field of the creature into the hash.
+ */
+statehash hashcreature(statehash hash, creature const *cr)
+{
+    hash = hashvalue(hash, ((unsigned long)(unsigned short)cr->pos << 16)
+			 | ((unsigned long)cr->id << 8) | cr->dir);
+    hash = hashvalue(hash, ((unsigned long)(unsigned char)cr->moving << 24)
+			 | ((unsigned long)(unsigned char)cr->frame << 16)
+			 | ((unsigned long)cr->hidden << 8) | cr->state);
+    return hashvalue(hash, cr->tdir);
+}
+
+/* Fold in the parts of the state that both logic modules share.
+ */
+statehash hashcommonstate(gamestate const *state)
+{
+    statehash	hash;
+    int		n;
+
+    hash = hashvalue(state->maphash, (unsigned short)state->chipsneeded);
+    for (n = 0 ; n < 4 ; ++n)
+	hash = hashvalue(hash, ((unsigned long)(unsigned short)state->keys[n]
+								<< 16)
+			     | (unsigned short)state->boots[n]);
+    return hashvalue(hash, state->mainprng.value);
+}
@@ -0,0 +1,38 @@
+/* hash.h: Hashing the state of a game in progress.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#ifndef	_hash_h_
+#define	_hash_h_
+
+#include	"state.h"
+
+/* Return the contribution of one cell of the map to the map's hash.
+ * The map hash is the exclusive-or of every cell's contribution, so a
+ * cell can be taken out of the hash and put back in again by applying
+ * its value before and after a change.
+ */
+extern statehash hashmapcell(int pos, mapcell const *cell);
+
+/* Compute the hash of an entire map from scratch.
+ */
+extern statehash hashmap(mapcell const *map);
+
+/* Fold an integer value into a running hash.
+ */
+extern statehash hashvalue(statehash hash, unsigned long value);
+
+/* Fold one creature into a running hash.
+ */
+extern statehash hashcreature(statehash hash, creature const *cr);
+
+/* Begin the hash of the whole game state with the parts that both
+ * rulesets share: the map, Chip's inventory, the chip count, and the
+ * main PRNG. The tick count is deliberately left out, so that the
+ * same position reached at two different times hashes the same.
+ */
+extern statehash hashcommonstate(gamestate const *state);
+
+#endif
@@ -49,6 +49,20 @@ static char *yowzitch_items[] = {
              "1!Display times for the named level set and exit.",
     "1+-b,", "1---batch-verify ",
              "1!Verify solutions for the named level set and exit.",
+    "1+-j,", "1---jobs=N ",
+             "1!Use N threads when verifying solutions.",
+    "1+", "1---no-cache ",
+             "1!Verify every solution again, ignoring earlier results.",
+    "1+-M,", "1---seek-memory=N ",
+             "1!Use at most N kilobytes for seeking within playbacks.",
+    "1+", "1---render=DIR ",
+             "1!Write frames of the named level set's solutions to DIR.",
+    "1+", "1---render-every=N ",
+             "1!Write every Nth frame when rendering.",
+    "1+", "1---render-from=N ",
+             "1!Start rendering at tick N.",
+    "1+", "1---render-to=N ",
+             "1!Stop rendering after tick N.",
     "1+-d,", "1---list-dirs ",
              "1!Display default directories and exit.",
     "1+-h,", "1---help ",
@@ -61,7 +75,7 @@ static char *yowzitch_items[] = {
     "3!LEVEL specifies the level number to start at.",
     "3!SAVEFILE specifies an alternate solution file."
 };
-static tablespec const yowzitch_table = { 23, 3, 1, -1, yowzitch_items };
+static tablespec const yowzitch_table = { 30, 3, 1, -1, yowzitch_items };
 tablespec const *yowzitch = &yowzitch_table;
 
 /* Version and license information.
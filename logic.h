@@ -9,7 +9,16 @@
 
 #include	"state.h"
 
-/* One game logic engine.
+/* One game logic engine. The snapshot function stores a pointer-free
+ * copy of everything the engine needs, beyond the gamestate's own
+ * fields, to continue the game from the current tick. It returns the
+ * number of bytes that the copy needs, and only writes to the buffer
+ * if the given size is at least that large. The restore function
+ * reinstates a copy made by the same engine for the same level,
+ * returning FALSE if the copy is unusable. The restart function does
+ * the same with a copy of the starting position, in place of calling
+ * initgame, and so keeps what initgame carries over from the previous
+ * game and recomputes the state's hash.
  */
 typedef	struct gamelogic gamelogic;
 struct gamelogic {
@@ -20,6 +29,12 @@ struct gamelogic {
     int	      (*advancegame)(gamelogic*); /* advance the game one tick */
     int	      (*endgame)(gamelogic*);	  /* clean up after the game is done */
     void      (*shutdown)(gamelogic*);	  /* turn off the logic engine */
+    int	      (*snapshot)(gamelogic*, unsigned char*, int);
+					  /* copy out the local state */
+    int	      (*restore)(gamelogic*, unsigned char const*, int);
+					  /* reinstate the local state */
+    int	      (*restart)(gamelogic*, unsigned char const*, int);
+					  /* reinstate the starting position */
 };
 
 /* The available game logic engines.
@@ -27,4 +42,11 @@ struct gamelogic {
 extern gamelogic *lynxlogicstartup(void);
 extern gamelogic *mslogicstartup(void);
 
+/* The version of the game logic. This must be increased whenever a
+ * change to play.c or to either logic module alters how any game
+ * plays out, since it is what tells the results of one version of
+ * the game logic from those of another.
+ */
+#define	LOGIC_VERSION	1
+
 #endif
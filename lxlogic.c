@@ -10,6 +10,8 @@
 #include	"err.h"
 #include	"state.h"
 #include	"random.h"
+#include	"hash.h"
+#include	"profile.h"
 #include	"logic.h"
 
 /* A number well above the maximum number of creatures that could possibly
@@ -68,6 +70,28 @@ struct lxstate {
     creature		creaturearray[MAX_CREATURES + 1];  /* all creatures */
 };
 
+/* The Lynx-specific state as it is stored in a snapshot. The
+ * creature list, up to and including its terminating entry, follows
+ * directly after.
+ */
+typedef	struct lxsnapshot {
+    short		crcount;	/* number of creature entries */
+    short		chiptocr;	/* index of chiptocr, or -1 */
+    short		chiptopos;
+    unsigned char	lastrndslidedir;
+    unsigned char	prng1;
+    unsigned char	prng2;
+    signed char		xviewoffset;
+    signed char		yviewoffset;
+    unsigned char	endgametimer;
+    unsigned char	togglestate;
+    unsigned char	completed;
+    unsigned char	stuck;
+    unsigned char	pushing;
+    unsigned char	couldntmove;
+    unsigned char	mapbreached;
+} lxsnapshot;
+
 /* Declarations of (indirectly recursive) functions.
  */
 static int canmakemove(creature const *cr, int dir, int flags);
@@ -77,26 +101,51 @@ static int advancecreature(creature *cr, int releasing);
  */
 static int const	delta[] = { 0, -CXGRID, -1, 0, +CXGRID, 0, 0, 0, +1 };
 
-/* The direction used the last time something stepped onto a random
- * slide floor.
- */
-static int		lastrndslidedir = NORTH;
-
-/* The most recently used stepping phase value.
- */
-static int		laststepping = 0;
-
-/* A pointer to the game state, used so that it doesn't have to be
+/* The places on the level that would otherwise have to be found by
+ * searching the map or the wiring. They are worked out when the level
+ * is set up. Teleports, toggle walls, beartraps and clone machines are
+ * never created or removed during play, and the wiring never changes,
+ * so nothing here needs to be updated afterwards.
+ */
+typedef	struct levelindex {
+    short	prevteleport[CXGRID * CYGRID];	/* nearest teleport before */
+    short	togglewalls[CXGRID * CYGRID];	/* the toggle walls */
+    short	trapfrom[CXGRID * CYGRID];	/* trap each button opens */
+    short	clonerfrom[CXGRID * CYGRID];	/* cloner each button works */
+    int		togglewallcount;		/* number of toggle walls */
+} levelindex;
+
+/* One instance of the Lynx logic engine. The gamelogic struct comes
+ * first, so that the pointer handed out by lynxlogicstartup() can be
+ * turned back into the whole instance.
+ *
+ * The engine also keeps an index of where the visible creatures are.
+ * Each location has a count of the creatures there, and the
+ * exclusive-or of their positions in the creature list. When the
+ * count is one, the latter is simply the creature's position.
+ */
+typedef	struct lxlogic {
+    gamelogic	logic;			/* the public interface */
+    int		lastrndslidedir;	/* the last random slide direction */
+    int		laststepping;		/* the most recent stepping value */
+    unsigned short crcount[CXGRID * CYGRID];	/* creatures at each spot */
+    unsigned short crxor[CXGRID * CYGRID];	/* their indexes, xor'd */
+    levelindex	level;			/* where things are on the level */
+} lxlogic;
+
+/* The engine instance currently running on this thread, and a
+ * pointer to its game state, used so that they don't have to be
  * passed to every single function.
  */
-static gamestate       *state;
+static THREADLOCAL lxlogic	       *engine;
+static THREADLOCAL gamestate	       *state;
 
 /*
  * Accessor macros for various fields in the game state. Many of the
  * macros can be used as an lvalue.
  */
 
-#define	setstate(p)		(state = (p)->state)
+#define	setstate(p)		(engine = (lxlogic*)(p), state = (p)->state)
 
 #define	creaturelist()		(state->creatures)
 
@@ -157,6 +206,15 @@ static gamestate       *state;
 
 #define	floorat(pos)		(state->map[pos].top.id)
 
+/* Take a location out of the map hash, or put it back in. Every change
+ * to the map is made between a pair of these, so that the map hash
+ * never has to be recomputed.
+ */
+#define	hashcell(pos)		(state->maphash ^= \
+				    hashmapcell(pos, &state->map[pos]))
+#define	changecell(pos, expr)	(hashcell(pos), (expr), hashcell(pos))
+#define	setfloorat(pos, id)	changecell(pos, floorat(pos) = (id))
+
 #define	possession(obj)	(*_possession(obj))
 static short *_possession(int obj)
 {
@@ -217,11 +275,15 @@ static unsigned char lynx_prng(void)
 
 /* Accessor macros for the floor states.
  */
-#define	claimlocation(pos)	(state->map[pos].top.state |= FS_CLAIMED)
-#define	removeclaim(pos)	(state->map[pos].top.state &= ~FS_CLAIMED)
+#define	claimlocation(pos)	\
+    changecell(pos, state->map[pos].top.state |= FS_CLAIMED)
+#define	removeclaim(pos)	\
+    changecell(pos, state->map[pos].top.state &= ~FS_CLAIMED)
 #define	islocationclaimed(pos)	(state->map[pos].top.state & FS_CLAIMED)
-#define	markanimated(pos)	(state->map[pos].top.state |= FS_ANIMATED)
-#define	clearanimated(pos)	(state->map[pos].top.state &= ~FS_ANIMATED)
+#define	markanimated(pos)	\
+    changecell(pos, state->map[pos].top.state |= FS_ANIMATED)
+#define	clearanimated(pos)	\
+    changecell(pos, state->map[pos].top.state &= ~FS_ANIMATED)
 #define	ismarkedanimated(pos)	(state->map[pos].top.state & FS_ANIMATED)
 
 /* Translate a slide floor into the direction it points in. In the
@@ -237,8 +299,8 @@ static int getslidedir(int floor, int advance)
       case Slide_East:		return EAST;
       case Slide_Random:
 	if (advance)
-	    lastrndslidedir = right(lastrndslidedir);
-	return lastrndslidedir;
+	    engine->lastrndslidedir = right(engine->lastrndslidedir);
+	return engine->lastrndslidedir;
     }
     warn("Invalid floor %d handed to getslidedir()\n", floor);
     _assert(!"getslidedir() called with an invalid object");
@@ -270,56 +332,20 @@ static void applyicewallturn(creature *cr)
     cr->dir = dir;
 }
 
-/* Find the location of a beartrap from one of its buttons.
+/* Find the location of a beartrap from one of its buttons. (In
+ * pedantic mode, this is the next beartrap after the button in
+ * reading order, instead of the one it is wired to.)
  */
 static int trapfrombutton(int pos)
 {
-    xyconn     *xy;
-    int		i;
-
-    if (ispedanticmode()) {
-	i = pos;
-	for (;;) {
-	    ++i;
-	    if (i == CXGRID * CYGRID)
-		i = 0;
-	    if (i == pos)
-		break;
-	    if (floorat(i) == Beartrap)
-		return i;
-	}
-    } else {
-	for (xy = traplist(), i = traplistsize() ; i ; ++xy, --i)
-	    if (xy->from == pos)
-		return xy->to;
-    }
-    return -1;
+    return engine->level.trapfrom[pos];
 }
 
 /* Find the location of a clone machine from one of its buttons.
  */
 static int clonerfrombutton(int pos)
 {
-    xyconn     *xy;
-    int		i;
-
-    if (ispedanticmode()) {
-	i = pos;
-	for (;;) {
-	    ++i;
-	    if (i == CXGRID * CYGRID)
-		i = 0;
-	    if (i == pos)
-		break;
-	    if (floorat(i) == CloneMachine)
-		return i;
-	}
-    } else {
-	for (xy = clonerlist(), i = clonerlistsize() ; i ; ++xy, --i)
-	    if (xy->from == pos)
-		return xy->to;
-    }
-    return -1;
+    return engine->level.clonerfrom[pos];
 }
 
 /* Quell any continuous sound effects coming from what Chip is
@@ -355,14 +381,87 @@ static void resetfloorsounds(int includepushing)
 #define	setfdir(cr, d)	((cr)->state = ((cr)->state & ~CS_FDIRMASK) \
 				     | ((d) & CS_FDIRMASK))
 
+/* TRUE if the creature is one that lookupcreature() can find.
+ */
+#define	isindexed(cr)	(!(cr)->hidden && !isanimation((cr)->id) \
+			 && (cr)->pos >= 0 && (cr)->pos < CXGRID * CYGRID)
+
+/* Add a creature to the location index, or take it out again. Every
+ * change to a creature's location or visibility is made between a
+ * pair of these.
+ */
+static void indexcreature(creature const *cr)
+{
+    if (isindexed(cr)) {
+	++engine->crcount[cr->pos];
+	engine->crxor[cr->pos] ^= cr - creaturelist();
+    }
+}
+
+static void unindexcreature(creature const *cr)
+{
+    if (isindexed(cr)) {
+	--engine->crcount[cr->pos];
+	engine->crxor[cr->pos] ^= cr - creaturelist();
+    }
+}
+
+/* Move a creature to a new location.
+ */
+static void setcreaturepos(creature *cr, int pos)
+{
+    unindexcreature(cr);
+    cr->pos = pos;
+    indexcreature(cr);
+}
+
+/* Build the location index from scratch.
+ */
+static void rebuildcreatureindex(void)
+{
+    creature   *cr;
+
+    memset(engine->crcount, 0, sizeof engine->crcount);
+    memset(engine->crxor, 0, sizeof engine->crxor);
+    for (cr = creaturelist() ; cr->id ; ++cr)
+	indexcreature(cr);
+}
+
+#ifndef NDEBUG
+
+/* Return TRUE if the location index agrees with the creature list.
+ */
+static int checkcreatureindex(void)
+{
+    unsigned short	count[CXGRID * CYGRID];
+    unsigned short	xor[CXGRID * CYGRID];
+
+    memcpy(count, engine->crcount, sizeof count);
+    memcpy(xor, engine->crxor, sizeof xor);
+    rebuildcreatureindex();
+    return !memcmp(count, engine->crcount, sizeof count)
+	&& !memcmp(xor, engine->crxor, sizeof xor);
+}
+
+#endif
+
 /* Return the creature located at pos. Ignores Chip unless includechip
  * is TRUE. (This is important in the case when Chip and a second
- * creature are currently occupying a single location.)
+ * creature are currently occupying a single location.) The location
+ * index answers directly unless several creatures share the spot.
  */
 static creature *lookupcreature(int pos, int includechip)
 {
     creature   *cr;
 
+    switch (engine->crcount[pos]) {
+      case 0:
+	return NULL;
+      case 1:
+	cr = creaturelist() + engine->crxor[pos];
+	return includechip || cr != getchip() ? cr : NULL;
+    }
+
     cr = creaturelist();
     if (!includechip)
 	++cr;
@@ -418,6 +517,7 @@ static void turntanks(void)
  */
 static void removecreature(creature *cr, int animationid)
 {
+    unindexcreature(cr);
     if (cr->id != Chip)
 	removeclaim(cr->pos);
     if (cr->state & CS_PUSHED)
@@ -433,6 +533,7 @@ static void removecreature(creature *cr, int animationid)
 	cr->moving = 0;
     }
     markanimated(cr->pos);
+    indexcreature(cr);
 }
 
 /* End the given animation sequence (thus removing the final vestige
@@ -506,84 +607,101 @@ static void removechip(int reason, creature *also)
  * about what sort of tiles they are permitted to cross. The following
  * lookup table encapsulates these rules. These rules are only a first
  * check; a creature may be generally permitted a particular type of
- * move but still be prevented in a specific situation.
+ * move but still be prevented in a specific situation. The table also
+ * gives the directions in which a creature may not leave a tile.
  */
 
 #define NWSE	(NORTH | WEST | SOUTH | EAST)
 
-static struct { unsigned char chip, block, creature; } const movelaws[] = {
-    /* Nothing */		{ 0, 0, 0 },
-    /* Empty */			{ NWSE, NWSE, NWSE },
-    /* Slide_North */		{ NWSE, NWSE, NWSE },
-    /* Slide_West */		{ NWSE, NWSE, NWSE },
-    /* Slide_South */		{ NWSE, NWSE, NWSE },
-    /* Slide_East */		{ NWSE, NWSE, NWSE },
-    /* Slide_Random */		{ NWSE, NWSE, NWSE },
-    /* Ice */			{ NWSE, NWSE, NWSE },
-    /* IceWall_Northwest */	{ SOUTH | EAST, SOUTH | EAST, SOUTH | EAST },
-    /* IceWall_Northeast */	{ SOUTH | WEST, SOUTH | WEST, SOUTH | WEST },
-    /* IceWall_Southwest */	{ NORTH | EAST, NORTH | EAST, NORTH | EAST },
-    /* IceWall_Southeast */	{ NORTH | WEST, NORTH | WEST, NORTH | WEST },
-    /* Gravel */		{ NWSE, NWSE, 0 },
-    /* Dirt */			{ NWSE, 0, 0 },
-    /* Water */			{ NWSE, NWSE, NWSE },
-    /* Fire */			{ NWSE, NWSE, NWSE },
-    /* Bomb */			{ NWSE, NWSE, NWSE },
-    /* Beartrap */		{ NWSE, NWSE, NWSE },
-    /* Burglar */		{ NWSE, 0, 0 },
-    /* HintButton */		{ NWSE, 0, 0 },
-    /* Button_Blue */		{ NWSE, NWSE, NWSE },
-    /* Button_Green */		{ NWSE, NWSE, NWSE },
-    /* Button_Red */		{ NWSE, NWSE, NWSE },
-    /* Button_Brown */		{ NWSE, NWSE, NWSE },
-    /* Teleport */		{ NWSE, NWSE, NWSE },
-    /* Wall */			{ 0, 0, 0 },
+/* The flag that marks a tile that can only be left by a creature that
+ * is being released from it.
+ */
+#define	ML_TRAP		0x01
+
+static struct {
+    unsigned char	chip, block, creature, walls, flags;
+} const movelaws[] = {
+    /* Nothing */		{ 0, 0, 0, 0, 0 },
+    /* Empty */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_North */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_West */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_South */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_East */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_Random */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Ice */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* IceWall_Northwest */	{ SOUTH | EAST, SOUTH | EAST, SOUTH | EAST,
+				  SOUTH | EAST, 0 },
+    /* IceWall_Northeast */	{ SOUTH | WEST, SOUTH | WEST, SOUTH | WEST,
+				  SOUTH | WEST, 0 },
+    /* IceWall_Southwest */	{ NORTH | EAST, NORTH | EAST, NORTH | EAST,
+				  NORTH | EAST, 0 },
+    /* IceWall_Southeast */	{ NORTH | WEST, NORTH | WEST, NORTH | WEST,
+				  NORTH | WEST, 0 },
+    /* Gravel */		{ NWSE, NWSE, 0, 0, 0 },
+    /* Dirt */			{ NWSE, 0, 0, 0, 0 },
+    /* Water */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Fire */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Bomb */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Beartrap */		{ NWSE, NWSE, NWSE, NWSE, ML_TRAP },
+    /* Burglar */		{ NWSE, 0, 0, 0, 0 },
+    /* HintButton */		{ NWSE, 0, 0, 0, 0 },
+    /* Button_Blue */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Button_Green */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Button_Red */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Button_Brown */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Teleport */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Wall */			{ 0, 0, 0, 0, 0 },
     /* Wall_North */		{ NORTH | WEST | EAST,
 				  NORTH | WEST | EAST,
-				  NORTH | WEST | EAST },
+				  NORTH | WEST | EAST,
+				  NORTH, 0 },
     /* Wall_West */		{ NORTH | WEST | SOUTH,
 				  NORTH | WEST | SOUTH,
-				  NORTH | WEST | SOUTH },
+				  NORTH | WEST | SOUTH,
+				  WEST, 0 },
     /* Wall_South */		{ WEST | SOUTH | EAST,
 				  WEST | SOUTH | EAST,
-				  WEST | SOUTH | EAST },
+				  WEST | SOUTH | EAST,
+				  SOUTH, 0 },
     /* Wall_East */		{ NORTH | SOUTH | EAST,
 				  NORTH | SOUTH | EAST,
-				  NORTH | SOUTH | EAST },
-    /* Wall_Southeast */	{ SOUTH | EAST, SOUTH | EAST, SOUTH | EAST },
-    /* HiddenWall_Perm */	{ 0, 0, 0 },
-    /* HiddenWall_Temp */	{ NWSE, 0, 0 },
-    /* BlueWall_Real */		{ NWSE, 0, 0 },
-    /* BlueWall_Fake */		{ NWSE, 0, 0 },
-    /* SwitchWall_Open */	{ NWSE, NWSE, NWSE },
-    /* SwitchWall_Closed */	{ 0, 0, 0 },
-    /* PopupWall */		{ NWSE, 0, 0 },
-    /* CloneMachine */		{ 0, 0, 0 },
-    /* Door_Red */		{ NWSE, 0, 0 },
-    /* Door_Blue */		{ NWSE, 0, 0 },
-    /* Door_Yellow */		{ NWSE, 0, 0 },
-    /* Door_Green */		{ NWSE, 0, 0 },
-    /* Socket */		{ NWSE, 0, 0 },
-    /* Exit */			{ NWSE, 0, 0 },
-    /* ICChip */		{ NWSE, 0, 0 },
-    /* Key_Red */		{ NWSE, NWSE, NWSE },
-    /* Key_Blue */		{ NWSE, NWSE, NWSE },
-    /* Key_Yellow */		{ NWSE, 0, 0 },
-    /* Key_Green */		{ NWSE, 0, 0 },
-    /* Boots_Slide */		{ NWSE, 0, 0 },
-    /* Boots_Ice */		{ NWSE, 0, 0 },
-    /* Boots_Water */		{ NWSE, 0, 0 },
-    /* Boots_Fire */		{ NWSE, 0, 0 },
-    /* Block_Static */		{ 0, 0, 0 },
-    /* Drowned_Chip */		{ 0, 0, 0 },
-    /* Burned_Chip */		{ 0, 0, 0 },
-    /* Bombed_Chip */		{ 0, 0, 0 },
-    /* Exited_Chip */		{ 0, 0, 0 },
-    /* Exit_Extra_1 */		{ 0, 0, 0 },
-    /* Exit_Extra_2 */		{ 0, 0, 0 },
-    /* Overlay_Buffer */	{ 0, 0, 0 },
-    /* Floor_Reserved2 */	{ 0, 0, 0 },
-    /* Floor_Reserved1 */	{ 0, 0, 0 }
+				  NORTH | SOUTH | EAST,
+				  EAST, 0 },
+    /* Wall_Southeast */	{ SOUTH | EAST, SOUTH | EAST, SOUTH | EAST,
+				  SOUTH | EAST, 0 },
+    /* HiddenWall_Perm */	{ 0, 0, 0, 0, 0 },
+    /* HiddenWall_Temp */	{ NWSE, 0, 0, 0, 0 },
+    /* BlueWall_Real */		{ NWSE, 0, 0, 0, 0 },
+    /* BlueWall_Fake */		{ NWSE, 0, 0, 0, 0 },
+    /* SwitchWall_Open */	{ NWSE, NWSE, NWSE, 0, 0 },
+    /* SwitchWall_Closed */	{ 0, 0, 0, 0, 0 },
+    /* PopupWall */		{ NWSE, 0, 0, 0, 0 },
+    /* CloneMachine */		{ 0, 0, 0, NWSE, ML_TRAP },
+    /* Door_Red */		{ NWSE, 0, 0, 0, 0 },
+    /* Door_Blue */		{ NWSE, 0, 0, 0, 0 },
+    /* Door_Yellow */		{ NWSE, 0, 0, 0, 0 },
+    /* Door_Green */		{ NWSE, 0, 0, 0, 0 },
+    /* Socket */		{ NWSE, 0, 0, 0, 0 },
+    /* Exit */			{ NWSE, 0, 0, 0, 0 },
+    /* ICChip */		{ NWSE, 0, 0, 0, 0 },
+    /* Key_Red */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Key_Blue */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Key_Yellow */		{ NWSE, 0, 0, 0, 0 },
+    /* Key_Green */		{ NWSE, 0, 0, 0, 0 },
+    /* Boots_Slide */		{ NWSE, 0, 0, 0, 0 },
+    /* Boots_Ice */		{ NWSE, 0, 0, 0, 0 },
+    /* Boots_Water */		{ NWSE, 0, 0, 0, 0 },
+    /* Boots_Fire */		{ NWSE, 0, 0, 0, 0 },
+    /* Block_Static */		{ 0, 0, 0, 0, 0 },
+    /* Drowned_Chip */		{ 0, 0, 0, 0, 0 },
+    /* Burned_Chip */		{ 0, 0, 0, 0, 0 },
+    /* Bombed_Chip */		{ 0, 0, 0, 0, 0 },
+    /* Exited_Chip */		{ 0, 0, 0, 0, 0 },
+    /* Exit_Extra_1 */		{ 0, 0, 0, 0, 0 },
+    /* Exit_Extra_2 */		{ 0, 0, 0, 0, 0 },
+    /* Overlay_Buffer */	{ 0, 0, 0, 0, 0 },
+    /* Floor_Reserved2 */	{ 0, 0, 0, 0, 0 },
+    /* Floor_Reserved1 */	{ 0, 0, 0, 0, 0 }
 };
 
 /* Including the flag CMM_RELEASING in a call to canmakemove()
@@ -643,22 +761,9 @@ static int canmakemove(creature const *cr, int dir, int flags)
     _assert(dir != NIL);
 
     floor = floorat(cr->pos);
-    switch (floor) {
-      case Wall_North:         if (dir & NORTH) return FALSE;            break;
-      case Wall_West:          if (dir & WEST) return FALSE;             break;
-      case Wall_South:         if (dir & SOUTH) return FALSE;            break;
-      case Wall_East:          if (dir & EAST) return FALSE;             break;
-      case Wall_Southeast:     if (dir & (SOUTH | EAST)) return FALSE;   break;
-      case IceWall_Northwest:  if (dir & (SOUTH | EAST)) return FALSE;   break;
-      case IceWall_Northeast:  if (dir & (SOUTH | WEST)) return FALSE;   break;
-      case IceWall_Southwest:  if (dir & (NORTH | EAST)) return FALSE;   break;
-      case IceWall_Southeast:  if (dir & (NORTH | WEST)) return FALSE;   break;
-      case Beartrap:
-      case CloneMachine:
-	if (!(flags & CMM_RELEASING))
+    if (movelaws[floor].walls & dir)
+	if (!(movelaws[floor].flags & ML_TRAP) || !(flags & CMM_RELEASING))
 	    return FALSE;
-	break;
-    }
     if (isslide(floor) && (cr->id != Chip || !possession(Boots_Slide))
 		       && getslidedir(floor, FALSE) == back(dir))
 	return FALSE;
@@ -701,7 +806,7 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	}
 	if (floor == HiddenWall_Temp || floor == BlueWall_Real) {
 	    if (flags & CMM_STARTMOVEMENT)
-		floorat(to) = Wall;
+		setfloorat(to, Wall);
 	    return FALSE;
 	}
     } else if (cr->id == Block) {
@@ -987,22 +1092,18 @@ static int teleportcreature(creature *cr)
     origpos = pos = cr->pos;
 
     for (;;) {
-	--pos;
-	if (pos < 0)
-	    pos += CXGRID * CYGRID;
-	if (floorat(pos) == Teleport) {
-	    if (cr->id != Chip)
-		removeclaim(cr->pos);
-	    cr->pos = pos;
-	    if (!islocationclaimed(pos) && canmakemove(cr, cr->dir, 0))
-		break;
-	    if (pos == origpos) {
-		if (cr->id == Chip)
-		    chipstuck() = TRUE;
-		else
-		    claimlocation(cr->pos);
-		return FALSE;
-	    }
+	pos = engine->level.prevteleport[pos];
+	if (cr->id != Chip)
+	    removeclaim(cr->pos);
+	setcreaturepos(cr, pos);
+	if (!islocationclaimed(pos) && canmakemove(cr, cr->dir, 0))
+	    break;
+	if (pos == origpos) {
+	    if (cr->id == Chip)
+		chipstuck() = TRUE;
+	    else
+		claimlocation(cr->pos);
+	    return FALSE;
 	}
     }
 
@@ -1042,7 +1143,9 @@ static int activatecloner(int pos)
 	return advancecreature(cr, TRUE) != 0;
 
     *clone = *cr;
+    indexcreature(clone);
     if (advancecreature(cr, TRUE) <= 0) {
+	unindexcreature(clone);
 	clone->hidden = TRUE;
 	return FALSE;
     }
@@ -1147,7 +1250,7 @@ static int startmovement(creature *cr, int releasing)
 	return -1;
     }
 
-    cr->pos += delta[dir];
+    setcreaturepos(cr, cr->pos + delta[dir]);
     if (cr->id != Chip)
 	claimlocation(cr->pos);
 
@@ -1235,11 +1338,11 @@ static int endmovement(creature *cr)
 	    break;
 	  case Dirt:
 	  case BlueWall_Fake:
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_TILE_EMPTIED);
 	    break;
 	  case PopupWall:
-	    floorat(cr->pos) = Wall;
+	    setfloorat(cr->pos, Wall);
 	    addsoundeffect(SND_WALL_CREATED);
 	    break;
 	  case Door_Red:
@@ -1249,7 +1352,7 @@ static int endmovement(creature *cr)
 	    _assert(possession(floor));
 	    if (floor != Door_Green)
 		--possession(floor);
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_DOOR_OPENED);
 	    break;
 	  case Key_Red:
@@ -1264,7 +1367,7 @@ static int endmovement(creature *cr)
 	  case Boots_Fire:
 	  case Boots_Water:
 	    ++possession(floor);
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_ITEM_COLLECTED);
 	    break;
 	  case Burglar:
@@ -1277,15 +1380,16 @@ static int endmovement(creature *cr)
 	  case ICChip:
 	    if (chipsneeded())
 		--chipsneeded();
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_IC_COLLECTED);
 	    break;
 	  case Socket:
 	    _assert(chipsneeded() == 0);
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_SOCKET_OPENED);
 	    break;
 	  case Exit:
+	    unindexcreature(cr);
 	    cr->hidden = TRUE;
 	    completed() = TRUE;
 	    addsoundeffect(SND_CHIP_WINS);
@@ -1294,13 +1398,13 @@ static int endmovement(creature *cr)
     } else if (cr->id == Block) {
 	switch (floor) {
 	  case Water:
-	    floorat(cr->pos) = Dirt;
+	    setfloorat(cr->pos, Dirt);
 	    addsoundeffect(SND_WATER_SPLASH);
 	    removecreature(cr, Water_Splash);
 	    survived = FALSE;
 	    break;
 	  case Key_Blue:
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    break;
 	}
     } else {
@@ -1313,7 +1417,7 @@ static int endmovement(creature *cr)
 	    }
 	    break;
 	  case Key_Blue:
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    break;
 	}
     }
@@ -1323,7 +1427,7 @@ static int endmovement(creature *cr)
 
     switch (floor) {
       case Bomb:
-	floorat(cr->pos) = Empty;
+	setfloorat(cr->pos, Empty);
 	if (cr->id == Chip) {
 	    removechip(CHIP_BOMBED, NULL);
 	} else {
@@ -1489,15 +1593,15 @@ static void initialhousekeeping(void)
 {
     creature   *chip;
     creature   *cr;
-    int		pos;
+    int		pos, n;
 
 #ifndef NDEBUG
     verifymap();
 #endif
 
     if (currenttime() == 0) {
-	lastrndslidedir = rndslidedir();
-	laststepping = stepping();
+	engine->lastrndslidedir = rndslidedir();
+	engine->laststepping = stepping();
     }
 
     chip = getchip();
@@ -1532,10 +1636,9 @@ static void initialhousekeeping(void)
     }
 
     if (togglestate()) {
-	for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
-	    if (floorat(pos) == SwitchWall_Open
-				|| floorat(pos) == SwitchWall_Closed)
-		floorat(pos) ^= togglestate();
+	for (n = 0 ; n < engine->level.togglewallcount ; ++n) {
+	    pos = engine->level.togglewalls[n];
+	    changecell(pos, floorat(pos) ^= togglestate());
 	}
 	togglestate() = 0;
     }
@@ -1578,11 +1681,36 @@ static void initialhousekeeping(void)
     chiptocr() = NULL;
 }
 
+/* Compute the hash of the entire game state. The map's part of it is
+ * kept up to date as the map changes, but the rest changes so much
+ * from tick to tick that it is simply recomputed.
+ */
+static statehash hashstate(void)
+{
+    creature const     *cr;
+    statehash		hash;
+
+    hash = hashcommonstate(state);
+    for (cr = creaturelist() ; cr->id ; ++cr)
+	hash = hashcreature(hash, cr);
+    hash = hashvalue(hash, cr - creaturelist());
+    hash = hashvalue(hash, ((unsigned long)prngvalue1() << 24)
+			 | ((unsigned long)prngvalue2() << 16)
+			 | (engine->lastrndslidedir << 8) | togglestate());
+    hash = hashvalue(hash, ((unsigned long)inendgame() << 24)
+			 | ((unsigned long)completed() << 16)
+			 | (chipstuck() << 8) | mapbreached());
+    hash = hashvalue(hash, chiptocr() ? chiptocr() - creaturelist() : -1);
+    return hashvalue(hash, (unsigned short)chiptopos());
+}
+
 /* Actions and checks that occur at the end of every tick.
  */
 static void finalhousekeeping(void)
 {
-    return;
+    _assert(state->maphash == hashmap(state->map));
+    _assert(checkcreatureindex());
+    state->hash = hashstate();
 }
 
 /* Set the state fields specifically used to produce the output.
@@ -1637,6 +1765,64 @@ static void preparedisplay(void)
     }
 }
 
+/* Work out where the teleports and toggle walls are, and what each
+ * button sets off. A teleport's entry gives the nearest teleport
+ * before it in reading order, wrapping around the map, which is the
+ * order that teleportcreature() tries them in. In pedantic mode, a
+ * button sets off the nearest beartrap or clone machine after it in
+ * reading order; otherwise it sets off whatever it is wired to.
+ */
+static void buildlevelindex(void)
+{
+    levelindex	       *li = &engine->level;
+    xyconn const       *xy;
+    int			pos, last, trap, cloner, n;
+
+    li->togglewallcount = 0;
+    last = -1;
+    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
+	li->prevteleport[pos] = last;
+	if (floorat(pos) == Teleport)
+	    last = pos;
+	else if (floorat(pos) == SwitchWall_Open
+				|| floorat(pos) == SwitchWall_Closed)
+	    li->togglewalls[li->togglewallcount++] = pos;
+    }
+    for (pos = 0 ; pos < CXGRID * CYGRID && li->prevteleport[pos] < 0 ; ++pos)
+	li->prevteleport[pos] = last;
+
+    if (ispedanticmode()) {
+	trap = cloner = -1;
+	for (n = 2 * CXGRID * CYGRID - 1 ; n >= 0 ; --n) {
+	    pos = n % (CXGRID * CYGRID);
+	    if (n < CXGRID * CYGRID) {
+		li->trapfrom[pos] = trap == pos ? -1 : trap;
+		li->clonerfrom[pos] = cloner == pos ? -1 : cloner;
+	    }
+	    if (floorat(pos) == Beartrap)
+		trap = pos;
+	    else if (floorat(pos) == CloneMachine)
+		cloner = pos;
+	}
+	return;
+    }
+
+    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
+	li->trapfrom[pos] = -1;
+	li->clonerfrom[pos] = -1;
+    }
+    for (n = traplistsize(), xy = traplist() + n ; n ; --n) {
+	--xy;
+	if (xy->from >= 0 && xy->from < CXGRID * CYGRID)
+	    li->trapfrom[xy->from] = xy->to;
+    }
+    for (n = clonerlistsize(), xy = clonerlist() + n ; n ; --n) {
+	--xy;
+	if (xy->from >= 0 && xy->from < CXGRID * CYGRID)
+	    li->clonerfrom[xy->from] = xy->to;
+    }
+}
+
 /*
  * The functions provided by the gamelogic struct.
  */
@@ -1781,11 +1967,15 @@ static int initgame(gamelogic *logic)
     chiptocr() = NULL;
     prngvalue1() = 0;
     prngvalue2() = 0;
-    rndslidedir() = lastrndslidedir;
-    stepping() = laststepping;
+    rndslidedir() = engine->lastrndslidedir;
+    stepping() = engine->laststepping;
     xviewoffset() = 0;
     yviewoffset() = 0;
 
+    rebuildcreatureindex();
+    buildlevelindex();
+    state->maphash = hashmap(state->map);
+    state->hash = hashstate();
     preparedisplay();
     return !ismarkedinvalid();
 }
@@ -1795,10 +1985,13 @@ static int initgame(gamelogic *logic)
 static int advancegame(gamelogic *logic)
 {
     creature   *cr;
+    int		id, n;
 
     setstate(logic);
+    profmark();
 
     initialhousekeeping();
+    profphase(Phase_Housekeeping);
 
     for (cr = creaturelistend() ; cr >= creaturelist() ; --cr) {
 	setfdir(cr, NIL);
@@ -1811,8 +2004,10 @@ static int advancegame(gamelogic *logic)
 		removeanimation(cr);
 	    continue;
 	}
-	if (cr->moving <= 0)
+	if (cr->moving <= 0) {
 	    choosemove(cr);
+	    profcreature(cr->id, Phase_ChooseMoves);
+	}
     }
 
     cr = getchip();
@@ -1820,11 +2015,15 @@ static int advancegame(gamelogic *logic)
 	couldntmove() = FALSE;
     else
 	checkmovingto();
+    profphase(Phase_MoveChip);
 
     for (cr = creaturelistend() ; cr >= creaturelist() ; --cr) {
 	if (cr->hidden)
 	    continue;
-	if (advancecreature(cr, FALSE) < 0)
+	id = cr->id;
+	n = advancecreature(cr, FALSE);
+	profcreature(id, Phase_MoveCreatures);
+	if (n < 0)
 	    continue;
 	cr->tdir = NIL;
 	setfdir(cr, NIL);
@@ -1840,10 +2039,13 @@ static int advancegame(gamelogic *logic)
 	if (floorat(cr->pos) == Teleport)
 	    teleportcreature(cr);
     }
+    profphase(Phase_Teleports);
 
     finalhousekeeping();
+    profphase(Phase_FinalHousekeeping);
 
     preparedisplay();
+    profphase(Phase_Display);
 
     if (inendgame()) {
 	--timeoffset();
@@ -1864,29 +2066,129 @@ static int endgame(gamelogic *logic)
     return TRUE;
 }
 
-/* Free all allocated resources for this module.
+/* Store a copy of the Lynx-specific state, with the creature pointers
+ * turned into indexes.
  */
-static void shutdown(gamelogic *logic)
+static int snapshot(gamelogic *logic, unsigned char *buf, int size)
 {
-    (void)logic;
+    lxsnapshot	snap;
+    int		n;
+
+    setstate(logic);
+    snap.crcount = creaturelistend() - creaturelist() + 2;
+    n = sizeof snap + snap.crcount * sizeof(creature);
+    if (size < n)
+	return n;
+
+    snap.chiptocr = chiptocr() ? chiptocr() - creaturelist() : -1;
+    snap.chiptopos = chiptopos();
+    snap.lastrndslidedir = engine->lastrndslidedir;
+    snap.prng1 = prngvalue1();
+    snap.prng2 = prngvalue2();
+    snap.xviewoffset = xviewoffset();
+    snap.yviewoffset = yviewoffset();
+    snap.endgametimer = inendgame();
+    snap.togglestate = togglestate();
+    snap.completed = completed();
+    snap.stuck = chipstuck();
+    snap.pushing = chippushing();
+    snap.couldntmove = couldntmove();
+    snap.mapbreached = mapbreached();
+    memcpy(buf, &snap, sizeof snap);
+    memcpy(buf + sizeof snap, creaturelist(), snap.crcount * sizeof(creature));
+    return n;
 }
 
-/* The exported function: Initialize and return the module's gamelogic
- * structure.
+/* Reinstate the Lynx-specific state from a snapshot.
  */
-gamelogic *lynxlogicstartup(void)
+static int restore(gamelogic *logic, unsigned char const *buf, int size)
 {
-    static gamelogic	logic;
+    lxsnapshot	snap;
 
-    lastrndslidedir = NORTH;
-    laststepping = 0;
+    setstate(logic);
+    if (size < (int)sizeof snap)
+	return FALSE;
+    memcpy(&snap, buf, sizeof snap);
+    if (snap.crcount < 1 || snap.crcount > MAX_CREATURES)
+	return FALSE;
+    if (size != (int)(sizeof snap + snap.crcount * sizeof(creature)))
+	return FALSE;
+    if (snap.chiptocr >= snap.crcount)
+	return FALSE;
 
-    logic.ruleset = Ruleset_Lynx;
-    logic.localstateinfosize = sizeof(struct lxstate);
-    logic.initgame = initgame;
-    logic.advancegame = advancegame;
-    logic.endgame = endgame;
-    logic.shutdown = shutdown;
+    memcpy(creaturelist(), buf + sizeof snap, snap.crcount * sizeof(creature));
+    creaturelistend() = creaturelist() + snap.crcount - 2;
+    chiptocr() = snap.chiptocr < 0 ? NULL : creaturelist() + snap.chiptocr;
+    chiptopos() = snap.chiptopos;
+    engine->lastrndslidedir = snap.lastrndslidedir;
+    prngvalue1() = snap.prng1;
+    prngvalue2() = snap.prng2;
+    xviewoffset() = snap.xviewoffset;
+    yviewoffset() = snap.yviewoffset;
+    inendgame() = snap.endgametimer;
+    togglestate() = snap.togglestate;
+    completed() = snap.completed;
+    chipstuck() = snap.stuck;
+    chippushing() = snap.pushing;
+    couldntmove() = snap.couldntmove;
+    mapbreached() = snap.mapbreached;
+    rebuildcreatureindex();
+    return TRUE;
+}
 
-    return &logic;
+/* Reinstate a snapshot of the starting position, keeping the random
+ * slide direction and the stepping that the previous game left
+ * behind, just as initgame() would.
+ */
+static int restart(gamelogic *logic, unsigned char const *buf, int size)
+{
+    int	dir;
+
+    setstate(logic);
+    dir = engine->lastrndslidedir;
+    if (!restore(logic, buf, size))
+	return FALSE;
+    engine->lastrndslidedir = dir;
+    rndslidedir() = dir;
+    stepping() = engine->laststepping;
+    state->hash = hashstate();
+    return TRUE;
+}
+
+/* Free all allocated resources for this instance of the module.
+ */
+static void shutdown(gamelogic *logic)
+{
+    if (engine == (lxlogic*)logic) {
+	engine = NULL;
+	state = NULL;
+    }
+    free(logic);
+}
+
+/* The exported function: Create and return a new instance of the
+ * module's gamelogic structure.
+ */
+gamelogic *lynxlogicstartup(void)
+{
+    lxlogic    *lx;
+
+    lx = calloc(1, sizeof *lx);
+    if (!lx)
+	memerrexit();
+
+    lx->lastrndslidedir = NORTH;
+    lx->laststepping = 0;
+
+    lx->logic.ruleset = Ruleset_Lynx;
+    lx->logic.localstateinfosize = sizeof(struct lxstate);
+    lx->logic.initgame = initgame;
+    lx->logic.advancegame = advancegame;
+    lx->logic.endgame = endgame;
+    lx->logic.shutdown = shutdown;
+    lx->logic.snapshot = snapshot;
+    lx->logic.restore = restore;
+    lx->logic.restart = restart;
+
+    return &lx->logic;
 }
@@ -10,6 +10,8 @@
 #include	"err.h"
 #include	"state.h"
 #include	"random.h"
+#include	"hash.h"
+#include	"profile.h"
 #include	"logic.h"
 
 #ifdef NDEBUG
@@ -45,23 +47,22 @@ struct msstate {
  */
 static int advancecreature(creature *cr, int dir);
 
-/* The most recently used stepping phase value.
- */
-static int		laststepping = 0;
-
-/* A pointer to the game state, used so that it doesn't have to be
+/* The engine instance currently running on this thread, and a
+ * pointer to its game state, used so that they don't have to be
  * passed to every single function.
  */
-static gamestate       *state;
+static THREADLOCAL struct mslogic      *engine;
+static THREADLOCAL gamestate	       *state;
 
 /*
  * Accessor macros for various fields in the game state. Many of the
  * macros can be used as an lvalue.
  */
 
-#define	setstate(p)		(state = (p)->state)
+#define	setstate(p)		(engine = (struct mslogic*)(p), \
+				 state = (p)->state)
 
-#define	getchip()		(creatures[0])
+#define	getchip()		(crlistat(&engine->creatures, 0))
 #define	chippos()		(getchip()->pos)
 #define	chipdir()		(getchip()->dir)
 
@@ -88,6 +89,14 @@ static gamestate       *state;
 
 #define	cellat(pos)		(&state->map[pos])
 
+/* Take a cell out of the map hash, or put it back in. Every change to
+ * the map is made between a pair of these, so that the map hash never
+ * has to be recomputed.
+ */
+#define	hashcell(cell)		(state->maphash ^= \
+				    hashmapcell((cell) - state->map, (cell)))
+#define	changecell(cell, expr)	(hashcell(cell), (expr), hashcell(cell))
+
 #define	setnosaving()		(state->statusflags |= SF_NOSAVING)
 #define	showhint()		(state->statusflags |= SF_SHOWHINT)
 #define	hidehint()		(state->statusflags &= ~SF_SHOWHINT)
@@ -144,20 +153,29 @@ static short *_possession(int obj)
  * Memory allocation functions for the various arenas.
  */
 
-/* The creature pool is a linked list of lumps, each lump holding this
- * many creatures.
+/* The creatures on a list are kept in the list itself, in order, in
+ * chunks of this many. A chunk is never moved once it has been
+ * allocated, so a pointer to a creature stays good for as long as the
+ * creature is on the list, and a pass over the list reads the
+ * creatures from memory in sequence.
  */
-#define	crpoollumpsize	256
+#define	crchunkshift	8
+#define	crchunksize	(1 << crchunkshift)
 
-/* The data that makes up one lump of the creature pool.
+/* A list of creatures. The chunks are kept when the list is emptied,
+ * to be reused as it fills up again.
  */
-typedef struct crpoollump crpoollump;
-struct crpoollump {
-    int		count;			/* number of unused creatures */
-    crpoollump *prev;			/* the previously allocated lump */
-    crpoollump *next;			/* the next lump after this one */
-    creature	lump[crpoollumpsize];	/* the lump proper */
-};
+typedef	struct crlist {
+    creature  **chunks;			/* the storage for the list */
+    int		count;			/* number of creatures on the list */
+    int		chunkcount;		/* number of chunks allocated */
+    int		chunksallocated;	/* size of the chunks array */
+} crlist;
+
+/* The creature at the given place on a list.
+ */
+#define	crlistat(list, n) \
+    ((list)->chunks[(n) >> crchunkshift] + ((n) & (crchunksize - 1)))
 
 /* The data associated with a sliding object.
  */
@@ -166,77 +184,106 @@ typedef	struct slipper {
     int		dir;
 } slipper;
 
-/* The linked list of creature pools, forming the creature arena.
- */
-static crpoollump      *currentcrpoollump = NULL;
-
-/* The list of active creatures.
- */
-static creature	      **creatures = NULL;
-static int		creaturecount = 0;
-static int		creaturesallocated = 0;
-
-/* The list of "active" blocks.
- */
-static creature	      **blocks = NULL;
-static int		blockcount = 0;
-static int		blocksallocated = 0;
-
-/* The list of sliding creatures.
- */
-static slipper	       *slips = NULL;
-static int		slipcount = 0;
-static int		slipsallocated = 0;
-
-/* Mark all entries in the creature arena as unused.
- */
-static void resetcreaturepool(void)
-{
-    if (currentcrpoollump)
-	while (currentcrpoollump->prev)
-	    currentcrpoollump = currentcrpoollump->prev;
-}
+/* An index of where the visible members of one of the creature lists
+ * are. A location with exactly one such creature points to it
+ * directly. (Locations with more than one are rare, and are handled
+ * by searching the list.)
+ */
+typedef	struct crindex {
+    creature	       *sole[CXGRID * CYGRID];	/* the creature, if only one */
+    unsigned short	count[CXGRID * CYGRID];	/* number of creatures there */
+} crindex;
+
+/* The places on the level that would otherwise have to be found by
+ * searching the map or the wiring. They are worked out when the level
+ * is set up. Nothing during play turns a tile into a teleport or a
+ * toggle wall, so a place can only stop qualifying, and each one is
+ * checked again when it is used. The wiring never changes in play.
+ */
+typedef	struct levelindex {
+    short	prevteleport[CXGRID * CYGRID];	/* nearest teleport before */
+    short	togglewalls[CXGRID * CYGRID];	/* the toggle walls */
+    short	trapfrom[CXGRID * CYGRID];	/* trap wired to each button */
+    short	clonerfrom[CXGRID * CYGRID];	/* cloner each button works */
+    unsigned short trapfirst[CXGRID * CYGRID + 1];  /* where each trap's */
+    short	trapbuttons[256];		/*   buttons are listed */
+    int		teleportcount;			/* number of teleports */
+    int		togglewallcount;		/* number of toggle walls */
+} levelindex;
+
+/* One instance of the MS logic engine. The gamelogic struct comes
+ * first, so that the pointer handed out by mslogicstartup() can be
+ * turned back into the whole instance. Everything here is private to
+ * the instance, so separate instances can run side by side.
+ */
+typedef	struct mslogic {
+    gamelogic	logic;			/* the public interface */
+    int		laststepping;		/* the most recent stepping value */
+    crlist	creatures;		/* the list of active creatures */
+    crlist	blocks;			/* the list of "active" blocks */
+    slipper    *slips;			/* the list of sliding creatures */
+    int		slipcount;
+    int		slipsallocated;
+    crindex	creatureindex;		/* where the active creatures are */
+    crindex	blockindex;		/* where the active blocks are */
+    levelindex	level;			/* where things are on the level */
+    creature	dummycrlist;		/* an empty creature list */
+} mslogic;
+
+/* The MS-specific state as it is stored in a snapshot. The creature
+ * list, the block list, and the slip list follow directly after, with
+ * each slipper's creature given as an index into the first two lists
+ * taken together.
+ */
+typedef	struct mssnapshot {
+    struct msstate	local;		/* the localstateinfo data */
+    int			creaturecount;	/* size of the creature list */
+    int			blockcount;	/* size of the block list */
+    int			slipcount;	/* size of the slip list */
+} mssnapshot;
+
+/* A slip list entry as it is stored in a snapshot.
+ */
+typedef	struct slippersnapshot {
+    int		cr;
+    int		dir;
+} slippersnapshot;
 
-/* Destroy the creature arena.
+/* Destroy the storage of a list of creatures.
  */
-static void freecreaturepool(void)
+static void freecrlist(crlist *list)
 {
-    crpoollump *next;
-
-    resetcreaturepool();
-    while (currentcrpoollump) {
-	next = currentcrpoollump->next;
-	free(currentcrpoollump);
-	currentcrpoollump = next;
-    }
+    while (list->chunkcount)
+	free(list->chunks[--list->chunkcount]);
+    free(list->chunks);
+    list->chunks = NULL;
+    list->chunksallocated = 0;
+    list->count = 0;
 }
 
-/* Return a pointer to a fresh creature.
+/* Return a pointer to a fresh creature at the end of the given list.
+ * The caller fills in the creature and then adds it to the location
+ * index.
  */
-static creature *allocatecreature(void)
+static creature *allocatecreature(crlist *list)
 {
-    crpoollump *next;
     creature   *cr;
+    int		n;
 
-    if (!currentcrpoollump || currentcrpoollump->count == 0) {
-	if (currentcrpoollump && currentcrpoollump->next) {
-	    currentcrpoollump = currentcrpoollump->next;
-	    currentcrpoollump->count = crpoollumpsize;
-	} else {
-	    next = malloc(sizeof *next);
-	    if (!next)
-		memerrexit();
-	    next->count = crpoollumpsize;
-	    next->prev = currentcrpoollump;
-	    next->next = NULL;
-	    if (currentcrpoollump)
-		currentcrpoollump->next = next;
-	    currentcrpoollump = next;
+    if (list->count == list->chunkcount << crchunkshift) {
+	if (list->chunkcount == list->chunksallocated) {
+	    n = list->chunksallocated ? list->chunksallocated * 2 : 4;
+	    xalloc(list->chunks, n * sizeof *list->chunks);
+	    list->chunksallocated = n;
 	}
+	cr = malloc(crchunksize * sizeof *cr);
+	if (!cr)
+	    memerrexit();
+	list->chunks[list->chunkcount++] = cr;
     }
 
-    --currentcrpoollump->count;
-    cr = currentcrpoollump->lump + currentcrpoollump->count;
+    cr = crlistat(list, list->count);
+    ++list->count;
     cr->id = Nothing;
     cr->pos = -1;
     cr->dir = NIL;
@@ -248,53 +295,92 @@ static creature *allocatecreature(void)
     return cr;
 }
 
-/* Empty the list of active creatures.
+/* TRUE if the creature belongs in its list's location index.
  */
-static void resetcreaturelist(void)
+#define	isindexed(cr)	(!(cr)->hidden && (cr)->pos >= 0 \
+				       && (cr)->pos < CXGRID * CYGRID)
+
+/* Return the first visible creature at pos on the given list, other
+ * than skip, or NULL if there is none.
+ */
+static creature *searchlist(crlist const *list, int pos,
+			    creature const *skip)
 {
-    creaturecount = 0;
+    creature   *cr;
+    int		n;
+
+    for (n = 0 ; n < list->count ; ++n) {
+	cr = crlistat(list, n);
+	if (cr != skip && cr->pos == pos && !cr->hidden)
+	    return cr;
+    }
+    return NULL;
 }
 
-/* Append the given creature to the end of the creature list.
+/* Add a creature to the location index of its list, or take it out
+ * again. Every change to the location or visibility of a creature on
+ * one of the lists is made between a pair of these.
  */
-static creature *addtocreaturelist(creature *cr)
+static void indexcreature(creature *cr)
 {
-    if (creaturecount >= creaturesallocated) {
-	creaturesallocated = creaturesallocated ? creaturesallocated * 2 : 16;
-	creatures = realloc(creatures, creaturesallocated * sizeof *creatures);
-	if (!creatures)
-	    memerrexit();
+    crindex    *index;
+
+    if (!isindexed(cr))
+	return;
+    index = cr->id == Block ? &engine->blockindex : &engine->creatureindex;
+    if (index->count[cr->pos]++ == 0)
+	index->sole[cr->pos] = cr;
+}
+
+static void unindexcreature(creature const *cr)
+{
+    crindex    *index;
+
+    if (!isindexed(cr))
+	return;
+    if (cr->id == Block) {
+	index = &engine->blockindex;
+	if (--index->count[cr->pos] == 1)
+	    index->sole[cr->pos] = searchlist(&engine->blocks,
+					      cr->pos, cr);
+    } else {
+	index = &engine->creatureindex;
+	if (--index->count[cr->pos] == 1)
+	    index->sole[cr->pos] = searchlist(&engine->creatures,
+					      cr->pos, cr);
     }
-    creatures[creaturecount++] = cr;
-    return cr;
 }
 
-/* Empty the list of "active" blocks.
+/* Move a creature to a new location.
  */
-static void resetblocklist(void)
+static void setcreaturepos(creature *cr, int pos)
 {
-    blockcount = 0;
+    unindexcreature(cr);
+    cr->pos = pos;
+    indexcreature(cr);
 }
 
-/* Append the given block to the end of the block list.
+/* Empty the list of active creatures.
  */
-static creature *addtoblocklist(creature *cr)
+static void resetcreaturelist(void)
 {
-    if (blockcount >= blocksallocated) {
-	blocksallocated = blocksallocated ? blocksallocated * 2 : 16;
-	blocks = realloc(blocks, blocksallocated * sizeof *blocks);
-	if (!blocks)
-	    memerrexit();
-    }
-    blocks[blockcount++] = cr;
-    return cr;
+    engine->creatures.count = 0;
+    memset(&engine->creatureindex, 0, sizeof engine->creatureindex);
+}
+
+/* Empty the list of "active" blocks.
+ */
+static void resetblocklist(void)
+{
+    engine->blocks.count = 0;
+    memset(&engine->blockindex, 0, sizeof engine->blockindex);
 }
 
 /* Empty the list of sliding creatures.
  */
 static void resetsliplist(void)
 {
-    slipcount = 0;
+    engine->slipcount = 0;
 }
 
 /* Append the given creature to the end of the slip list.
@@ -303,22 +389,21 @@ static creature *appendtosliplist(creature *cr, int dir)
 {
     int	n;
 
-    for (n = 0 ; n < slipcount ; ++n) {
-	if (slips[n].cr == cr) {
-	    slips[n].dir = dir;
+    for (n = 0 ; n < engine->slipcount ; ++n) {
+	if (engine->slips[n].cr == cr) {
+	    engine->slips[n].dir = dir;
 	    return cr;
 	}
     }
 
-    if (slipcount >= slipsallocated) {
-	slipsallocated = slipsallocated ? slipsallocated * 2 : 16;
-	slips = realloc(slips, slipsallocated * sizeof *slips);
-	if (!slips)
-	    memerrexit();
+    if (engine->slipcount >= engine->slipsallocated) {
+	n = engine->slipsallocated ? engine->slipsallocated * 2 : 16;
+	xalloc(engine->slips, n * sizeof *engine->slips);
+	engine->slipsallocated = n;
     }
-    slips[slipcount].cr = cr;
-    slips[slipcount].dir = dir;
-    ++slipcount;
+    engine->slips[engine->slipcount].cr = cr;
+    engine->slips[engine->slipcount].dir = dir;
+    ++engine->slipcount;
     return cr;
 }
 
@@ -328,22 +413,21 @@ static creature *prependtosliplist(creature *cr, int dir)
 {
     int	n;
 
-    if (slipcount && slips[0].cr == cr) {
-	slips[0].dir = dir;
+    if (engine->slipcount && engine->slips[0].cr == cr) {
+	engine->slips[0].dir = dir;
 	return cr;
     }
 
-    if (slipcount >= slipsallocated) {
-	slipsallocated = slipsallocated ? slipsallocated * 2 : 16;
-	slips = realloc(slips, slipsallocated * sizeof *slips);
-	if (!slips)
-	    memerrexit();
+    if (engine->slipcount >= engine->slipsallocated) {
+	n = engine->slipsallocated ? engine->slipsallocated * 2 : 16;
+	xalloc(engine->slips, n * sizeof *engine->slips);
+	engine->slipsallocated = n;
     }
-    for (n = slipcount ; n ; --n)
-	slips[n] = slips[n - 1];
-    ++slipcount;
-    slips[0].cr = cr;
-    slips[0].dir = dir;
+    for (n = engine->slipcount ; n ; --n)
+	engine->slips[n] = engine->slips[n - 1];
+    ++engine->slipcount;
+    engine->slips[0].cr = cr;
+    engine->slips[0].dir = dir;
     return cr;
 }
 
@@ -353,9 +437,9 @@ static int getslipdir(creature *cr)
 {
     int	n;
 
-    for (n = 0 ; n < slipcount ; ++n)
-	if (slips[n].cr == cr)
-	    return slips[n].dir;
+    for (n = 0 ; n < engine->slipcount ; ++n)
+	if (engine->slips[n].cr == cr)
+	    return engine->slips[n].dir;
     return NIL;
 }
 
@@ -365,16 +449,152 @@ static void removefromsliplist(creature *cr)
 {
     int	n;
 
-    for (n = 0 ; n < slipcount ; ++n)
-	if (slips[n].cr == cr)
+    for (n = 0 ; n < engine->slipcount ; ++n)
+	if (engine->slips[n].cr == cr)
 	    break;
-    if (n == slipcount)
+    if (n == engine->slipcount)
 	return;
-    --slipcount;
-    for ( ; n < slipcount ; ++n)
-	slips[n] = slips[n + 1];
+    --engine->slipcount;
+    for ( ; n < engine->slipcount ; ++n)
+	engine->slips[n] = engine->slips[n + 1];
 }
 
+/*
+ * The laws of movement across the various floors.
+ *
+ * Chip, blocks, and other creatures all have slightly different rules
+ * about what sort of tiles they are permitted to move into. The
+ * following lookup table encapsulates these rules. Note that these
+ * rules are only the first check; a creature may be occasionally
+ * permitted a particular type of move but still prevented in a
+ * specific situation. The table also gives the directions in which a
+ * creature may not leave a tile, and flags that classify the tile.
+ * It covers every tile ID, so that anything found on the map can be
+ * looked up without first checking its range.
+ */
+
+#define	NWSE	(NORTH | WEST | SOUTH | EAST)
+
+/* The flags that classify a tile. ML_TRAP marks a tile that can only
+ * be left by a creature that has been released. ML_ONTOP marks an
+ * object that rests on top of the floor. ML_CREATURE marks all
+ * creatures, and ML_CHIP and ML_BLOCK mark Chip (swimming or not)
+ * and blocks among them.
+ */
+#define	ML_TRAP		0x01
+#define	ML_ONTOP	0x02
+#define	ML_CREATURE	0x04
+#define	ML_CHIP		0x08
+#define	ML_BLOCK	0x10
+
+/* The four tiles of a creature, one for each direction.
+ */
+#define	CREATURE(flags)	{ 0, 0, 0, 0, (flags) | ML_ONTOP }, \
+			{ 0, 0, 0, 0, (flags) | ML_ONTOP }, \
+			{ 0, 0, 0, 0, (flags) | ML_ONTOP }, \
+			{ 0, 0, 0, 0, (flags) | ML_ONTOP }
+
+static struct {
+    unsigned char	chip, block, creature, walls, flags;
+} const movelaws[256] = {
+    /* Nothing */		{ 0, 0, 0, 0, 0 },
+    /* Empty */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_North */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_West */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_South */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_East */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Slide_Random */		{ NWSE, NWSE, 0, 0, 0 },
+    /* Ice */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* IceWall_Northwest */	{ SOUTH | EAST, SOUTH | EAST, SOUTH | EAST,
+				  0, 0 },
+    /* IceWall_Northeast */	{ SOUTH | WEST, SOUTH | WEST, SOUTH | WEST,
+				  0, 0 },
+    /* IceWall_Southwest */	{ NORTH | EAST, NORTH | EAST, NORTH | EAST,
+				  0, 0 },
+    /* IceWall_Southeast */	{ NORTH | WEST, NORTH | WEST, NORTH | WEST,
+				  0, 0 },
+    /* Gravel */		{ NWSE, NWSE, 0, 0, 0 },
+    /* Dirt */			{ NWSE, 0, 0, 0, 0 },
+    /* Water */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Fire */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Bomb */			{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Beartrap */		{ NWSE, NWSE, NWSE, NWSE, ML_TRAP },
+    /* Burglar */		{ NWSE, 0, 0, 0, 0 },
+    /* HintButton */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Button_Blue */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Button_Green */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Button_Red */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Button_Brown */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Teleport */		{ NWSE, NWSE, NWSE, 0, 0 },
+    /* Wall */			{ 0, 0, 0, 0, 0 },
+    /* Wall_North */		{ NORTH | WEST | EAST,
+				  NORTH | WEST | EAST,
+				  NORTH | WEST | EAST,
+				  NORTH, 0 },
+    /* Wall_West */		{ NORTH | WEST | SOUTH,
+				  NORTH | WEST | SOUTH,
+				  NORTH | WEST | SOUTH,
+				  WEST, 0 },
+    /* Wall_South */		{ WEST | SOUTH | EAST,
+				  WEST | SOUTH | EAST,
+				  WEST | SOUTH | EAST,
+				  SOUTH, 0 },
+    /* Wall_East */		{ NORTH | SOUTH | EAST,
+				  NORTH | SOUTH | EAST,
+				  NORTH | SOUTH | EAST,
+				  EAST, 0 },
+    /* Wall_Southeast */	{ SOUTH | EAST, SOUTH | EAST, SOUTH | EAST,
+				  SOUTH | EAST, 0 },
+    /* HiddenWall_Perm */	{ 0, 0, 0, 0, 0 },
+    /* HiddenWall_Temp */	{ NWSE, 0, 0, 0, 0 },
+    /* BlueWall_Real */		{ NWSE, 0, 0, 0, 0 },
+    /* BlueWall_Fake */		{ NWSE, 0, 0, 0, 0 },
+    /* SwitchWall_Open */	{ NWSE, NWSE, NWSE, 0, 0 },
+    /* SwitchWall_Closed */	{ 0, 0, 0, 0, 0 },
+    /* PopupWall */		{ NWSE, 0, 0, 0, 0 },
+    /* CloneMachine */		{ 0, 0, 0, 0, 0 },
+    /* Door_Red */		{ NWSE, 0, 0, 0, 0 },
+    /* Door_Blue */		{ NWSE, 0, 0, 0, 0 },
+    /* Door_Yellow */		{ NWSE, 0, 0, 0, 0 },
+    /* Door_Green */		{ NWSE, 0, 0, 0, 0 },
+    /* Socket */		{ NWSE, 0, 0, 0, 0 },
+    /* Exit */			{ NWSE, NWSE, 0, 0, 0 },
+    /* ICChip */		{ NWSE, 0, 0, 0, 0 },
+    /* Key_Red */		{ NWSE, NWSE, NWSE, 0, ML_ONTOP },
+    /* Key_Blue */		{ NWSE, NWSE, NWSE, 0, ML_ONTOP },
+    /* Key_Yellow */		{ NWSE, NWSE, NWSE, 0, ML_ONTOP },
+    /* Key_Green */		{ NWSE, NWSE, NWSE, 0, ML_ONTOP },
+    /* Boots_Ice */		{ NWSE, NWSE, 0, 0, ML_ONTOP },
+    /* Boots_Slide */		{ NWSE, NWSE, 0, 0, ML_ONTOP },
+    /* Boots_Fire */		{ NWSE, NWSE, 0, 0, ML_ONTOP },
+    /* Boots_Water */		{ NWSE, NWSE, 0, 0, ML_ONTOP },
+    /* Block_Static */		{ NWSE, 0, 0, 0, 0 },
+    /* Drowned_Chip */		{ 0, 0, 0, 0, 0 },
+    /* Burned_Chip */		{ 0, 0, 0, 0, 0 },
+    /* Bombed_Chip */		{ 0, 0, 0, 0, 0 },
+    /* Exited_Chip */		{ 0, 0, 0, 0, 0 },
+    /* Exit_Extra_1 */		{ 0, 0, 0, 0, 0 },
+    /* Exit_Extra_2 */		{ 0, 0, 0, 0, 0 },
+    /* Overlay_Buffer */	{ 0, 0, 0, 0, 0 },
+    /* Floor_Reserved2 */	{ 0, 0, 0, 0, 0 },
+    /* Floor_Reserved1 */	{ 0, 0, 0, 0, 0 },
+    /* Chip */			CREATURE(ML_CREATURE | ML_CHIP),
+    /* Block */			CREATURE(ML_CREATURE | ML_BLOCK),
+    /* Tank */			CREATURE(ML_CREATURE),
+    /* Ball */			CREATURE(ML_CREATURE),
+    /* Glider */		CREATURE(ML_CREATURE),
+    /* Fireball */		CREATURE(ML_CREATURE),
+    /* Walker */		CREATURE(ML_CREATURE),
+    /* Blob */			CREATURE(ML_CREATURE),
+    /* Teeth */			CREATURE(ML_CREATURE),
+    /* Bug */			CREATURE(ML_CREATURE),
+    /* Paramecium */		CREATURE(ML_CREATURE),
+    /* Swimming_Chip */		CREATURE(ML_CREATURE | ML_CHIP),
+    /* Pushing_Chip */		CREATURE(ML_CREATURE),
+    /* Entity_Reserved2 */	CREATURE(ML_CREATURE),
+    /* Entity_Reserved1 */	CREATURE(ML_CREATURE)
+};
+
 /*
  * Simple floor functions.
  */
@@ -426,6 +646,8 @@ static int trapfrombutton(int pos)
     xyconn     *traps;
     int		i;
 
+    if (pos >= 0 && pos < CXGRID * CYGRID)
+	return engine->level.trapfrom[pos];
     traps = traplist();
     for (i = traplistsize() ; i ; ++traps, --i)
 	if (traps->from == pos)
@@ -440,6 +662,8 @@ static int clonerfrombutton(int pos)
     xyconn     *cloners;
     int		i;
 
+    if (pos >= 0 && pos < CXGRID * CYGRID)
+	return engine->level.clonerfrom[pos];
     cloners = clonerlist();
     for (i = clonerlistsize() ; i ; ++cloners, --i)
 	if (cloners->from == pos)
@@ -454,11 +678,9 @@ static int floorat(int pos)
     mapcell    *cell;
 
     cell = cellat(pos);
-    if (!iskey(cell->top.id) && !isboots(cell->top.id)
-			     && !iscreature(cell->top.id))
+    if (!(movelaws[cell->top.id].flags & ML_ONTOP))
 	return cell->top.id;
-    if (!iskey(cell->bot.id) && !isboots(cell->bot.id)
-			     && !iscreature(cell->bot.id))
+    if (!(movelaws[cell->bot.id].flags & ML_ONTOP))
 	return cell->bot.id;
     return Empty;
 }
@@ -471,11 +693,9 @@ static maptile *getfloorat(int pos)
     mapcell    *cell;
 
     cell = cellat(pos);
-    if (!iskey(cell->top.id) && !isboots(cell->top.id)
-			     && !iscreature(cell->top.id))
+    if (!(movelaws[cell->top.id].flags & ML_ONTOP))
 	return &cell->top;
-    if (!iskey(cell->bot.id) && !isboots(cell->bot.id)
-			     && !iscreature(cell->bot.id))
+    if (!(movelaws[cell->bot.id].flags & ML_ONTOP))
 	return &cell->bot;
     return &cell->bot; /* ? */
 }
@@ -497,8 +717,10 @@ static void pushtile(int pos, maptile tile)
     mapcell    *cell;
 
     cell = cellat(pos);
+    hashcell(cell);
     cell->bot = cell->top;
     cell->top = tile;
+    hashcell(cell);
 }
 
 /* Remove the upper tile from the given location, causing the current
@@ -510,10 +732,12 @@ static maptile poptile(int pos)
     mapcell    *cell;
 
     cell = cellat(pos);
+    hashcell(cell);
     tile = cell->top;
     cell->top = cell->bot;
     cell->bot.id = Empty;
     cell->bot.state = 0;
+    hashcell(cell);
     return tile;
 }
 
@@ -521,13 +745,12 @@ static maptile poptile(int pos)
  */
 static int istrapopen(int pos, int skippos)
 {
-    xyconn     *traps;
-    int		i;
+    levelindex const   *li = &engine->level;
+    int			i;
 
-    traps = traplist();
-    for (i = traplistsize() ; i ; ++traps, --i)
-	if (traps->to == pos && traps->from != skippos
-			     && istrapbuttondown(traps->from))
+    for (i = li->trapfirst[pos] ; i < li->trapfirst[pos + 1] ; ++i)
+	if (li->trapbuttons[i] != skippos
+				&& istrapbuttondown(li->trapbuttons[i]))
 	    return TRUE;
     return FALSE;
 }
@@ -537,18 +760,20 @@ static int istrapopen(int pos, int skippos)
 static void togglewalls(void)
 {
     mapcell    *cell;
-    int		pos;
+    int		n;
 
-    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
-	cell = cellat(pos);
+    for (n = 0 ; n < engine->level.togglewallcount ; ++n) {
+	cell = cellat(engine->level.togglewalls[n]);
 	if ((cell->top.id == SwitchWall_Open
 				|| cell->top.id == SwitchWall_Closed)
 			&& !(cell->top.state & FS_BROKEN))
-	    cell->top.id ^= SwitchWall_Open ^ SwitchWall_Closed;
+	    changecell(cell, cell->top.id ^= SwitchWall_Open
+					    ^ SwitchWall_Closed);
 	if ((cell->bot.id == SwitchWall_Open
 				|| cell->bot.id == SwitchWall_Closed)
 			&& !(cell->bot.state & FS_BROKEN))
-	    cell->bot.id ^= SwitchWall_Open ^ SwitchWall_Closed;
+	    changecell(cell, cell->bot.id ^= SwitchWall_Open
+					    ^ SwitchWall_Closed);
     }
 }
 
@@ -567,21 +792,71 @@ static void togglewalls(void)
 #define	CS_DEFERPUSH		0x40	/* button pushes will be delayed */
 #define	CS_MUTANT		0x80	/* block is mutant, looks like Chip */
 
+/* Rebuild the location indexes of both lists from scratch.
+ */
+static void rebuildcreatureindex(void)
+{
+    int	n;
+
+    memset(&engine->creatureindex, 0, sizeof engine->creatureindex);
+    memset(&engine->blockindex, 0, sizeof engine->blockindex);
+    for (n = 0 ; n < engine->creatures.count ; ++n)
+	indexcreature(crlistat(&engine->creatures, n));
+    for (n = 0 ; n < engine->blocks.count ; ++n)
+	indexcreature(crlistat(&engine->blocks, n));
+}
+
+#ifndef NDEBUG
+
+/* Return TRUE if the location indexes agree with the lists.
+ */
+static int checkcreatureindex(void)
+{
+    crindex	saved[2];
+    crindex    *index;
+    int		pos, i;
+
+    saved[0] = engine->creatureindex;
+    saved[1] = engine->blockindex;
+    rebuildcreatureindex();
+    for (i = 0 ; i < 2 ; ++i) {
+	index = i ? &engine->blockindex : &engine->creatureindex;
+	for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
+	    if (saved[i].count[pos] != index->count[pos])
+		return FALSE;
+	    if (index->count[pos] == 1
+			&& saved[i].sole[pos] != index->sole[pos])
+		return FALSE;
+	}
+    }
+    return TRUE;
+}
+
+#endif
+
 /* Return the creature located at pos. Ignores Chip unless includechip
  * is TRUE. Return NULL if no such creature is present.
  */
 static creature *lookupcreature(int pos, int includechip)
 {
-    int	n;
+    creature   *cr;
+    int		n;
 
-    if (!creatures)
+    switch (engine->creatureindex.count[pos]) {
+      case 0:
 	return NULL;
-    for (n = 0 ; n < creaturecount ; ++n) {
-	if (creatures[n]->hidden)
+      case 1:
+	cr = engine->creatureindex.sole[pos];
+	return cr->id != Chip || includechip ? cr : NULL;
+    }
+
+    for (n = 0 ; n < engine->creatures.count ; ++n) {
+	cr = crlistat(&engine->creatures, n);
+	if (cr->hidden)
 	    continue;
-	if (creatures[n]->pos == pos)
-	    if (creatures[n]->id != Chip || includechip)
-		return creatures[n];
+	if (cr->pos == pos)
+	    if (cr->id != Chip || includechip)
+		return cr;
     }
     return NULL;
 }
@@ -592,15 +867,14 @@ static creature *lookupcreature(int pos, int includechip)
 static creature *lookupblock(int pos)
 {
     creature   *cr;
-    int		id, n;
+    int		id;
 
-    if (blocks) {
-	for (n = 0 ; n < blockcount ; ++n)
-	    if (blocks[n]->pos == pos && !blocks[n]->hidden)
-		return blocks[n];
-    }
+    if (engine->blockindex.count[pos] == 1)
+	return engine->blockindex.sole[pos];
+    if (engine->blockindex.count[pos])
+	return searchlist(&engine->blocks, pos, NULL);
 
-    cr = allocatecreature();
+    cr = allocatecreature(&engine->blocks);
     cr->id = Block;
     cr->pos = pos;
     id = cellat(pos)->top.id;
@@ -611,20 +885,16 @@ static creature *lookupblock(int pos)
     else
 	_assert(!"lookupblock() called on blockless location");
 
-    return addtoblocklist(cr);
+    indexcreature(cr);
+    return cr;
 }
 
-/* Update the given creature's tile on the map to reflect its current
- * state.
+/* Set the given map tile to show the creature in its current state.
  */
-static void updatecreature(creature const *cr)
+static void setcreaturetile(maptile *tile, creature const *cr)
 {
-    maptile    *tile;
-    int		id, dir;
+    int	id, dir;
 
-    if (cr->hidden)
-	return;
-    tile = &cellat(cr->pos)->top;
     id = cr->id;
     if (id == Block) {
 	tile->id = Block_Static;
@@ -650,6 +920,19 @@ static void updatecreature(creature const *cr)
     tile->state = 0;
 }
 
+/* Update the given creature's tile on the map to reflect its current
+ * state.
+ */
+static void updatecreature(creature const *cr)
+{
+    mapcell    *cell;
+
+    if (cr->hidden)
+	return;
+    cell = cellat(cr->pos);
+    changecell(cell, setcreaturetile(&cell->top, cr));
+}
+
 /* Add the given creature's tile to the map.
  */
 static void addcreaturetomap(creature const *cr)
@@ -667,16 +950,19 @@ static void addcreaturetomap(creature const *cr)
 static creature *awakencreature(int pos)
 {
     creature   *new;
-    int		tileid;
+    int		tileid, id;
 
     tileid = cellat(pos)->top.id;
     if (!iscreature(tileid) || creatureid(tileid) == Chip)
 	return NULL;
-    new = allocatecreature();
-    new->id = creatureid(tileid);
+    id = creatureid(tileid);
+    new = allocatecreature(id == Block ? &engine->blocks
+				       : &engine->creatures);
+    new->id = id;
     new->dir = creaturedirid(tileid);
     new->pos = pos;
-    return new->id == Block ? addtoblocklist(new) : addtocreaturelist(new);
+    indexcreature(new);
+    return new;
 }
 
 /* Mark a creature as dead.
@@ -687,8 +973,10 @@ static void removecreature(creature *cr)
     if (cr->id == Chip) {
 	if (chipstatus() == CHIP_OKAY)
 	    chipstatus() = CHIP_NOTOKAY;
-    } else
+    } else {
+	unindexcreature(cr);
 	cr->hidden = TRUE;
+    }
 }
 
 /* Turn around any and all tanks. (A tank that is halfway through the
@@ -696,24 +984,26 @@ static void removecreature(creature *cr)
  */
 static void turntanks(creature const *inmidmove)
 {
-    int	n;
+    creature   *cr;
+    int		n;
 
-    for (n = 0 ; n < creaturecount ; ++n) {
-	if (creatures[n]->hidden || creatures[n]->id != Tank)
+    for (n = 0 ; n < engine->creatures.count ; ++n) {
+	cr = crlistat(&engine->creatures, n);
+	if (cr->hidden || cr->id != Tank)
 	    continue;
-	creatures[n]->dir = back(creatures[n]->dir);
-	if (!(creatures[n]->state & CS_TURNING))
-	    creatures[n]->state |= CS_TURNING | CS_HASMOVED;
-	if (creatures[n] != inmidmove) {
-	    if (creatureid(cellat(creatures[n]->pos)->top.id) == Tank) {
-		updatecreature(creatures[n]);
+	cr->dir = back(cr->dir);
+	if (!(cr->state & CS_TURNING))
+	    cr->state |= CS_TURNING | CS_HASMOVED;
+	if (cr != inmidmove) {
+	    if (creatureid(cellat(cr->pos)->top.id) == Tank) {
+		updatecreature(cr);
 	    } else {
-		if (creatures[n]->state & CS_TURNING) {
-		    creatures[n]->state &= ~CS_TURNING;
-		    updatecreature(creatures[n]);
-		    creatures[n]->state |= CS_TURNING;
+		if (cr->state & CS_TURNING) {
+		    cr->state &= ~CS_TURNING;
+		    updatecreature(cr);
+		    cr->state |= CS_TURNING;
 		}
-		creatures[n]->dir = back(creatures[n]->dir);
+		cr->dir = back(cr->dir);
 	    }
 	}
     }
@@ -768,99 +1058,11 @@ static void updatesliplist()
 {
     int	n;
 
-    for (n = slipcount - 1 ; n >= 0 ; --n)
-	if (!(slips[n].cr->state & (CS_SLIP | CS_SLIDE)))
-	    endfloormovement(slips[n].cr);
+    for (n = engine->slipcount - 1 ; n >= 0 ; --n)
+	if (!(engine->slips[n].cr->state & (CS_SLIP | CS_SLIDE)))
+	    endfloormovement(engine->slips[n].cr);
 }
 
-/*
- * The laws of movement across the various floors.
- *
- * Chip, blocks, and other creatures all have slightly different rules
- * about what sort of tiles they are permitted to move into. The
- * following lookup table encapsulates these rules. Note that these
- * rules are only the first check; a creature may be occasionally
- * permitted a particular type of move but still prevented in a
- * specific situation.
- */
-
-#define	NWSE	(NORTH | WEST | SOUTH | EAST)
-
-static struct { unsigned char chip, block, creature; } const movelaws[] = {
-    /* Nothing */		{ 0, 0, 0 },
-    /* Empty */			{ NWSE, NWSE, NWSE },
-    /* Slide_North */		{ NWSE, NWSE, NWSE },
-    /* Slide_West */		{ NWSE, NWSE, NWSE },
-    /* Slide_South */		{ NWSE, NWSE, NWSE },
-    /* Slide_East */		{ NWSE, NWSE, NWSE },
-    /* Slide_Random */		{ NWSE, NWSE, 0 },
-    /* Ice */			{ NWSE, NWSE, NWSE },
-    /* IceWall_Northwest */	{ SOUTH | EAST, SOUTH | EAST, SOUTH | EAST },
-    /* IceWall_Northeast */	{ SOUTH | WEST, SOUTH | WEST, SOUTH | WEST },
-    /* IceWall_Southwest */	{ NORTH | EAST, NORTH | EAST, NORTH | EAST },
-    /* IceWall_Southeast */	{ NORTH | WEST, NORTH | WEST, NORTH | WEST },
-    /* Gravel */		{ NWSE, NWSE, 0 },
-    /* Dirt */			{ NWSE, 0, 0 },
-    /* Water */			{ NWSE, NWSE, NWSE },
-    /* Fire */			{ NWSE, NWSE, NWSE },
-    /* Bomb */			{ NWSE, NWSE, NWSE },
-    /* Beartrap */		{ NWSE, NWSE, NWSE },
-    /* Burglar */		{ NWSE, 0, 0 },
-    /* HintButton */		{ NWSE, NWSE, NWSE },
-    /* Button_Blue */		{ NWSE, NWSE, NWSE },
-    /* Button_Green */		{ NWSE, NWSE, NWSE },
-    /* Button_Red */		{ NWSE, NWSE, NWSE },
-    /* Button_Brown */		{ NWSE, NWSE, NWSE },
-    /* Teleport */		{ NWSE, NWSE, NWSE },
-    /* Wall */			{ 0, 0, 0 },
-    /* Wall_North */		{ NORTH | WEST | EAST,
-				  NORTH | WEST | EAST,
-				  NORTH | WEST | EAST },
-    /* Wall_West */		{ NORTH | WEST | SOUTH,
-				  NORTH | WEST | SOUTH,
-				  NORTH | WEST | SOUTH },
-    /* Wall_South */		{ WEST | SOUTH | EAST,
-				  WEST | SOUTH | EAST,
-				  WEST | SOUTH | EAST },
-    /* Wall_East */		{ NORTH | SOUTH | EAST,
-				  NORTH | SOUTH | EAST,
-				  NORTH | SOUTH | EAST },
-    /* Wall_Southeast */	{ SOUTH | EAST, SOUTH | EAST, SOUTH | EAST },
-    /* HiddenWall_Perm */	{ 0, 0, 0 },
-    /* HiddenWall_Temp */	{ NWSE, 0, 0 },
-    /* BlueWall_Real */		{ NWSE, 0, 0 },
-    /* BlueWall_Fake */		{ NWSE, 0, 0 },
-    /* SwitchWall_Open */	{ NWSE, NWSE, NWSE },
-    /* SwitchWall_Closed */	{ 0, 0, 0 },
-    /* PopupWall */		{ NWSE, 0, 0 },
-    /* CloneMachine */		{ 0, 0, 0 },
-    /* Door_Red */		{ NWSE, 0, 0 },
-    /* Door_Blue */		{ NWSE, 0, 0 },
-    /* Door_Yellow */		{ NWSE, 0, 0 },
-    /* Door_Green */		{ NWSE, 0, 0 },
-    /* Socket */		{ NWSE, 0, 0 },
-    /* Exit */			{ NWSE, NWSE, 0 },
-    /* ICChip */		{ NWSE, 0, 0 },
-    /* Key_Red */		{ NWSE, NWSE, NWSE },
-    /* Key_Blue */		{ NWSE, NWSE, NWSE },
-    /* Key_Yellow */		{ NWSE, NWSE, NWSE },
-    /* Key_Green */		{ NWSE, NWSE, NWSE },
-    /* Boots_Ice */		{ NWSE, NWSE, 0 },
-    /* Boots_Slide */		{ NWSE, NWSE, 0 },
-    /* Boots_Fire */		{ NWSE, NWSE, 0 },
-    /* Boots_Water */		{ NWSE, NWSE, 0 },
-    /* Block_Static */		{ NWSE, 0, 0 },
-    /* Drowned_Chip */		{ 0, 0, 0 },
-    /* Burned_Chip */		{ 0, 0, 0 },
-    /* Bombed_Chip */		{ 0, 0, 0 },
-    /* Exited_Chip */		{ 0, 0, 0 },
-    /* Exit_Extra_1 */		{ 0, 0, 0 },
-    /* Exit_Extra_2 */		{ 0, 0, 0 },
-    /* Overlay_Buffer */	{ 0, 0, 0 },
-    /* Floor_Reserved2 */	{ 0, 0, 0 },
-    /* Floor_Reserved1 */	{ 0, 0, 0 },
-};
-
 /* Including the flag CMM_NOLEAVECHECK in a call to canmakemove()
  * indicates that the tile the creature is moving out of is
  * automatically presumed to permit such movement. CMM_NOEXPOSEWALLS
@@ -907,7 +1109,7 @@ static int pushblock(int pos, int dir, int flags)
     }
 
     if (!(flags & CMM_TELEPORTPUSH) && cellat(pos)->bot.id == Block_Static)
-	cellat(pos)->bot.id = Empty;
+	changecell(cellat(pos), cellat(pos)->bot.id = Empty);
     if (!(flags & CMM_NODEFERBUTTONS))
 	cr->state |= CS_DEFERPUSH;
     r = advancecreature(cr, dir);
@@ -926,7 +1128,7 @@ static int canmakemove(creature const *cr, int dir, int flags)
 {
     int		to;
     int		floor;
-    int		id, y, x;
+    int		y, x;
 
     _assert(cr);
     _assert(dir != NIL);
@@ -940,17 +1142,11 @@ static int canmakemove(creature const *cr, int dir, int flags)
     to = y * CXGRID + x;
 
     if (!(flags & CMM_NOLEAVECHECK)) {
-	switch (cellat(cr->pos)->bot.id) {
-	  case Wall_North: 	if (dir == NORTH) return FALSE;		break;
-	  case Wall_West: 	if (dir == WEST)  return FALSE;		break;
-	  case Wall_South: 	if (dir == SOUTH) return FALSE;		break;
-	  case Wall_East: 	if (dir == EAST)  return FALSE;		break;
-	  case Wall_Southeast:	if (dir & (SOUTH | EAST)) return FALSE;	break;
-	  case Beartrap:
-	    if (!(cr->state & CS_RELEASED))
+	floor = cellat(cr->pos)->bot.id;
+	if (movelaws[floor].walls & dir)
+	    if (!(movelaws[floor].flags & ML_TRAP)
+				|| !(cr->state & CS_RELEASED))
 		return FALSE;
-	    break;
-	}
     }
 
     if (cr->id == Chip) {
@@ -961,14 +1157,11 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	    return FALSE;
 	if (isdoor(floor) && !possession(floor))
 	    return FALSE;
-	if (iscreature(cellat(to)->top.id)) {
-	    id = creatureid(cellat(to)->top.id);
-	    if (id == Chip || id == Swimming_Chip || id == Block)
-		return FALSE;
-	}
+	if (movelaws[cellat(to)->top.id].flags & (ML_CHIP | ML_BLOCK))
+	    return FALSE;
 	if (floor == HiddenWall_Temp || floor == BlueWall_Real) {
 	    if (!(flags & CMM_NOEXPOSEWALLS))
-		getfloorat(to)->id = Wall;
+		changecell(cellat(to), getfloorat(to)->id = Wall);
 	    return FALSE;
 	}
 	if (floor == Block_Static) {
@@ -983,25 +1176,18 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	}
     } else if (cr->id == Block) {
 	floor = cellat(to)->top.id;
-	if (iscreature(floor)) {
-	    id = creatureid(floor);
-	    return id == Chip || id == Swimming_Chip;
-	}
+	if (movelaws[floor].flags & ML_CREATURE)
+	    return (movelaws[floor].flags & ML_CHIP) != 0;
 	if (!(movelaws[floor].block & dir))
 	    return FALSE;
     } else {
 	floor = cellat(to)->top.id;
-	if (iscreature(floor)) {
-	    id = creatureid(floor);
-	    if (id == Chip || id == Swimming_Chip) {
-		floor = cellat(to)->bot.id;
-		if (iscreature(floor)) {
-		    id = creatureid(floor);
-		    return id == Chip || id == Swimming_Chip;
-		}
-	    }
+	if (movelaws[floor].flags & ML_CHIP) {
+	    floor = cellat(to)->bot.id;
+	    if (movelaws[floor].flags & ML_CREATURE)
+		return (movelaws[floor].flags & ML_CHIP) != 0;
 	}
-	if (iscreature(floor)) {
+	if (movelaws[floor].flags & ML_CREATURE) {
 	    if ((flags & CMM_CLONECANTBLOCK)
 				&& floor == crtile(cr->id, cr->dir))
 		return TRUE;
@@ -1298,7 +1484,7 @@ static void choosechipmove(creature *cr, int discard)
 static int teleportcreature(creature *cr, int start)
 {
     maptile    *tile;
-    int		dest, origpos, f;
+    int		dest, origpos, f, n;
 
     _assert(!cr->hidden);
     if (cr->dir == NIL) {
@@ -1310,24 +1496,24 @@ static int teleportcreature(creature *cr, int start)
     origpos = cr->pos;
     dest = start;
 
-    for (;;) {
-	--dest;
-	if (dest < 0)
-	    dest += CXGRID * CYGRID;
+    for (n = engine->level.teleportcount ; n ; --n) {
+	dest = engine->level.prevteleport[dest];
 	if (dest == start)
 	    break;
 	tile = &cellat(dest)->top;
 	if (tile->id != Teleport || (tile->state & FS_BROKEN))
 	    continue;
-	cr->pos = dest;
+	setcreaturepos(cr, dest);
 	f = canmakemove(cr, cr->dir, CMM_NOLEAVECHECK | CMM_NOEXPOSEWALLS
 						      | CMM_NODEFERBUTTONS
 						      | CMM_NOFIRECHECK
 						      | CMM_TELEPORTPUSH);
-	cr->pos = origpos;
+	setcreaturepos(cr, origpos);
 	if (f)
 	    break;
     }
+    if (!n)
+	dest = start;
 
     return dest;
 }
@@ -1378,7 +1564,7 @@ static void activatecloner(int buttonpos)
 	    return;
 	cr->state |= CS_CLONING;
 	if (cellat(pos)->bot.id == CloneMachine)
-	    cellat(pos)->bot.state |= FS_CLONING;
+	    changecell(cellat(pos), cellat(pos)->bot.state |= FS_CLONING);
     }
 }
 
@@ -1413,11 +1599,17 @@ static void springtrap(int buttonpos)
  */
 static void resetbuttons(void)
 {
-    int	pos;
+    mapcell    *cell;
+    int		pos;
 
     for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
-	cellat(pos)->top.state &= ~FS_BUTTONDOWN;
-	cellat(pos)->bot.state &= ~FS_BUTTONDOWN;
+	cell = cellat(pos);
+	if ((cell->top.state | cell->bot.state) & FS_BUTTONDOWN) {
+	    hashcell(cell);
+	    cell->top.state &= ~FS_BUTTONDOWN;
+	    cell->bot.state &= ~FS_BUTTONDOWN;
+	    hashcell(cell);
+	}
     }
 }
 
@@ -1429,10 +1621,10 @@ static void handlebuttons(void)
 
     for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
 	if (cellat(pos)->top.state & FS_BUTTONDOWN) {
-	    cellat(pos)->top.state &= ~FS_BUTTONDOWN;
+	    changecell(cellat(pos), cellat(pos)->top.state &= ~FS_BUTTONDOWN);
 	    id = cellat(pos)->top.id;
 	} else if (cellat(pos)->bot.state & FS_BUTTONDOWN) {
-	    cellat(pos)->bot.state &= ~FS_BUTTONDOWN;
+	    changecell(cellat(pos), cellat(pos)->bot.state &= ~FS_BUTTONDOWN);
 	    id = cellat(pos)->bot.id;
 	} else {
 	    continue;
@@ -1487,7 +1679,8 @@ static int startmovement(creature *cr, int dir)
     if (floor == Beartrap) {
 	_assert(cr->state & CS_RELEASED);
 	if (cr->state & CS_MUTANT)
-	    cellat(cr->pos)->bot.state &= ~FS_HASMUTANT;
+	    changecell(cellat(cr->pos),
+		       cellat(cr->pos)->bot.state &= ~FS_HASMUTANT);
     }
     cr->state &= ~CS_RELEASED;
 
@@ -1538,7 +1731,7 @@ static void endmovement(creature *cr, int dir)
 	    poptile(newpos);
 	    break;
 	  case PopupWall:
-	    tile->id = Wall;
+	    changecell(cell, tile->id = Wall);
 	    break;
 	  case Door_Red:
 	  case Door_Blue:
@@ -1597,12 +1790,12 @@ static void endmovement(creature *cr, int dir)
 	    poptile(newpos);
 	    break;
 	  case Water:
-	    tile->id = Dirt;
+	    changecell(cell, tile->id = Dirt);
 	    dead = TRUE;
 	    addsoundeffect(SND_WATER_SPLASH);
 	    break;
 	  case Bomb:
-	    tile->id = Empty;
+	    changecell(cell, tile->id = Empty);
 	    dead = TRUE;
 	    addsoundeffect(SND_BOMB_EXPLODES);
 	    break;
@@ -1629,7 +1822,7 @@ static void endmovement(creature *cr, int dir)
 		dead = TRUE;
 	    break;
 	  case Bomb:
-	    cell->top.id = Empty;
+	    changecell(cell, cell->top.id = Empty);
 	    dead = TRUE;
 	    addsoundeffect(SND_BOMB_EXPLODES);
 	    break;
@@ -1645,7 +1838,8 @@ static void endmovement(creature *cr, int dir)
     if (dead) {
 	removecreature(cr);
 	if (cellat(oldpos)->bot.id == CloneMachine)
-	    cellat(oldpos)->bot.state &= ~FS_CLONING;
+	    changecell(cellat(oldpos),
+		       cellat(oldpos)->bot.state &= ~FS_CLONING);
 	return;
     }
 
@@ -1657,7 +1851,8 @@ static void endmovement(creature *cr, int dir)
 	    if (floorat(newpos) == Block_Static) {
 		if (lastslipdir() == NIL) {
 		    cr->dir = NORTH;
-		    cellat(newpos)->top.id = crtile(Chip, NORTH);
+		    changecell(cellat(newpos), cellat(newpos)->top.id
+							= crtile(Chip, NORTH));
 		    floor = Empty;
 		} else {
 		    cr->dir = lastslipdir();
@@ -1666,56 +1861,53 @@ static void endmovement(creature *cr, int dir)
 	}
     }
 
-    cr->pos = newpos;
+    setcreaturepos(cr, newpos);
     addcreaturetomap(cr);
-    cr->pos = oldpos;
+    setcreaturepos(cr, oldpos);
 
     tile = &cell->bot;
     switch (floor) {
       case Button_Blue:
 	if (cr->state & CS_DEFERPUSH)
-	    tile->state |= FS_BUTTONDOWN;
+	    changecell(cell, tile->state |= FS_BUTTONDOWN);
 	else
 	    turntanks(cr);
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
       case Button_Green:
 	if (cr->state & CS_DEFERPUSH)
-	    tile->state |= FS_BUTTONDOWN;
+	    changecell(cell, tile->state |= FS_BUTTONDOWN);
 	else
 	    togglewalls();
 	break;
       case Button_Red:
 	if (cr->state & CS_DEFERPUSH)
-	    tile->state |= FS_BUTTONDOWN;
+	    changecell(cell, tile->state |= FS_BUTTONDOWN);
 	else
 	    activatecloner(newpos);
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
       case Button_Brown:
 	if (cr->state & CS_DEFERPUSH)
-	    tile->state |= FS_BUTTONDOWN;
+	    changecell(cell, tile->state |= FS_BUTTONDOWN);
 	else
 	    springtrap(newpos);
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
     }
 
-    cr->pos = newpos;
+    setcreaturepos(cr, newpos);
 
     if (cellat(oldpos)->bot.id == CloneMachine)
-	cellat(oldpos)->bot.state &= ~FS_CLONING;
+	changecell(cellat(oldpos), cellat(oldpos)->bot.state &= ~FS_CLONING);
 
     if (floor == Beartrap) {
 	if (istrapopen(newpos, oldpos))
 	    cr->state |= CS_RELEASED;
     } else if (cellat(newpos)->bot.id == Beartrap) {
-	for (i = 0 ; i < traplistsize() ; ++i) {
-	    if (traplist()[i].to == newpos) {
-		cr->state |= CS_RELEASED;
-		break;
-	    }
-	}
+	if (engine->level.trapfirst[newpos]
+				< engine->level.trapfirst[newpos + 1])
+	    cr->state |= CS_RELEASED;
     }
 
     if (cr->id == Chip) {
@@ -1748,7 +1940,7 @@ static void endmovement(creature *cr, int dir)
     else if (floor == Beartrap && cr->id == Block && wasslipping) {
 	startfloormovement(cr, floor);
 	if (cr->state & CS_MUTANT)
-	    cell->bot.state |= FS_HASMUTANT;
+	    changecell(cell, cell->bot.state |= FS_HASMUTANT);
     } else
 	cr->state &= ~(CS_SLIP | CS_SLIDE);
 
@@ -1811,12 +2003,12 @@ static void floormovements(void)
     int		floor, slipdir;
     int		savedcount, n;
 
-    for (n = 0 ; n < slipcount ; ++n) {
-	savedcount = slipcount;
-	cr = slips[n].cr;
-	if (!(slips[n].cr->state & (CS_SLIP | CS_SLIDE)))
+    for (n = 0 ; n < engine->slipcount ; ++n) {
+	savedcount = engine->slipcount;
+	cr = engine->slips[n].cr;
+	if (!(engine->slips[n].cr->state & (CS_SLIP | CS_SLIDE)))
 	    continue;
-	slipdir = slips[n].dir;
+	slipdir = engine->slips[n].dir;
 	if (slipdir == NIL)
 	    continue;
 	if (cr->id == Chip)
@@ -1851,18 +2043,21 @@ static void floormovements(void)
 	if (checkforending())
 	    return;
 	if (!(cr->state & (CS_SLIP | CS_SLIDE)) && cr->id != Chip
-						&& slipcount == savedcount + 1)
+				&& engine->slipcount == savedcount + 1)
 	    ++n;
     }
 }
 
 static void createclones(void)
 {
-    int	n;
+    creature   *cr;
+    int		n;
 
-    for (n = 0 ; n < creaturecount ; ++n)
-	if (creatures[n]->state & CS_CLONING)
-	    creatures[n]->state &= ~CS_CLONING;
+    for (n = 0 ; n < engine->creatures.count ; ++n) {
+	cr = crlistat(&engine->creatures, n);
+	if (cr->state & CS_CLONING)
+	    cr->state &= ~CS_CLONING;
+    }
 }
 
 #ifndef NDEBUG
@@ -1888,13 +2083,13 @@ static void dumpmap(void)
 	fputc('\n', stderr);
     }
     fputc('\n', stderr);
-    for (y = 0 ; y < creaturecount ; ++y) {
-	cr = creatures[y];
+    for (y = 0 ; y < engine->creatures.count ; ++y) {
+	cr = crlistat(&engine->creatures, y);
 	fprintf(stderr, "%02X%c (%d %d)",
 			cr->id, "-^<?v?\?\?>"[(int)cr->dir],
 			cr->pos % CXGRID, cr->pos / CXGRID);
-	for (x = 0 ; x < slipcount ; ++x) {
-	    if (cr == slips[x].cr) {
+	for (x = 0 ; x < engine->slipcount ; ++x) {
+	    if (cr == engine->slips[x].cr) {
 		fprintf(stderr, " [%d]", x + 1);
 		break;
 	    }
@@ -1909,17 +2104,17 @@ static void dumpmap(void)
 			cr->state & CS_SLIDE ? " sliding" : "",
 			cr->state & CS_DEFERPUSH ? " deferred-push" : "",
 			cr->state & CS_MUTANT ? " mutant" : "");
-	if (x < slipcount)
-	    fprintf(stderr, " %c", "-^<?v?\?\?>"[(int)slips[x].dir]);
+	if (x < engine->slipcount)
+	    fprintf(stderr, " %c", "-^<?v?\?\?>"[(int)engine->slips[x].dir]);
 	fputc('\n', stderr);
     }
-    for (y = 0 ; y < blockcount ; ++y) {
-	cr = blocks[y];
+    for (y = 0 ; y < engine->blocks.count ; ++y) {
+	cr = crlistat(&engine->blocks, y);
 	fprintf(stderr, "block %d: (%d %d) %c", y,
 			cr->pos % CXGRID, cr->pos / CXGRID,
 			"-^<?v?\?\?>"[(int)cr->dir]);
-	for (x = 0 ; x < slipcount ; ++x) {
-	    if (cr == slips[x].cr) {
+	for (x = 0 ; x < engine->slipcount ; ++x) {
+	    if (cr == engine->slips[x].cr) {
 		fprintf(stderr, " [%d]", x + 1);
 		break;
 	    }
@@ -1934,8 +2129,8 @@ static void dumpmap(void)
 			cr->state & CS_SLIDE ? " sliding" : "",
 			cr->state & CS_DEFERPUSH ? " deferred-push" : "",
 			cr->state & CS_MUTANT ? " mutant" : "");
-	if (x < slipcount)
-	    fprintf(stderr, " %c", "-^<?v?\?\?>"[(int)slips[x].dir]);
+	if (x < engine->slipcount)
+	    fprintf(stderr, " %c", "-^<?v?\?\?>"[(int)engine->slips[x].dir]);
 	fputc('\n', stderr);
     }
 }
@@ -1947,8 +2142,8 @@ static void verifymap(void)
     creature   *cr;
     int		n;
 
-    for (n = 0 ; n < creaturecount ; ++n) {
-	cr = creatures[n];
+    for (n = 0 ; n < engine->creatures.count ; ++n) {
+	cr = crlistat(&engine->creatures, n);
 	if (cr->id < 0x40 || cr->id >= 0x80)
 	    warn("%d: Undefined creature %02X at (%d %d)",
 		 state->currenttime, cr->id,
@@ -1973,7 +2168,8 @@ static void verifymap(void)
  */
 static void initialhousekeeping(void)
 {
-    int	n;
+    creature   *cr;
+    int		n;
 
 #ifndef NDEBUG
     if (currentinput() == CmdDebugCmd2) {
@@ -2011,13 +2207,14 @@ static void initialhousekeeping(void)
 #endif
 
     if (currenttime() == 0)
-	laststepping = stepping();
+	engine->laststepping = stepping();
 
     if (!(currenttime() & 3)) {
-	for (n = 1 ; n < creaturecount ; ++n) {
-	    if (creatures[n]->state & CS_TURNING) {
-		creatures[n]->state &= ~(CS_TURNING | CS_HASMOVED);
-		updatecreature(creatures[n]);
+	for (n = 1 ; n < engine->creatures.count ; ++n) {
+	    cr = crlistat(&engine->creatures, n);
+	    if (cr->state & CS_TURNING) {
+		cr->state &= ~(CS_TURNING | CS_HASMOVED);
+		updatecreature(cr);
 	    }
 	}
 	++chipwait();
@@ -2029,11 +2226,41 @@ static void initialhousekeeping(void)
     }
 }
 
+/* Compute the hash of the entire game state. The map's part of it is
+ * kept up to date as the map changes, but the rest changes so much
+ * from tick to tick that it is simply recomputed.
+ */
+static statehash hashstate(void)
+{
+    statehash	hash;
+    int		n;
+
+    hash = hashcommonstate(state);
+    hash = hashvalue(hash, chipwait() | (chipstatus() << 8)
+				      | (controllerdir() << 16)
+				      | ((unsigned long)lastslipdir() << 24));
+    hash = hashvalue(hash, ((unsigned long)completed() << 16)
+			 | (unsigned short)goalpos());
+    hash = hashvalue(hash, engine->creatures.count);
+    for (n = 0 ; n < engine->creatures.count ; ++n)
+	hash = hashcreature(hash, crlistat(&engine->creatures, n));
+    hash = hashvalue(hash, engine->blocks.count);
+    for (n = 0 ; n < engine->blocks.count ; ++n)
+	hash = hashcreature(hash, crlistat(&engine->blocks, n));
+    hash = hashvalue(hash, engine->slipcount);
+    for (n = 0 ; n < engine->slipcount ; ++n)
+	hash = hashvalue(hashcreature(hash, engine->slips[n].cr),
+			 engine->slips[n].dir);
+    return hash;
+}
+
 /* Actions and checks that occur at the end of a tick.
  */
 static void finalhousekeeping(void)
 {
-    return;
+    _assert(state->maphash == hashmap(state->map));
+    _assert(checkcreatureindex());
+    state->hash = hashstate();
 }
 
 static void preparedisplay(void)
@@ -2050,6 +2277,66 @@ static void preparedisplay(void)
     yviewpos() = (pos / CYGRID) * 8 + yviewoffset() * 8;
 }
 
+/* Work out where the teleports and toggle walls are, and what each
+ * button is wired to. A teleport's entry gives the nearest teleport
+ * before it in reading order, wrapping around the map, which is the
+ * order that teleportcreature() tries them in. The buttons for each
+ * trap are grouped together in trapbuttons[].
+ */
+static void buildlevelindex(void)
+{
+    levelindex	       *li = &engine->level;
+    mapcell const      *cell;
+    xyconn const       *xy;
+    int			pos, last, n;
+
+    li->teleportcount = 0;
+    li->togglewallcount = 0;
+    last = -1;
+    for (pos = 0, cell = state->map ; pos < CXGRID * CYGRID ; ++pos, ++cell) {
+	li->prevteleport[pos] = last;
+	if (cell->top.id == Teleport || cell->bot.id == Teleport) {
+	    last = pos;
+	    ++li->teleportcount;
+	}
+	if (cell->top.id == SwitchWall_Open
+			|| cell->top.id == SwitchWall_Closed
+			|| cell->bot.id == SwitchWall_Open
+			|| cell->bot.id == SwitchWall_Closed)
+	    li->togglewalls[li->togglewallcount++] = pos;
+    }
+    for (pos = 0 ; pos < CXGRID * CYGRID && li->prevteleport[pos] < 0 ; ++pos)
+	li->prevteleport[pos] = last;
+
+    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
+	li->trapfrom[pos] = -1;
+	li->clonerfrom[pos] = -1;
+	li->trapfirst[pos] = 0;
+    }
+    li->trapfirst[CXGRID * CYGRID] = 0;
+
+    /* Where a button is wired more than once, the first wire wins.
+     */
+    for (n = traplistsize(), xy = traplist() + n ; n ; --n) {
+	--xy;
+	if (xy->from >= 0 && xy->from < CXGRID * CYGRID)
+	    li->trapfrom[xy->from] = xy->to;
+	if (xy->to >= 0 && xy->to < CXGRID * CYGRID)
+	    ++li->trapfirst[xy->to];
+    }
+    for (n = clonerlistsize(), xy = clonerlist() + n ; n ; --n) {
+	--xy;
+	if (xy->from >= 0 && xy->from < CXGRID * CYGRID)
+	    li->clonerfrom[xy->from] = xy->to;
+    }
+
+    for (pos = 1 ; pos <= CXGRID * CYGRID ; ++pos)
+	li->trapfirst[pos] += li->trapfirst[pos - 1];
+    for (n = traplistsize(), xy = traplist() ; n ; --n, ++xy)
+	if (xy->to >= 0 && xy->to < CXGRID * CYGRID)
+	    li->trapbuttons[--li->trapfirst[xy->to]] = xy->from;
+}
+
 /*
  * The functions provided by the gamelogic struct.
  */
@@ -2062,7 +2349,6 @@ static void preparedisplay(void)
  */
 static int initgame(gamelogic *logic)
 {
-    static creature	dummycrlist;
     mapcell	       *cell;
     xyconn	       *xy;
     creature	       *cr;
@@ -2082,11 +2368,10 @@ static int initgame(gamelogic *logic)
 		cell->bot.state |= FS_BROKEN;
     }
 
-    chip = allocatecreature();
+    chip = allocatecreature(&engine->creatures);
     chip->pos = 0;
     chip->id = Chip;
     chip->dir = SOUTH;
-    addtocreaturelist(chip);
     for (n = 0 ; n < state->crlistcount ; ++n) {
 	pos = state->crlist[n];
 	if (pos < 0 || pos >= CXGRID * CYGRID) {
@@ -2102,11 +2387,10 @@ static int initgame(gamelogic *logic)
 	}
 	if (creatureid(cell->top.id) != Block
 				&& cell->bot.id != CloneMachine) {
-	    cr = allocatecreature();
+	    cr = allocatecreature(&engine->creatures);
 	    cr->pos = pos;
 	    cr->id = creatureid(cell->top.id);
 	    cr->dir = creaturedirid(cell->top.id);
-	    addtocreaturelist(cr);
 	    if (iscreature(cell->bot.id) && creatureid(cell->bot.id) == Chip) {
 		chip->pos = pos;
 		chip->dir = creaturedirid(cell->bot.id);
@@ -2123,9 +2407,11 @@ static int initgame(gamelogic *logic)
 	    chip->dir = creaturedirid(cell->bot.id);
 	}
     }
+    rebuildcreatureindex();
+    buildlevelindex();
 
-    dummycrlist.id = 0;
-    state->creatures = &dummycrlist;
+    engine->dummycrlist.id = 0;
+    state->creatures = &engine->dummycrlist;
     state->initrndslidedir = NORTH;
 
     possession(Key_Red) = possession(Key_Blue)
@@ -2147,11 +2433,13 @@ static int initgame(gamelogic *logic)
     chipstatus() = CHIP_OKAY;
     controllerdir() = NIL;
     lastslipdir() = NIL;
-    stepping() = laststepping;
+    stepping() = engine->laststepping;
     cancelgoal();
     xviewoffset() = 0;
     yviewoffset() = 0;
 
+    state->maphash = hashmap(state->map);
+    state->hash = hashstate();
     preparedisplay();
     return TRUE;
 }
@@ -2165,19 +2453,24 @@ static int advancegame(gamelogic *logic)
     int		n;
 
     setstate(logic);
+    profmark();
 
     timeoffset() = -1;
     initialhousekeeping();
+    profphase(Phase_Housekeeping);
 
     if (currenttime() && !(currenttime() & 1)) {
 	controllerdir() = NIL;
-	for (n = 0 ; n < creaturecount ; ++n) {
-	    cr = creatures[n];
+	for (n = 0 ; n < engine->creatures.count ; ++n) {
+	    cr = crlistat(&engine->creatures, n);
 	    if (cr->hidden || (cr->state & CS_CLONING) || cr->id == Chip)
 		continue;
 	    choosemove(cr);
-	    if (cr->tdir != NIL)
+	    profcreature(cr->id, Phase_ChooseMoves);
+	    if (cr->tdir != NIL) {
 		advancecreature(cr, cr->tdir);
+		profcreature(cr->id, Phase_MoveCreatures);
+	    }
 	}
 	if ((r = checkforending()))
 	    goto done;
@@ -2185,10 +2478,12 @@ static int advancegame(gamelogic *logic)
 
     if (currenttime() && !(currenttime() & 1)) {
 	floormovements();
+	profphase(Phase_FloorMovements);
 	if ((r = checkforending()))
 	    goto done;
     }
     updatesliplist();
+    profphase(Phase_SlipList);
 
     timeoffset() = 0;
     if (timelimit()) {
@@ -2209,12 +2504,17 @@ static int advancegame(gamelogic *logic)
 		goto done;
 	cr->state |= CS_HASMOVED;
     }
+    profcreature(Chip, Phase_MoveChip);
     updatesliplist();
+    profphase(Phase_SlipList);
     createclones();
+    profphase(Phase_Clones);
 
   done:
     finalhousekeeping();
+    profphase(Phase_FinalHousekeeping);
     preparedisplay();
+    profphase(Phase_Display);
     return r;
 }
 
@@ -2222,49 +2522,165 @@ static int advancegame(gamelogic *logic)
  */
 static int endgame(gamelogic *logic)
 {
-    (void)logic;
-    resetcreaturepool();
+    setstate(logic);
     resetcreaturelist();
     resetblocklist();
     resetsliplist();
     return TRUE;
 }
 
-/* Free all allocated resources for this module.
+/* Return the place of the given creature on a list, or -1 if it is
+ * not on the list.
  */
-static void shutdown(gamelogic *logic)
+static int crlistindex(crlist const *list, creature const *cr)
+{
+    int	n, i;
+
+    for (n = 0 ; n < list->chunkcount ; ++n) {
+	if (cr >= list->chunks[n] && cr < list->chunks[n] + crchunksize) {
+	    i = (n << crchunkshift) + (int)(cr - list->chunks[n]);
+	    return i < list->count ? i : -1;
+	}
+    }
+    return -1;
+}
+
+/* Store a copy of the MS-specific state. The creatures are copied out
+ * of the two lists, and the slip list's pointers to them are turned
+ * into indexes.
+ */
+static int snapshot(gamelogic *logic, unsigned char *buf, int size)
+{
+    mssnapshot		snap;
+    slippersnapshot	slip;
+    int			total, i;
+
+    setstate(logic);
+    total = sizeof snap + (engine->creatures.count + engine->blocks.count)
+						* sizeof(creature)
+			+ engine->slipcount * sizeof slip;
+    if (size < total)
+	return total;
+
+    snap.local = *getmsstate();
+    snap.creaturecount = engine->creatures.count;
+    snap.blockcount = engine->blocks.count;
+    snap.slipcount = engine->slipcount;
+    memcpy(buf, &snap, sizeof snap);
+    buf += sizeof snap;
+    for (i = 0 ; i < snap.creaturecount ; ++i, buf += sizeof(creature))
+	memcpy(buf, crlistat(&engine->creatures, i), sizeof(creature));
+    for (i = 0 ; i < snap.blockcount ; ++i, buf += sizeof(creature))
+	memcpy(buf, crlistat(&engine->blocks, i), sizeof(creature));
+    for (i = 0 ; i < engine->slipcount ; ++i, buf += sizeof slip) {
+	slip.cr = crlistindex(&engine->creatures, engine->slips[i].cr);
+	if (slip.cr < 0) {
+	    slip.cr = crlistindex(&engine->blocks, engine->slips[i].cr);
+	    if (slip.cr >= 0)
+		slip.cr += snap.creaturecount;
+	}
+	_assert(slip.cr >= 0);
+	slip.dir = engine->slips[i].dir;
+	memcpy(buf, &slip, sizeof slip);
+    }
+    return total;
+}
+
+/* Reinstate the MS-specific state from a snapshot. The lists are
+ * emptied and then refilled from the copies.
+ */
+static int restore(gamelogic *logic, unsigned char const *buf, int size)
 {
-    (void)logic;
+    mssnapshot		snap;
+    slippersnapshot	slip;
+    creature	       *cr;
+    int			i;
 
-    free(creatures);
-    creatures = NULL;
-    creaturecount = 0;
-    creaturesallocated = 0;
-    free(blocks);
-    blocks = NULL;
-    blockcount = 0;
-    blocksallocated = 0;
-    free(slips);
-    slips = NULL;
-    slipcount = 0;
-    slipsallocated = 0;
+    setstate(logic);
+    if (size < (int)sizeof snap)
+	return FALSE;
+    memcpy(&snap, buf, sizeof snap);
+    if (snap.creaturecount < 1 || snap.blockcount < 0 || snap.slipcount < 0)
+	return FALSE;
+    if (size != (int)(sizeof snap + (snap.creaturecount + snap.blockcount)
+						* sizeof(creature)
+		       + snap.slipcount * sizeof slip))
+	return FALSE;
 
-    freecreaturepool();
+    *getmsstate() = snap.local;
+    resetcreaturelist();
+    resetblocklist();
+    resetsliplist();
+    buf += sizeof snap;
+    for (i = 0 ; i < snap.creaturecount ; ++i, buf += sizeof(creature)) {
+	cr = allocatecreature(&engine->creatures);
+	memcpy(cr, buf, sizeof(creature));
+	indexcreature(cr);
+    }
+    for (i = 0 ; i < snap.blockcount ; ++i, buf += sizeof(creature)) {
+	cr = allocatecreature(&engine->blocks);
+	memcpy(cr, buf, sizeof(creature));
+	indexcreature(cr);
+    }
+    for (i = 0 ; i < snap.slipcount ; ++i, buf += sizeof slip) {
+	memcpy(&slip, buf, sizeof slip);
+	if (slip.cr < 0 || slip.cr >= snap.creaturecount + snap.blockcount)
+	    return FALSE;
+	cr = slip.cr < snap.creaturecount
+		? crlistat(&engine->creatures, slip.cr)
+		: crlistat(&engine->blocks, slip.cr - snap.creaturecount);
+	appendtosliplist(cr, slip.dir);
+    }
+    return TRUE;
 }
 
-/* The exported function: Initialize and return the module's gamelogic
- * structure.
+/* Reinstate a snapshot of the starting position, keeping the stepping
+ * that the previous game left behind, just as initgame() would.
  */
-gamelogic *mslogicstartup(void)
+static int restart(gamelogic *logic, unsigned char const *buf, int size)
 {
-    static gamelogic	logic;
+    if (!restore(logic, buf, size))
+	return FALSE;
+    stepping() = engine->laststepping;
+    state->hash = hashstate();
+    return TRUE;
+}
 
-    logic.ruleset = Ruleset_MS;
-    logic.localstateinfosize = sizeof(struct msstate);
-    logic.initgame = initgame;
-    logic.advancegame = advancegame;
-    logic.endgame = endgame;
-    logic.shutdown = shutdown;
+/* Free all allocated resources for this instance of the module.
+ */
+static void shutdown(gamelogic *logic)
+{
+    setstate(logic);
+
+    freecrlist(&engine->creatures);
+    freecrlist(&engine->blocks);
+    free(engine->slips);
+
+    free(engine);
+    engine = NULL;
+    state = NULL;
+}
 
-    return &logic;
+/* The exported function: Create and return a new instance of the
+ * module's gamelogic structure.
+ */
+gamelogic *mslogicstartup(void)
+{
+    mslogic    *ms;
+
+    ms = calloc(1, sizeof *ms);
+    if (!ms)
+	memerrexit();
+
+    ms->logic.ruleset = Ruleset_MS;
+    ms->logic.localstateinfosize = sizeof(struct msstate);
+    ms->logic.initgame = initgame;
+    ms->logic.advancegame = advancegame;
+    ms->logic.endgame = endgame;
+    ms->logic.shutdown = shutdown;
+    ms->logic.snapshot = snapshot;
+    ms->logic.restore = restore;
+    ms->logic.restart = restart;
+
+    return &ms->logic;
 }
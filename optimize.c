@@ -0,0 +1,484 @@
+/* optimize.c: Making the user's solutions quicker automatically.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	<pthread.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"play.h"
+#include	"solution.h"
+#include	"optimize.h"
+
+/* The kinds of variation that are made to a solution.
+ */
+enum {
+    Change_Shift,		/* make a move and all after it earlier */
+    Change_Retime,		/* make one move earlier */
+    Change_Delete,		/* remove a move */
+    Change_DeleteShift,		/* remove a move and the pause after it */
+    Change_Swap			/* exchange a move with the next one */
+};
+
+/* One variation of the current solution.
+ */
+typedef	struct candidate {
+    int			kind;		/* one of the Change_ values */
+    int			index;		/* the first move changed */
+    int			delta;		/* the number of ticks, if needed */
+} candidate;
+
+/* A snapshot of the game taken while playing the current solution.
+ */
+typedef	struct checkpoint {
+    int			size;		/* the size of the snapshot */
+    unsigned char      *data;		/* the snapshot */
+} checkpoint;
+
+/* The share of one round of variations given to one worker. The
+ * workers only read the search, so they need no locking.
+ */
+typedef	struct optimizeworker {
+    struct optimizesearch *search;	/* the search being done */
+    gameplay	       *gp;		/* the worker's own game */
+    pthread_t		thread;		/* the worker's thread */
+    int			first;		/* the first candidate to try */
+    int			end;		/* one past the last candidate */
+    actlist		moves;		/* the moves of the candidate */
+    int			best;		/* the quickest candidate found */
+    int			bestticks;	/* its length, or zero if none */
+    int			failed;		/* TRUE if a snapshot was rejected */
+} optimizeworker;
+
+/* The data for the optimization of one solution.
+ */
+typedef	struct optimizesearch {
+    optimizeparams const *params;	/* the limits of the search */
+    optimizeworker     *workers;	/* one worker for each thread */
+    solutioninfo	solution;	/* the quickest solution so far */
+    int			ticks;		/* the length of that solution */
+    checkpoint	       *checkpoints;	/* the snapshots taken during it */
+    int			checkpointcount; /* one more than the moves */
+    candidate	       *candidates;	/* the variations to try */
+    int			count;		/* the number of variations */
+    int			allocated;	/* the size of the array */
+} optimizesearch;
+
+/* Return the time elapsed since an arbitrary moment, in seconds.
+ */
+static double wallclock(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    return (double)time(NULL);
+#endif
+}
+
+/*
+ * Playing solutions.
+ */
+
+/* Continue the current game, supplying the moves at their appointed
+ * ticks, starting with the one at index i. Play is abandoned once it
+ * can no longer be won in fewer than limit ticks. The return value is
+ * the number of ticks played if the game was won, or zero otherwise.
+ */
+static int playmoves(actlist const *moves, int i, int limit)
+{
+    int	t, f;
+
+    for (f = 0 ; !f ; ) {
+	t = ticksplayed();
+	if (t + 1 >= limit)
+	    return 0;
+	if (i < moves->count && (int)moves->list[i].when == t)
+	    f = doturn(moves->list[i++].dir);
+	else
+	    f = doturn(CmdPreserve);
+    }
+    return f > 0 ? ticksplayed() : 0;
+}
+
+/* Store a snapshot of the current game as checkpoint n.
+ */
+static void addcheckpoint(optimizesearch *search, int n)
+{
+    checkpoint *cp = search->checkpoints + n;
+
+    cp->size = snapshotgamestate(NULL, 0);
+    xalloc(cp->data, cp->size);
+    snapshotgamestate(cp->data, cp->size);
+}
+
+/* Free the checkpoints of the current solution.
+ */
+static void dropcheckpoints(optimizesearch *search)
+{
+    int	n;
+
+    for (n = 0 ; n < search->checkpointcount ; ++n)
+	free(search->checkpoints[n].data);
+    free(search->checkpoints);
+    search->checkpoints = NULL;
+    search->checkpointcount = 0;
+}
+
+/* Play the current solution from the start, keeping a checkpoint at
+ * the start and just before each move, and return the number of ticks
+ * it takes. Zero is returned if the solution does not win within
+ * limit ticks, and -1 if the level cannot be played.
+ */
+static int playsolution(optimizesearch *search, gamesetup *game, int ruleset,
+			int limit)
+{
+    actlist const      *moves = &search->solution.moves;
+    int			i, f;
+
+    dropcheckpoints(search);
+    if (!initgamestate(game, ruleset, FALSE)) {
+	endgamestate();
+	return -1;
+    }
+    preparefromsolution(&search->solution);
+    setgameplaymode(BeginVerify);
+    search->checkpoints = calloc(moves->count + 1,
+				 sizeof *search->checkpoints);
+    if (!search->checkpoints)
+	memerrexit();
+    search->checkpointcount = moves->count + 1;
+    addcheckpoint(search, 0);
+    i = 0;
+    for (f = 0 ; !f && ticksplayed() + 1 < limit ; ) {
+	if (i < moves->count && (int)moves->list[i].when == ticksplayed()) {
+	    addcheckpoint(search, i + 1);
+	    f = doturn(moves->list[i++].dir);
+	} else {
+	    f = doturn(CmdPreserve);
+	}
+    }
+    f = f > 0 ? ticksplayed() : 0;
+    setgameplaymode(EndVerify);
+    endgamestate();
+    return f;
+}
+
+/* Play the current solution from the start, so that its moves are
+ * recorded, and replace the user's solution with it. FALSE is
+ * returned if the user's solution was not replaced.
+ */
+static int keepsolution(optimizesearch const *search, gamesetup *game,
+			int ruleset)
+{
+    int	replaced = FALSE;
+
+    if (initgamestate(game, ruleset, FALSE)) {
+	preparefromsolution(&search->solution);
+	setgameplaymode(BeginVerify);
+	if (playmoves(&search->solution.moves, 0, search->ticks + 1))
+	    replaced = replacesolution();
+	setgameplaymode(EndVerify);
+    }
+    endgamestate();
+    return replaced;
+}
+
+/*
+ * Making variations.
+ */
+
+/* Add a variation to the list.
+ */
+static void addcandidate(optimizesearch *search, int kind, int index,
+			 int delta)
+{
+    if (search->count >= search->allocated) {
+	search->allocated = search->allocated ? 2 * search->allocated : 256;
+	xalloc(search->candidates,
+	       search->allocated * sizeof *search->candidates);
+    }
+    search->candidates[search->count].kind = kind;
+    search->candidates[search->count].index = index;
+    search->candidates[search->count].delta = delta;
+    ++search->count;
+}
+
+/* Make the list of variations of the current solution. A move can be
+ * made earlier by any amount up to the length of the pause before
+ * it, but only the powers of two and the whole pause are tried.
+ */
+static void makecandidates(optimizesearch *search)
+{
+    action const       *moves = search->solution.moves.list;
+    int			count = search->solution.moves.count;
+    int			gap, d, k;
+
+    search->count = 0;
+    for (k = 0 ; k < count ; ++k) {
+	gap = k ? moves[k].when - moves[k - 1].when - 1 : moves[k].when;
+	for (d = 1 ; d <= gap ; d = d < gap && 2 * d > gap ? gap : 2 * d) {
+	    addcandidate(search, Change_Shift, k, d);
+	    if (k + 1 < count)
+		addcandidate(search, Change_Retime, k, d);
+	}
+	addcandidate(search, Change_Delete, k, 0);
+	if (k + 1 < count) {
+	    addcandidate(search, Change_DeleteShift, k, 0);
+	    if (moves[k].dir != moves[k + 1].dir)
+		addcandidate(search, Change_Swap, k, 0);
+	}
+    }
+}
+
+/* Copy the moves, with the given variation made to them. The return
+ * value is the index of the last checkpoint taken before the first
+ * tick that the variation changes.
+ */
+static int applycandidate(actlist const *from, candidate const *cand,
+			  actlist *to)
+{
+    int	k = cand->index;
+    int	delta, dir, i;
+
+    copymovelist(to, from);
+    switch (cand->kind) {
+      case Change_Shift:
+	for (i = k ; i < to->count ; ++i)
+	    to->list[i].when -= cand->delta;
+	return k;
+      case Change_Retime:
+	to->list[k].when -= cand->delta;
+	return k;
+      case Change_Delete:
+      case Change_DeleteShift:
+	delta = 0;
+	if (cand->kind == Change_DeleteShift)
+	    delta = to->list[k + 1].when - to->list[k].when;
+	--to->count;
+	memmove(to->list + k, to->list + k + 1,
+		(to->count - k) * sizeof *to->list);
+	for (i = k ; i < to->count ; ++i)
+	    to->list[i].when -= delta;
+	return k + 1;
+      case Change_Swap:
+	dir = to->list[k].dir;
+	to->list[k].dir = to->list[k + 1].dir;
+	to->list[k + 1].dir = dir;
+	return k + 1;
+    }
+    return 0;
+}
+
+/*
+ * Trying variations.
+ */
+
+/* Try the worker's share of the variations, in the worker's own game,
+ * noting the quickest one that wins.
+ */
+static void trycandidates(optimizeworker *worker)
+{
+    optimizesearch const	       *search = worker->search;
+    checkpoint const		       *cp;
+    int					limit, n, i;
+
+    for (i = worker->first ; i < worker->end ; ++i) {
+	n = applycandidate(&search->solution.moves, search->candidates + i,
+			   &worker->moves);
+	cp = search->checkpoints + n;
+	if (!branchgamestate(cp->data, cp->size)) {
+	    worker->failed = TRUE;
+	    return;
+	}
+	limit = worker->bestticks ? worker->bestticks : search->ticks;
+	n = playmoves(&worker->moves, n ? n - 1 : 0, limit);
+	if (n) {
+	    worker->bestticks = n;
+	    worker->best = i;
+	}
+    }
+}
+
+/* The body of a worker thread.
+ */
+static void *optimizethread(void *data)
+{
+    optimizeworker     *worker = data;
+    gameplay	       *prev;
+
+    prev = selectgameplay(worker->gp);
+    trycandidates(worker);
+    selectgameplay(prev);
+    return NULL;
+}
+
+/* Try every variation, dividing them among the workers, and return
+ * the index of the quickest one that wins. When two are equally
+ * quick, the one made earlier in the list is chosen, so that the
+ * outcome does not depend upon how many threads were used. -1 is
+ * returned if no variation is quicker, and -2 if one could not be
+ * tried.
+ */
+static int tryround(optimizesearch *search)
+{
+    optimizeworker     *worker;
+    int			jobs, started, best, bestticks;
+    int			i;
+
+    jobs = search->params->jobs;
+    if (jobs > search->count)
+	jobs = search->count;
+    for (i = 0, worker = search->workers ; i < jobs ; ++i, ++worker) {
+	worker->first = (search->count * i) / jobs;
+	worker->end = (search->count * (i + 1)) / jobs;
+	worker->bestticks = 0;
+	worker->failed = FALSE;
+    }
+    for (started = 1 ; started < jobs ; ++started)
+	if (pthread_create(&search->workers[started].thread, NULL,
+			   optimizethread, search->workers + started))
+	    break;
+    if (jobs)
+	optimizethread(search->workers);
+    for (i = 1 ; i < started ; ++i)
+	pthread_join(search->workers[i].thread, NULL);
+    for (i = started ; i < jobs ; ++i)
+	optimizethread(search->workers + i);
+
+    best = -1;
+    bestticks = 0;
+    for (i = 0, worker = search->workers ; i < jobs ; ++i, ++worker) {
+	if (worker->failed)
+	    return -2;
+	if (worker->bestticks && (!bestticks
+				  || worker->bestticks < bestticks)) {
+	    best = worker->best;
+	    bestticks = worker->bestticks;
+	}
+    }
+    return best;
+}
+
+/* Set up a game for each worker.
+ */
+static int startworkers(optimizesearch *search, gamesetup *game,
+			int ruleset)
+{
+    optimizeworker     *worker;
+    gameplay	       *prev;
+    int			i, f;
+
+    search->workers = calloc(search->params->jobs, sizeof *search->workers);
+    if (!search->workers)
+	memerrexit();
+    for (i = 0, worker = search->workers ; i < search->params->jobs
+					   ; ++i, ++worker) {
+	worker->search = search;
+	worker->gp = creategameplay();
+	prev = selectgameplay(worker->gp);
+	f = initgamestate(game, ruleset, FALSE);
+	setgameplaymode(BeginVerify);
+	selectgameplay(prev);
+	if (!f)
+	    return FALSE;
+    }
+    return TRUE;
+}
+
+/* Free everything that the search allocated.
+ */
+static void endsearch(optimizesearch *search)
+{
+    gameplay   *prev;
+    int		i;
+
+    if (search->workers) {
+	for (i = 0 ; i < search->params->jobs ; ++i) {
+	    if (!search->workers[i].gp)
+		continue;
+	    prev = selectgameplay(search->workers[i].gp);
+	    endgamestate();
+	    selectgameplay(prev);
+	    destroygameplay(search->workers[i].gp);
+	    destroymovelist(&search->workers[i].moves);
+	}
+	free(search->workers);
+    }
+    dropcheckpoints(search);
+    free(search->candidates);
+    destroymovelist(&search->solution.moves);
+}
+
+/* Make the user's solution to a level quicker, one variation at a
+ * time.
+ */
+int optimizelevel(gamesetup *game, int ruleset,
+		  optimizeparams const *params, optimizeresult *result)
+{
+    optimizesearch	search;
+    actlist		moves;
+    double		start;
+    int			outcome, best, n;
+
+    memset(result, 0, sizeof *result);
+    memset(&search, 0, sizeof search);
+    memset(&moves, 0, sizeof moves);
+    search.params = params;
+    start = wallclock();
+
+    if (!hassolution(game) || !expandsolution(&search.solution, game)) {
+	endsearch(&search);
+	result->outcome = Optimize_Failed;
+	return Optimize_Failed;
+    }
+    n = playsolution(&search, game, ruleset,
+		     game->besttime + TICKS_PER_SECOND);
+    if (n <= 0 || !startworkers(&search, game, ruleset)) {
+	endsearch(&search);
+	result->outcome = n ? Optimize_Failed : Optimize_Invalid;
+	return result->outcome;
+    }
+    result->before = result->after = search.ticks = n;
+
+    outcome = Optimize_Unchanged;
+    while (!params->seconds || wallclock() - start < params->seconds) {
+	makecandidates(&search);
+	result->candidates += search.count;
+	best = tryround(&search);
+	if (best < 0) {
+	    if (best < -1)
+		outcome = Optimize_Failed;
+	    break;
+	}
+	applycandidate(&search.solution.moves, search.candidates + best,
+		       &moves);
+	copymovelist(&search.solution.moves, &moves);
+	n = playsolution(&search, game, ruleset, search.ticks);
+	if (n <= 0) {
+	    errmsg(NULL, "level %d: improved solution could not be replayed",
+		   game->number);
+	    outcome = Optimize_Failed;
+	    break;
+	}
+	search.ticks = n;
+	++result->rounds;
+    }
+
+    if (outcome == Optimize_Unchanged && result->rounds
+		&& keepsolution(&search, game, ruleset)) {
+	outcome = Optimize_Improved;
+	result->after = search.ticks;
+    }
+    destroymovelist(&moves);
+    endsearch(&search);
+    result->seconds = wallclock() - start;
+    result->outcome = outcome;
+    return outcome;
+}
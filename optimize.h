@@ -0,0 +1,61 @@
+/* optimize.h: Making the user's solutions quicker automatically.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#ifndef	_optimize_h_
+#define	_optimize_h_
+
+#include	"defs.h"
+
+/* The most threads that the optimizer will use.
+ */
+#define	MAX_OPTIMIZE_JOBS	64
+
+/* The ways in which optimizing a solution can end.
+ */
+enum {
+    Optimize_Improved,		/* a quicker solution was found */
+    Optimize_Unchanged,		/* no quicker solution was found */
+    Optimize_Invalid,		/* the solution does not work */
+    Optimize_Failed		/* the level could not be played */
+};
+
+/* The limits placed upon the optimizer.
+ */
+typedef	struct optimizeparams {
+    int		jobs;		/* the number of threads to use */
+    int		seconds;	/* the time allowed per level, or zero */
+} optimizeparams;
+
+/* What the optimizer did, and what it cost.
+ */
+typedef	struct optimizeresult {
+    int		outcome;	/* one of the Optimize_ values */
+    int		before;		/* the ticks the solution took at first */
+    int		after;		/* the ticks the best solution takes */
+    int		rounds;		/* the number of improvements made */
+    long	candidates;	/* the number of variations tried */
+    double	seconds;	/* the time taken */
+} optimizeresult;
+
+/* Look for a quicker version of the user's solution to the given
+ * level, in the currently selected game. The solution is played
+ * through once, keeping a snapshot before each move. Then many small
+ * variations are tried, each one played from the last snapshot before
+ * the first move that it changes: a pause before a move is shortened,
+ * along with all the moves after it or the one move alone; a move is
+ * removed, with or without the pause after it; or two moves are made
+ * in the opposite order. The quickest variation that still wins is
+ * kept, and the process repeats until no variation is quicker, or
+ * the time allowed runs out. The result then replaces the user's
+ * solution, just as a quicker solution played by the user would. The
+ * outcome is returned, and is also stored in result along with the
+ * optimizer's statistics.
+ */
+extern int optimizelevel(gamesetup *game, int ruleset,
+			 optimizeparams const *params,
+			 optimizeresult *result);
+
+#endif
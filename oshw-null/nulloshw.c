@@ -0,0 +1,318 @@
+/* nulloshw.c: An OS/hardware layer that does nothing.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* This layer has no display, no keyboard, and no sound. It exists so
+ * that programs which only need to load levels and play back
+ * solutions can link with the game code on machines that do not have
+ * SDL installed. Every request for input is answered as if the user
+ * had declined it, and messages are written to stderr.
+ */
+
+#include	<stdio.h>
+#include	<stdarg.h>
+#include	"../gen.h"
+#include	"../oshw.h"
+
+/* The tick counter. There is no real-time clock behind it, so waiting
+ * for the next tick never actually waits.
+ */
+static THREADLOCAL int	utick = 0;
+
+/*
+ * Initialization.
+ */
+
+int oshwinitialize(int silence, int soundbufsize,
+		   int showhistogram, int fullscreen, int headless)
+{
+    (void)silence;
+    (void)soundbufsize;
+    (void)showhistogram;
+    (void)fullscreen;
+    (void)headless;
+    return TRUE;
+}
+
+/*
+ * Timer functions.
+ */
+
+void settimer(int action)
+{
+    if (action < 0)
+	utick = 0;
+}
+
+void settimersecond(int ms)
+{
+    (void)ms;
+}
+
+int gettickcount(void)
+{
+    return utick;
+}
+
+int waitfortick(void)
+{
+    ++utick;
+    return FALSE;
+}
+
+int advancetick(void)
+{
+    return ++utick;
+}
+
+/*
+ * Keyboard input functions.
+ */
+
+int setkeyboardrepeat(int enable)
+{
+    (void)enable;
+    return TRUE;
+}
+
+int setkeyboardarrowsrepeat(int enable)
+{
+    (void)enable;
+    return TRUE;
+}
+
+int setkeyboardinputmode(int enable)
+{
+    (void)enable;
+    return TRUE;
+}
+
+int input(int wait)
+{
+    (void)wait;
+    return 0;
+}
+
+int anykey(void)
+{
+    return TRUE;
+}
+
+tablespec const *keyboardhelp(int context)
+{
+    (void)context;
+    return NULL;
+}
+
+/*
+ * Resource-loading functions.
+ */
+
+int loadfontfromfile(char const *filename, int complain)
+{
+    (void)filename;
+    (void)complain;
+    return TRUE;
+}
+
+void freefont(void)
+{
+}
+
+int loadtileset(char const *filename, int complain)
+{
+    (void)filename;
+    (void)complain;
+    return TRUE;
+}
+
+void freetileset(void)
+{
+}
+
+/*
+ * Video output functions.
+ */
+
+int creategamedisplay(void)
+{
+    return TRUE;
+}
+
+void setcolors(long bkgnd, long text, long bold, long dim)
+{
+    (void)bkgnd;
+    (void)text;
+    (void)bold;
+    (void)dim;
+}
+
+void cleardisplay(void)
+{
+}
+
+int displaygame(void const *state, int timeleft, int besttime)
+{
+    (void)state;
+    (void)timeleft;
+    (void)besttime;
+    return TRUE;
+}
+
+unsigned char *getdisplayimage(int *width, int *height)
+{
+    (void)width;
+    (void)height;
+    return NULL;
+}
+
+int displayendmessage(int basescore, int timescore, long totalscore,
+		      int completed)
+{
+    (void)basescore;
+    (void)timescore;
+    (void)totalscore;
+    (void)completed;
+    return 0;
+}
+
+int setdisplaymsg(char const *msg, int msecs, int bold)
+{
+    (void)msg;
+    (void)msecs;
+    (void)bold;
+    return TRUE;
+}
+
+int displaylist(char const *title, tablespec const *table, int *index,
+		int (*inputcallback)(int*))
+{
+    (void)title;
+    (void)table;
+    (void)index;
+    (void)inputcallback;
+    return 0;
+}
+
+int displayinputprompt(char const *prompt, char *input, int maxlen,
+		       int (*inputcallback)(void))
+{
+    (void)prompt;
+    (void)input;
+    (void)maxlen;
+    (void)inputcallback;
+    return FALSE;
+}
+
+int displaytextscroll(char const *title, char const **paragraphs,
+		      int ppcount, int completed, int (*inputcallback)(int*))
+{
+    (void)title;
+    (void)paragraphs;
+    (void)ppcount;
+    (void)completed;
+    (void)inputcallback;
+    return 0;
+}
+
+int displaytiletable(char const *title, tiletablerow const *rows,
+		     int count, int completed)
+{
+    (void)title;
+    (void)rows;
+    (void)count;
+    (void)completed;
+    return TRUE;
+}
+
+int displaytable(char const *title, tablespec const *table, int completed)
+{
+    (void)title;
+    (void)table;
+    (void)completed;
+    return TRUE;
+}
+
+void setsubtitle(char const *subtitle)
+{
+    (void)subtitle;
+}
+
+/*
+ * Sound functions.
+ */
+
+int setaudiosystem(int active)
+{
+    (void)active;
+    return FALSE;
+}
+
+int loadsfxfromfile(int index, char const *filename)
+{
+    (void)index;
+    (void)filename;
+    return FALSE;
+}
+
+void playsoundeffects(unsigned long sfx)
+{
+    (void)sfx;
+}
+
+void setsoundeffects(int action)
+{
+    (void)action;
+}
+
+int setvolume(int volume, int display)
+{
+    (void)volume;
+    (void)display;
+    return FALSE;
+}
+
+int changevolume(int delta, int display)
+{
+    (void)delta;
+    (void)display;
+    return FALSE;
+}
+
+int getvolume(void)
+{
+    return 0;
+}
+
+void freesfx(int index)
+{
+    (void)index;
+}
+
+void ding(void)
+{
+}
+
+/*
+ * Messages.
+ */
+
+/* Write the message to stderr.
+ */
+void usermessage(int action, char const *prefix,
+		 char const *cfile, unsigned long lineno,
+		 char const *fmt, va_list args)
+{
+    fprintf(stderr, "%s: ", action == NOTIFY_DIE ? "FATAL" :
+			    action == NOTIFY_ERR ? "error" : "warning");
+    if (cfile)
+	fprintf(stderr, "[%s:%lu] ", cfile, lineno);
+    if (prefix)
+	fprintf(stderr, "%s: ", prefix);
+    if (fmt)
+	vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    fflush(stderr);
+}
@@ -30,7 +30,7 @@ void usermessage(int action, char const *prefix,
 		 char const *cfile, unsigned long lineno,
 		 char const *fmt, va_list args)
 {
-    static char	errbuf[4096];
+    static THREADLOCAL char	errbuf[4096];
     char       *p;
 
     p = errbuf;
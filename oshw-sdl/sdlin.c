@@ -461,6 +461,7 @@ tablespec const *keyboardhelp(int which)
 	"1-2 4 6 8 (keypad)", "1-also move Chip",
 	"1-Q", "1-quit the current game",
 	"1-Bkspc", "1-pause the game",
+	"1-left right", "1-seek within a playback",
 	"1-Ctrl-R", "1-restart the current level",
 	"1-Ctrl-P", "1-jump to the previous level",
 	"1-Ctrl-N", "1-jump to the next level",
@@ -469,7 +470,7 @@ tablespec const *keyboardhelp(int which)
 	"1-Ctrl-C", "1-exit the program",
 	"1-Alt-F4", "1-exit the program"
     };
-    static tablespec const keyhelp_ingame = { 11, 2, 4, 1, ingame_items };
+    static tablespec const keyhelp_ingame = { 12, 2, 4, 1, ingame_items };
 
     static char *twixtgame_items[] = {
 	"1-P", "1-jump to the previous level",
@@ -114,15 +114,25 @@ static void shutdown(void)
 }
 
 /* Initialize SDL, create the program's icon, and then initialize
- * the other modules of the library.
+ * the other modules of the library. When running headless, SDL's
+ * dummy video driver is selected (unless the user has already chosen
+ * a driver), so that no display device is needed.
  */
 int oshwinitialize(int silence, int soundbufsize,
-		   int showhistogram, int fullscreen)
+		   int showhistogram, int fullscreen, int headless)
 {
+    static char		dummydriver[] = "SDL_VIDEODRIVER=dummy";
     SDL_Surface	       *icon;
 
     sdlg.eventupdatefunc = _eventupdate;
 
+    if (headless) {
+	silence = TRUE;
+	fullscreen = FALSE;
+	if (!getenv("SDL_VIDEODRIVER"))
+	    putenv(dummydriver);
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
 	errmsg(NULL, "Cannot initialize SDL system: %s\n", SDL_GetError());
 	return FALSE;
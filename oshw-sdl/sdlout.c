@@ -691,6 +691,55 @@ int displaygame(void const *state, int timeleft, int besttime)
     return TRUE;
 }
 
+/* Copy the display's contents into a buffer of 24-bit RGB pixels.
+ */
+unsigned char *getdisplayimage(int *width, int *height)
+{
+    SDL_Surface	       *s = sdlg.screen;
+    unsigned char      *image, *dest;
+    Uint8	       *src;
+    Uint32		pixel;
+    int			bpp, x, y;
+
+    if (!s)
+	return NULL;
+    if (!(image = malloc(3 * s->w * s->h)))
+	memerrexit();
+    if (SDL_MUSTLOCK(s))
+	SDL_LockSurface(s);
+    bpp = s->format->BytesPerPixel;
+    dest = image;
+    for (y = 0 ; y < s->h ; ++y) {
+	src = (Uint8*)s->pixels + y * s->pitch;
+	for (x = 0 ; x < s->w ; ++x, src += bpp, dest += 3) {
+	    switch (bpp) {
+	      case 1:
+		pixel = *src;
+		break;
+	      case 2:
+		pixel = *(Uint16*)src;
+		break;
+	      case 3:
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+		pixel = (src[0] << 16) | (src[1] << 8) | src[2];
+#else
+		pixel = src[0] | (src[1] << 8) | (src[2] << 16);
+#endif
+		break;
+	      default:
+		pixel = *(Uint32*)src;
+		break;
+	    }
+	    SDL_GetRGB(pixel, s->format, dest, dest + 1, dest + 2);
+	}
+    }
+    if (SDL_MUSTLOCK(s))
+	SDL_UnlockSurface(s);
+    *width = s->w;
+    *height = s->h;
+    return image;
+}
+
 /* Update the display to acknowledge the end of game play. completed
  * is positive if the play was successful or negative if unsuccessful.
  * If the latter, then the other arguments can contain point values
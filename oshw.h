@@ -24,10 +24,12 @@ extern int tworld(int argc, char *argv[]);
  * debugging purposes.) soundbufsize is a number between 0 and 3 which
  * is used to scale the size of the sound buffer. A larger number is
  * more efficient, but pushes the sound effects farther out of
- * synchronization with the video.
+ * synchronization with the video. If headless is TRUE, nothing is
+ * shown on the screen and no sound is played; the display is drawn
+ * offscreen, to be retrieved with getdisplayimage().
  */
 extern int oshwinitialize(int silence, int soundbufsize,
-			  int showhistogram, int fullscreen);
+			  int showhistogram, int fullscreen, int headless);
 
 /*
  * Timer functions.
@@ -160,6 +162,13 @@ extern void cleardisplay(void);
  */
 extern int displaygame(void const *state, int timeleft, int besttime);
 
+/* Return a copy of the display's current contents, as rows of 24-bit
+ * RGB pixels with no padding, and store its dimensions in width and
+ * height. The caller is responsible for freeing the buffer. NULL is
+ * returned if the display cannot be read.
+ */
+extern unsigned char *getdisplayimage(int *width, int *height);
+
 /* Display a short message appropriate to the end of a level's game
  * play. If the level was completed successfully, totalscore is
  * nonzero, and the other three arguments define the base score and
@@ -15,15 +15,86 @@
 #include	"logic.h"
 #include	"random.h"
 #include	"solution.h"
+#include	"hash.h"
 #include	"play.h"
+#include	"profile.h"
+#include	"ver.h"
 
-/* The current state of the current game.
+/* A snapshot of the game taken during playback.
  */
-static gamestate	state;
+typedef	struct checkpoint {
+    int			tick;		/* the next tick to be played */
+    int			size;		/* the size of the snapshot */
+    unsigned char      *data;		/* the snapshot */
+} checkpoint;
 
-/* The current logic module.
+/* The snapshots of a game taken during playback, in order of time.
  */
-static gamelogic       *logic = NULL;
+typedef	struct checkpointlist {
+    checkpoint	       *list;		/* the array of checkpoints */
+    int			count;		/* number of checkpoints */
+    int			allocated;	/* number of elements allocated */
+    int			interval;	/* ticks between checkpoints */
+    int			lasttick;	/* the tick on which playback ends */
+    long		memory;		/* total bytes used */
+    long		budget;		/* maximum bytes to use */
+} checkpointlist;
+
+/* A snapshot of a game as initgamestate() left it, followed by a copy
+ * of the level data it was made from, so that the level can be
+ * started again without decoding it and setting it up again.
+ */
+typedef	struct pristinegame {
+    unsigned char      *data;		/* the snapshot and the level data */
+    int			size;		/* the snapshot's size, or zero */
+    int			levelsize;	/* the size of the level data */
+    int			time;		/* the level's time limit */
+    int			allocated;	/* bytes allocated for data */
+} pristinegame;
+
+/* The ways in which a snapshot can be put back into play.
+ */
+enum { Snap_Restore, Snap_Branch, Snap_Restart };
+
+/* Everything that belongs to one game in progress.
+ */
+struct gameplay {
+    gamestate	state;		/* the current state of the game */
+    gamelogic  *logic;		/* the logic module running the game */
+    int		verifying;	/* TRUE if the game is being verified */
+    int		verifytime;	/* the game clock while verifying */
+    int		tickoffset;	/* the game clock relative to the timer */
+    checkpointlist checkpoints;	/* snapshots for seeking in playback */
+    solutioncursor playback;	/* the moves not yet read from the solution */
+    action	nextmove;	/* the next move to be played back */
+    int		hasnextmove;	/* FALSE once the solution runs out */
+    pristinegame pristine;	/* the game at its starting position */
+};
+
+/* The game that this module's functions currently act upon. Each
+ * thread has its own selection, and its own default game that is used
+ * when no other game has been selected.
+ */
+static THREADLOCAL gameplay	defaultgame;
+static THREADLOCAL gameplay    *selectedgame = NULL;
+
+/* Connect a game's logic module to the game's state.
+ */
+static void attachlogic(gameplay *gp)
+{
+    gp->logic->state = &gp->state;
+}
+
+/* The rest of the module refers to the selected game's state and
+ * logic module directly.
+ */
+#define	current		(selectedgame ? selectedgame : &defaultgame)
+#define	state		(current->state)
+#define	logic		(current->logic)
+
+/* Forward declaration of a function used before it is defined.
+ */
+static int restoresnapshot(void const *buffer, int size, int mode);
 
 /* TRUE if the user has requested pedantic mode game play.
  */
@@ -40,6 +111,24 @@ void setpedanticmode(void)
     pedanticmode = TRUE;
 }
 
+/* Return a value that identifies this version of the game logic and
+ * the rules that it follows. The program's version and the version
+ * of the game logic are hashed, along with whether pedantic mode is
+ * on.
+ */
+unsigned long enginebuildid(void)
+{
+    statehash	hash = 0;
+    char const *p;
+
+    for (p = VERSION ; *p ; ++p)
+	hash = hashvalue(hash, (unsigned char)*p);
+    hash = hashvalue(hash, 0);
+    hash = hashvalue(hash, LOGIC_VERSION);
+    hash = hashvalue(hash, pedanticmode);
+    return (unsigned long)((hash ^ (hash >> 32)) & 0xFFFFFFFFUL);
+}
+
 /* Set the slowdown factor.
  */
 int setmudsuckingfactor(int mud)
@@ -50,9 +139,9 @@ int setmudsuckingfactor(int mud)
     return TRUE;
 }
 
-/* Configure the game logic, and some of the OS/hardware layer, as
- * required for the given ruleset. Do nothing if the requested ruleset
- * is already the current ruleset.
+/* Configure the game logic, and (if withgui is TRUE) some of the
+ * OS/hardware layer, as required for the given ruleset. Do nothing if
+ * the requested ruleset is already the current ruleset.
  */
 static int setrulesetbehavior(int ruleset, int withgui)
 {
@@ -63,6 +152,7 @@ static int setrulesetbehavior(int ruleset, int withgui)
 	logic = NULL;
 	free(state.localstateinfo);
 	state.localstateinfo = NULL;
+	current->pristine.size = 0;
     }
     if (ruleset == Ruleset_None)
 	return TRUE;
@@ -72,15 +162,11 @@ static int setrulesetbehavior(int ruleset, int withgui)
 	logic = lynxlogicstartup();
 	if (!logic)
 	    return FALSE;
-	setkeyboardarrowsrepeat(TRUE);
-	settimersecond(1000 * mudsucking);
 	break;
       case Ruleset_MS:
 	logic = mslogicstartup();
 	if (!logic)
 	    return FALSE;
-	setkeyboardarrowsrepeat(FALSE);
-	settimersecond(1100 * mudsucking);
 	break;
       default:
 	errmsg(NULL, "unknown ruleset requested (ruleset=%d)", ruleset);
@@ -88,6 +174,8 @@ static int setrulesetbehavior(int ruleset, int withgui)
     }
 
     if (withgui) {
+	setkeyboardarrowsrepeat(ruleset == Ruleset_Lynx);
+	settimersecond((ruleset == Ruleset_MS ? 1100 : 1000) * mudsucking);
 	if (!loadgameresources(ruleset) || !creategamedisplay()) {
 	    die("unable to proceed due to previous errors.");
 	    return FALSE;
@@ -95,7 +183,55 @@ static int setrulesetbehavior(int ruleset, int withgui)
     }
 
     state.localstateinfo = calloc(logic->localstateinfosize, 1);
-    logic->state = &state;
+    attachlogic(current);
+    return TRUE;
+}
+
+/* Store the game's starting position, along with a copy of the level
+ * data, for restarting the level later. The level's wiring and hint
+ * text are not part of the snapshot, and neither is what the logic
+ * module works out about the level when setting it up, so anything
+ * else that changes them must discard the starting position.
+ */
+static void savepristine(void)
+{
+    pristinegame       *p = &current->pristine;
+    int			size, n;
+
+    p->size = 0;
+    size = snapshotgamestate(NULL, 0);
+    if (size <= 0)
+	return;
+    n = size + state.game->levelsize;
+    if (p->allocated < n) {
+	p->allocated = n;
+	xalloc(p->data, n);
+    }
+    if (snapshotgamestate(p->data, size) != size)
+	return;
+    memcpy(p->data + size, state.game->leveldata, state.game->levelsize);
+    p->levelsize = state.game->levelsize;
+    p->time = state.game->time;
+    p->size = size;
+}
+
+/* Return the game to the starting position stored by savepristine(),
+ * provided that it was made from the same level, as if the level had
+ * been initialized afresh. FALSE is returned if no such position is
+ * available.
+ */
+static int restorepristine(void)
+{
+    pristinegame const *p = &current->pristine;
+
+    if (!p->size || p->levelsize != state.game->levelsize
+		 || p->time != state.game->time
+		 || memcmp(p->data + p->size, state.game->leveldata,
+			   p->levelsize))
+	return FALSE;
+    if (!restoresnapshot(p->data, p->size, Snap_Restart))
+	return FALSE;
+    current->tickoffset = 0;
     return TRUE;
 }
 
@@ -122,16 +258,40 @@ int initgamestate(gamesetup *game, int ruleset, int withgui)
     state.statusflags = 0;
     if (pedanticmode)
 	state.statusflags |= SF_PEDANTIC;
+    current->tickoffset = 0;
+    current->hasnextmove = FALSE;
     initmovelist(&state.moves);
     resetprng(&state.mainprng);
 
+    current->pristine.size = 0;
     if (!expandleveldata(&state))
 	return FALSE;
+    if (!(*logic->initgame)(logic))
+	return FALSE;
+
+    savepristine();
+    return TRUE;
+}
 
-    return (*logic->initgame)(logic);
+/* Return the current game to its starting position, without setting
+ * up the level again. FALSE is returned if this cannot be done, in
+ * which case endgamestate() and initgamestate() must be used instead.
+ */
+int restartgamestate(void)
+{
+    if (!logic || !state.game)
+	return FALSE;
+    freecheckpoints();
+    setsoundeffects(-1);
+    profendlevel(state.game->number);
+    return restorepristine();
 }
 
-/* Change the current state to run from the recorded solution.
+/* Change the current state to run from the recorded solution. The
+ * moves are decoded one at a time as the game reaches them, instead
+ * of being expanded into a list beforehand. The data is still checked
+ * from end to end first, so that a truncated solution is rejected
+ * before play begins instead of partway through.
  */
 int prepareplayback(void)
 {
@@ -139,13 +299,17 @@ int prepareplayback(void)
 
     if (!state.game->solutionsize)
 	return FALSE;
-    solution.moves.list = NULL;
-    solution.moves.allocated = 0;
-    if (!expandsolution(&solution, state.game) || !solution.moves.count)
+    if (!opensolution(&current->playback, &solution, state.game))
 	return FALSE;
+    if (countsolutionmoves(state.game) < 0) {
+	errmsg(NULL, "level %d: truncated solution data", state.game->number);
+	return FALSE;
+    }
+    if (nextsolutionmove(&current->playback, &current->nextmove) <= 0)
+	return FALSE;
+    current->hasnextmove = TRUE;
 
-    destroymovelist(&state.moves);
-    state.moves = solution.moves;
+    state.moves.count = 0;
     restartprng(&state.mainprng, solution.rndseed);
     state.initrndslidedir = solution.rndslidedir;
     state.stepping = solution.stepping;
@@ -153,6 +317,18 @@ int prepareplayback(void)
     return TRUE;
 }
 
+/* Set up the current state to be played from live input, under the
+ * starting conditions of the given solution.
+ */
+void preparefromsolution(solutioninfo const *solution)
+{
+    state.moves.count = 0;
+    restartprng(&state.mainprng, solution->rndseed);
+    state.initrndslidedir = solution->rndslidedir;
+    state.stepping = solution->stepping;
+    state.replay = -1;
+}
+
 /* Return the amount of time passed in the current game, in seconds.
  */
 int secondsplayed(void)
@@ -160,6 +336,27 @@ int secondsplayed(void)
     return (state.currenttime + state.timeoffset) / TICKS_PER_SECOND;
 }
 
+/* Return the number of ticks played so far in the current game.
+ */
+int ticksplayed(void)
+{
+    return state.currenttime + 1;
+}
+
+/* Restart the main PRNG on a fixed seed.
+ */
+void seedgamestate(unsigned long seed)
+{
+    restartprng(&state.mainprng, seed);
+}
+
+/* Return the hash of the current game's state.
+ */
+statehash gamestatehash(void)
+{
+    return state.hash;
+}
+
 /* Change the system behavior according to the given gameplay mode.
  */
 void setgameplaymode(int mode)
@@ -180,10 +377,11 @@ void setgameplaymode(int mode)
 	settimer(-1);
 	break;
       case BeginVerify:
-	settimer(+1);
+	current->verifying = TRUE;
+	current->verifytime = 0;
 	break;
       case EndVerify:
-	settimer(-1);
+	current->verifying = FALSE;
 	break;
       case SuspendPlayShuttered:
 	if (state.ruleset == Ruleset_MS)
@@ -275,7 +473,10 @@ int doturn(int cmd)
     int		n;
 
     state.soundeffects &= ~((1 << SND_ONESHOT_COUNT) - 1);
-    state.currenttime = gettickcount();
+    if (current->verifying)
+	state.currenttime = current->verifytime++;
+    else
+	state.currenttime = gettickcount() + current->tickoffset;
     if (state.currenttime >= MAXIMUM_TICK_COUNT) {
 	errmsg(NULL, "timer reached its maximum of %d.%d hours; quitting now",
 		     MAXIMUM_TICK_COUNT / (TICKS_PER_SECOND * 3600),
@@ -286,13 +487,16 @@ int doturn(int cmd)
 	if (cmd != CmdPreserve)
 	    state.currentinput = cmd;
     } else {
-	if (state.replay < state.moves.count) {
-	    if (state.currenttime > state.moves.list[state.replay].when)
+	if (current->hasnextmove) {
+	    act = current->nextmove;
+	    if (state.currenttime > act.when)
 		warn("Replay: Got ahead of saved solution: %d > %d!",
-		     state.currenttime, state.moves.list[state.replay].when);
-	    if (state.currenttime == state.moves.list[state.replay].when) {
-		state.currentinput = state.moves.list[state.replay].dir;
+		     state.currenttime, act.when);
+	    if (state.currenttime == act.when) {
+		state.currentinput = act.dir;
 		++state.replay;
+		n = nextsolutionmove(&current->playback, &current->nextmove);
+		current->hasnextmove = n > 0;
 	    }
 	} else {
 	    n = state.currenttime + state.timeoffset - 1;
@@ -362,7 +566,9 @@ int quitgamestate(void)
  */
 int endgamestate(void)
 {
+    freecheckpoints();
     setsoundeffects(-1);
+    profendlevel(state.game ? state.game->number : 0);
     return (*logic->endgame)(logic);
 }
 
@@ -370,15 +576,391 @@ int endgamestate(void)
  */
 void shutdowngamestate(void)
 {
+    free(current->pristine.data);
+    memset(&current->pristine, 0, sizeof current->pristine);
+    freecheckpoints();
     setrulesetbehavior(Ruleset_None, FALSE);
     destroymovelist(&state.moves);
 }
 
+/*
+ * Snapshots of the game in progress.
+ */
+
+/* The number of ticks between playback checkpoints, before any
+ * thinning is done to stay within the memory budget.
+ */
+#define	CHECKPOINT_INTERVAL	TICKS_PER_SECOND
+
+/* Set the game clocks so that the next tick played follows on from
+ * the current state, whether the game is being verified or is
+ * running from the timer.
+ */
+static void synctime(void)
+{
+    current->verifytime = state.currenttime + 1;
+    current->tickoffset = state.currenttime + 1 - gettickcount();
+}
+
+/* The part of a snapshot that holds the fields of the gamestate
+ * struct that can change during play. The logic module's own data
+ * follows directly after. The level's wiring, hint text, and other
+ * data that does not change once the game has begun are not stored.
+ * The playback's position is kept as an offset into the solution
+ * data, so that no pointers are stored.
+ */
+typedef	struct gamesnapshot {
+    int			size;			/* size of the snapshot */
+    int			ruleset;		/* the ruleset of the game */
+    int			levelnumber;		/* the level of the game */
+    int			replay;
+    int			timelimit;
+    int			currenttime;
+    int			timeoffset;
+    int			movecount;		/* size of the move list */
+    int			hasnextmove;		/* position in playback */
+    action		nextmove;
+    int			playbackpos;		/* offset of the next byte */
+    int			playbacksize;		/* size of the solution data */
+    action		playbacklast;		/* the decoder's state */
+    unsigned char	playbackpacked;
+    unsigned char	playbackpackedcount;
+    short		currentinput;
+    short		chipsneeded;
+    short		xviewpos;
+    short		yviewpos;
+    short		keys[4];
+    short		boots[4];
+    short		statusflags;
+    short		lastmove;
+    unsigned char	initrndslidedir;
+    signed char		stepping;
+    unsigned long	soundeffects;
+    unsigned long	prnginitial;
+    unsigned long	prngvalue;
+    statehash		maphash;
+    statehash		hash;
+    mapcell		map[CXGRID * CYGRID];
+} gamesnapshot;
+
+/* Store a copy of the game in progress in buffer.
+ */
+int snapshotgamestate(void *buffer, int size)
+{
+    gamesnapshot       *snap = buffer;
+    int			n;
+
+    if (!logic || !state.game)
+	return 0;
+    n = sizeof *snap;
+    if (size > n)
+	n += (*logic->snapshot)(logic, (unsigned char*)buffer + n, size - n);
+    else
+	n += (*logic->snapshot)(logic, NULL, 0);
+    if (size < n)
+	return n;
+
+    snap->size = n;
+    snap->ruleset = state.ruleset;
+    snap->levelnumber = state.game->number;
+    snap->replay = state.replay;
+    snap->timelimit = state.timelimit;
+    snap->currenttime = state.currenttime;
+    snap->timeoffset = state.timeoffset;
+    snap->movecount = state.moves.count;
+    snap->hasnextmove = current->hasnextmove;
+    snap->nextmove = current->nextmove;
+    snap->playbackpos = current->hasnextmove
+			? current->playback.pos - state.game->solutiondata : 0;
+    snap->playbacksize = state.game->solutionsize;
+    snap->playbacklast = current->playback.last;
+    snap->playbackpacked = current->playback.packed;
+    snap->playbackpackedcount = current->playback.packedcount;
+    snap->currentinput = state.currentinput;
+    snap->chipsneeded = state.chipsneeded;
+    snap->xviewpos = state.xviewpos;
+    snap->yviewpos = state.yviewpos;
+    memcpy(snap->keys, state.keys, sizeof snap->keys);
+    memcpy(snap->boots, state.boots, sizeof snap->boots);
+    snap->statusflags = state.statusflags;
+    snap->lastmove = state.lastmove;
+    snap->initrndslidedir = state.initrndslidedir;
+    snap->stepping = state.stepping;
+    snap->soundeffects = state.soundeffects;
+    snap->prnginitial = state.mainprng.initial;
+    snap->prngvalue = state.mainprng.value;
+    snap->maphash = state.maphash;
+    snap->hash = state.hash;
+    memcpy(snap->map, state.map, sizeof snap->map);
+    return n;
+}
+
+/* Return the game in progress to the moment stored in buffer. With
+ * Snap_Branch, the move list is emptied instead of being cut back to
+ * the snapshot's length. With Snap_Restart, the snapshot holds the
+ * starting position, and what initgamestate() would not take from the
+ * level is left to the logic module or started over.
+ */
+static int restoresnapshot(void const *buffer, int size, int mode)
+{
+    gamesnapshot const *snap = buffer;
+    unsigned char const *local = (unsigned char const*)buffer + sizeof *snap;
+
+    if (!logic || !state.game || size < (int)sizeof *snap)
+	return FALSE;
+    if (snap->size != size || snap->ruleset != state.ruleset
+			   || snap->levelnumber != state.game->number)
+	return FALSE;
+    if (mode == Snap_Restore && snap->movecount > state.moves.count)
+	return FALSE;
+    if (snap->hasnextmove && snap->playbacksize != state.game->solutionsize)
+	return FALSE;
+    if (mode != Snap_Restart
+		&& !(*logic->restore)(logic, local, size - sizeof *snap))
+	return FALSE;
+
+    state.replay = snap->replay;
+    state.timelimit = snap->timelimit;
+    state.currenttime = snap->currenttime;
+    state.timeoffset = snap->timeoffset;
+    state.moves.count = mode == Snap_Restore ? snap->movecount : 0;
+    current->hasnextmove = snap->hasnextmove;
+    current->nextmove = snap->nextmove;
+    if (snap->hasnextmove) {
+	current->playback.pos = state.game->solutiondata + snap->playbackpos;
+	current->playback.end = state.game->solutiondata
+			      + state.game->solutionsize;
+	current->playback.last = snap->playbacklast;
+	current->playback.packed = snap->playbackpacked;
+	current->playback.packedcount = snap->playbackpackedcount;
+    }
+    state.currentinput = snap->currentinput;
+    state.chipsneeded = snap->chipsneeded;
+    state.xviewpos = snap->xviewpos;
+    state.yviewpos = snap->yviewpos;
+    memcpy(state.keys, snap->keys, sizeof state.keys);
+    memcpy(state.boots, snap->boots, sizeof state.boots);
+    state.statusflags = snap->statusflags;
+    state.lastmove = snap->lastmove;
+    state.initrndslidedir = snap->initrndslidedir;
+    state.stepping = snap->stepping;
+    state.soundeffects = snap->soundeffects;
+    restartprng(&state.mainprng, snap->prnginitial);
+    state.mainprng.value = snap->prngvalue;
+    state.maphash = snap->maphash;
+    state.hash = snap->hash;
+    memcpy(state.map, snap->map, sizeof state.map);
+    if (mode == Snap_Restart) {
+	resetprng(&state.mainprng);
+	if (!(*logic->restart)(logic, local, size - sizeof *snap))
+	    return FALSE;
+    }
+    synctime();
+    return TRUE;
+}
+
+/* Return the game in progress to the moment stored in buffer.
+ */
+int restoregamestate(void const *buffer, int size)
+{
+    return restoresnapshot(buffer, size, Snap_Restore);
+}
+
+/* Continue the game from the moment stored in buffer, with an empty
+ * move list.
+ */
+int branchgamestate(void const *buffer, int size)
+{
+    return restoresnapshot(buffer, size, Snap_Branch);
+}
+
+/*
+ * Seeking during playback.
+ */
+
+/* Store a snapshot of the current game as a checkpoint. If the memory
+ * budget would be exceeded, every other checkpoint is discarded and
+ * the interval between them is doubled, until there is room or until
+ * only the first one is left. The first checkpoint is always kept.
+ */
+static void addcheckpoint(void)
+{
+    checkpointlist     *cps = &current->checkpoints;
+    checkpoint	       *cp;
+    int			tick, size, i, n;
+
+    tick = state.currenttime + 1;
+    size = snapshotgamestate(NULL, 0);
+    while (cps->count && cps->memory + size > cps->budget) {
+	if (cps->count == 1)
+	    return;
+	cps->interval *= 2;
+	for (i = n = 0 ; i < cps->count ; ++i) {
+	    if (cps->list[i].tick % cps->interval) {
+		cps->memory -= cps->list[i].size;
+		free(cps->list[i].data);
+	    } else {
+		cps->list[n++] = cps->list[i];
+	    }
+	}
+	cps->count = n;
+	if (tick % cps->interval)
+	    return;
+    }
+
+    if (cps->count >= cps->allocated) {
+	n = cps->allocated ? cps->allocated * 2 : 16;
+	xalloc(cps->list, n * sizeof *cps->list);
+	cps->allocated = n;
+    }
+    cp = cps->list + cps->count;
+    cp->data = malloc(size);
+    if (!cp->data)
+	memerrexit();
+    cp->tick = tick;
+    cp->size = snapshotgamestate(cp->data, size);
+    cps->memory += cp->size;
+    ++cps->count;
+}
+
+/* Run the game forward until the given tick is the next one to be
+ * played, using the game's own clock. The return value is nonzero if
+ * the game ended first.
+ */
+static int runtotick(int tick)
+{
+    int	verifying, n = 0;
+
+    verifying = current->verifying;
+    current->verifying = TRUE;
+    current->verifytime = state.currenttime + 1;
+    while (state.currenttime + 1 < tick)
+	if ((n = doturn(CmdNone)))
+	    break;
+    current->verifying = verifying;
+    synctime();
+    return n;
+}
+
+/* Play the current game's solution through to the end without
+ * rendering, storing checkpoints along the way, and then return to
+ * the starting position.
+ */
+int preparecheckpoints(long budget)
+{
+    checkpointlist     *cps = &current->checkpoints;
+
+    freecheckpoints();
+    if (state.replay < 0)
+	return FALSE;
+    cps->interval = CHECKPOINT_INTERVAL;
+    cps->budget = budget;
+    addcheckpoint();
+    for (;;) {
+	if (runtotick(state.currenttime + 2))
+	    break;
+	if ((state.currenttime + 1) % cps->interval == 0)
+	    addcheckpoint();
+    }
+    cps->lasttick = state.currenttime;
+    return restoregamestate(cps->list[0].data, cps->list[0].size);
+}
+
+/* Move the game to the given tick, starting from the latest
+ * checkpoint before it, or from the current position if that is
+ * closer.
+ */
+int seekgamestate(int tick)
+{
+    checkpointlist     *cps = &current->checkpoints;
+    int			i;
+
+    if (!cps->count)
+	return FALSE;
+    if (tick < 0)
+	tick = 0;
+    if (tick > cps->lasttick)
+	tick = cps->lasttick;
+    for (i = cps->count - 1 ; i > 0 ; --i)
+	if (cps->list[i].tick <= tick)
+	    break;
+    if (tick <= state.currenttime || state.currenttime + 1 < cps->list[i].tick)
+	if (!restoregamestate(cps->list[i].data, cps->list[i].size))
+	    return FALSE;
+    runtotick(tick);
+    return TRUE;
+}
+
+/* Return the number of checkpoints, and the memory they occupy.
+ */
+long checkpointmemory(int *count)
+{
+    if (count)
+	*count = current->checkpoints.count;
+    return current->checkpoints.memory;
+}
+
+/* Discard the current game's checkpoints.
+ */
+void freecheckpoints(void)
+{
+    checkpointlist     *cps = &current->checkpoints;
+    int			i;
+
+    for (i = 0 ; i < cps->count ; ++i)
+	free(cps->list[i].data);
+    free(cps->list);
+    memset(cps, 0, sizeof *cps);
+}
+
+/*
+ * Managing multiple games.
+ */
+
+/* Create a new game, independent of all others.
+ */
+gameplay *creategameplay(void)
+{
+    gameplay   *gp;
+
+    gp = calloc(1, sizeof *gp);
+    if (!gp)
+	memerrexit();
+    return gp;
+}
+
+/* Select the game for the calling thread to act upon, returning the
+ * previous selection.
+ */
+gameplay *selectgameplay(gameplay *gp)
+{
+    gameplay   *prev;
+
+    prev = selectedgame;
+    selectedgame = gp;
+    return prev;
+}
+
+/* Free all resources belonging to the given game.
+ */
+void destroygameplay(gameplay *gp)
+{
+    gameplay   *prev;
+
+    if (!gp)
+	return;
+    prev = selectgameplay(gp);
+    shutdowngamestate();
+    selectgameplay(prev == gp ? NULL : prev);
+    free(gp);
+}
+
 /* Initialize the current game state to a small level used for display
  * at the completion of a series.
  */
 void setenddisplay(void)
 {
+    current->pristine.size = 0;
     state.replay = -1;
     state.timelimit = 0;
     state.currenttime = -1;
@@ -428,6 +1010,7 @@ int replacesolution(void)
     solution.stepping = state.stepping;
     if (!contractsolution(&solution, state.game))
 	return FALSE;
+    freecheckpoints();
 
     return TRUE;
 }
@@ -441,9 +1024,11 @@ int deletesolution(void)
 	return FALSE;
     state.game->besttime = TIME_NIL;
     state.game->sgflags &= ~SGF_REPLACEABLE;
+    state.game->sgflags |= SGF_UNSAVED;
     free(state.game->solutiondata);
     state.game->solutionsize = 0;
     state.game->solutiondata = NULL;
+    freecheckpoints();
     return TRUE;
 }
 
@@ -18,7 +18,9 @@ enum {
 };
 
 /* Change the current gameplay mode. This affects the running of the
- * timer and the handling of the keyboard.
+ * timer and the handling of the keyboard. While verifying, the game
+ * keeps its own clock, which advances once with every call to
+ * doturn(), and the timer is not consulted.
  */
 extern void setgameplaymode(int mode);
 
@@ -27,11 +29,25 @@ extern void setgameplaymode(int mode);
  */
 extern int initgamestate(gamesetup *game, int ruleset, int withgui);
 
+/* Return the current game to the starting position of its level, as
+ * it was left by initgamestate(), without setting up the level again.
+ * FALSE is returned if this is not possible, in which case the game
+ * should be ended and initialized again.
+ */
+extern int restartgamestate(void);
+
 /* Set up the current state to play from its prerecorded solution.
  * FALSE is returned if no solution is available for playback.
  */
 extern int prepareplayback(void);
 
+/* Set up the current state to be played from live input, under the
+ * same starting conditions (the PRNG seed, the initial random slide
+ * direction, and the stepping) as the given solution. The solution's
+ * moves can then be supplied as input, and are recorded anew.
+ */
+extern void preparefromsolution(solutioninfo const *solution);
+
 /* Set the initial stepping value. stepping is a value between 0 and 7
  * inclusive. (Under MS, the stepping can only be 0 or 4.) If display
  * is true, a message is displayed to indicate the change.
@@ -54,6 +70,21 @@ extern int rotaterndslidedir(int display);
  */
 extern int secondsplayed(void);
 
+/* Return the number of ticks played so far in the current game.
+ */
+extern int ticksplayed(void);
+
+/* Restart the current game's random-number generator on the given
+ * seed, so that a game played from live input can be repeated
+ * exactly.
+ */
+extern void seedgamestate(unsigned long seed);
+
+/* Return the hash of the current game's state as of the most recent
+ * tick. (See the hash field of gamestate.)
+ */
+extern statehash gamestatehash(void);
+
 /* Handle one tick of the game. cmd is the current keyboard command
  * supplied by the user, or CmdPreserve if any pending command is to
  * be retained. The return value is positive if the game was completed
@@ -106,12 +137,100 @@ extern int deletesolution(void);
  */
 extern int checksolution(void);
 
+/* Store a copy of the game in progress in buffer, which is size bytes
+ * long and must be suitably aligned for any type (as memory from
+ * malloc() is). The copy contains no pointers, and holds everything
+ * needed to continue the game from the current tick, except for the
+ * move list itself, of which only the length is kept. The return
+ * value is the number of bytes that the copy requires. If this is
+ * larger than size, nothing useful is stored. Zero is returned if no
+ * game is in progress.
+ */
+extern int snapshotgamestate(void *buffer, int size);
+
+/* Return the game in progress to the moment stored in buffer by
+ * snapshotgamestate(). The snapshot must come from the same level,
+ * under the same ruleset. Any moves recorded after the snapshot was
+ * taken are discarded, and the game clock is set to continue
+ * from the snapshot's tick. Afterwards the PRNG runs independently of
+ * any others, as it does when a solution is played back. FALSE is
+ * returned if the snapshot cannot be used.
+ */
+extern int restoregamestate(void const *buffer, int size);
+
+/* Continue the game in progress from the moment stored in buffer, as
+ * restoregamestate() does, but with an empty move list. The snapshot
+ * need not have been taken from the current game, so long as it is
+ * of the same level under the same ruleset. This allows many
+ * different continuations of one position to be tried, as when
+ * searching for a solution. The moves made afterwards are recorded
+ * as usual, but they cannot be saved as a solution.
+ */
+extern int branchgamestate(void const *buffer, int size);
+
+/* Prepare for seeking within the playback of a solution. The
+ * solution is played through to the end without rendering, and a
+ * snapshot is kept every so often, using no more than budget bytes
+ * in total. (The snapshots are spaced further apart as needed to stay
+ * within the budget, but the starting position is always kept.) The
+ * game is then returned to its starting position. FALSE is returned
+ * if the current game is not a playback.
+ */
+extern int preparecheckpoints(long budget);
+
+/* Move the playback to the given tick, so that it is the next one to
+ * be played. The tick is clamped to the length of the playback. At
+ * most one interval between snapshots needs to be simulated. FALSE is
+ * returned if preparecheckpoints() has not been called.
+ */
+extern int seekgamestate(int tick);
+
+/* Return the amount of memory used by the snapshots. If count is not
+ * NULL, it receives the number of snapshots.
+ */
+extern long checkpointmemory(int *count);
+
+/* Discard the snapshots used for seeking. This is done automatically
+ * when the game ends, and when the solution is replaced or deleted,
+ * since the snapshots record their place in the solution's data.
+ */
+extern void freecheckpoints(void);
+
+/* A game in progress. All of the above functions act upon the game
+ * that the calling thread has selected. Each thread has a default
+ * game of its own, which is used when no other game is selected.
+ * Separate games do not share any state, so they can be played side
+ * by side, whether on the same thread or on different ones.
+ */
+typedef	struct gameplay gameplay;
+
+/* Create a new game.
+ */
+extern gameplay *creategameplay(void);
+
+/* Make gp the game that the calling thread acts upon. NULL selects
+ * the thread's default game. The previous selection is returned.
+ */
+extern gameplay *selectgameplay(gameplay *gp);
+
+/* Free a game created by creategameplay(). If gp is the current
+ * selection, the thread's default game is selected in its place.
+ */
+extern void destroygameplay(gameplay *gp);
+
 /* Turn pedantic mode on. The ruleset simulation will forgo "standard
  * play" in favor of being as true as possible to the original source
  * material.
  */
 extern void setpedanticmode(void);
 
+/* Return a value that identifies this version of the game logic and
+ * the rules that it has been set to follow. Two builds that return
+ * the same value play every game identically, provided that
+ * LOGIC_VERSION is increased with every change to the game logic.
+ */
+extern unsigned long enginebuildid(void);
+
 /* Slow down the game clock by the given factor. Used for debugging
  * purposes.
  */
@@ -0,0 +1,204 @@
+/* profile.c: Measuring where the time goes within each tick.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* The logic modules mark the boundaries between the phases of a tick,
+ * and the time between two marks is charged to the phase (and, for
+ * the work done on behalf of a single creature, to the creature's
+ * type). The counts are kept per thread while a level is played, and
+ * added to the program's totals when the level ends. None of this is
+ * compiled in unless PROFILE_TICKS is defined.
+ */
+
+#ifdef PROFILE_TICKS
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<time.h>
+#include	<pthread.h>
+#include	"gen.h"
+#include	"state.h"
+#include	"profile.h"
+
+/* The number of creature types that are counted separately: the
+ * fifteen kinds of creatures, followed by the four animations.
+ */
+#define	CREATURE_TYPES	19
+
+/* The time and call counts for one level, or for the whole run.
+ */
+typedef	struct profcounts {
+    unsigned long long	phaseclocks[Phase_Count];
+    unsigned long	phasecalls[Phase_Count];
+    unsigned long long	crclocks[CREATURE_TYPES];
+    unsigned long	crcalls[CREATURE_TYPES];
+} profcounts;
+
+/* The names used for the phases and creature types in the output.
+ */
+static char const *phasenames[Phase_Count] = {
+    "housekeeping", "choosemoves", "movecreatures", "movechip",
+    "floormovements", "sliplist", "clones", "teleports",
+    "finalhousekeeping", "display"
+};
+static char const *crnames[CREATURE_TYPES] = {
+    "chip", "block", "tank", "ball", "glider", "fireball", "walker",
+    "blob", "teeth", "bug", "paramecium", "swimmingchip", "pushingchip",
+    "reserved2", "reserved1",
+    "splash", "bombexplosion", "explosion", "animation"
+};
+
+/* The counts for the level being played by this thread, and the
+ * clock reading at the last mark.
+ */
+static THREADLOCAL profcounts		level;
+static THREADLOCAL unsigned long long	lastmark;
+
+/* The counts for every level played so far, by any thread.
+ */
+static profcounts	totals;
+static int		registered = FALSE;
+static pthread_mutex_t	totalslock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Read the profiling clock. On x86 this is the processor's cycle
+ * counter; elsewhere it is the monotonic clock in nanoseconds, or
+ * failing that the processor time.
+ */
+static unsigned long long readclock(void)
+{
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined CLOCK_MONOTONIC
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    return clock();
+#endif
+}
+
+/* Return the index in the count arrays of a creature ID.
+ */
+static int crindex(int id)
+{
+    if (id < Chip || id > Animation_Reserved1)
+	return -1;
+    if (id >= Water_Splash)
+	return 15 + id - Water_Splash;
+    return (id - Chip) >> 2;
+}
+
+/* Start timing from the current moment.
+ */
+void profilemark(void)
+{
+    lastmark = readclock();
+}
+
+/* Charge the time since the last mark to a phase.
+ */
+void profilephase(int phase)
+{
+    unsigned long long	now;
+
+    now = readclock();
+    level.phaseclocks[phase] += now - lastmark;
+    ++level.phasecalls[phase];
+    lastmark = now;
+}
+
+/* Charge the time since the last mark to a phase and a creature type.
+ */
+void profilecreature(int id, int phase)
+{
+    unsigned long long	now;
+    int			n;
+
+    now = readclock();
+    level.phaseclocks[phase] += now - lastmark;
+    ++level.phasecalls[phase];
+    if ((n = crindex(id)) >= 0) {
+	level.crclocks[n] += now - lastmark;
+	++level.crcalls[n];
+    }
+    lastmark = now;
+}
+
+/* Write one set of counts to stderr as a list of name=value lines.
+ */
+static void writecounts(profcounts const *counts, char const *label)
+{
+    unsigned long long	sum = 0;
+    int			n;
+
+    for (n = 0 ; n < Phase_Count ; ++n)
+	sum += counts->phaseclocks[n];
+    if (!sum)
+	return;
+    for (n = 0 ; n < Phase_Count ; ++n)
+	if (counts->phasecalls[n])
+	    fprintf(stderr, "profile level=%s phase=%s calls=%lu clocks=%llu"
+			    " percent=%.1f\n",
+		    label, phasenames[n], counts->phasecalls[n],
+		    counts->phaseclocks[n],
+		    100.0 * counts->phaseclocks[n] / sum);
+    for (n = 0 ; n < CREATURE_TYPES ; ++n)
+	if (counts->crcalls[n])
+	    fprintf(stderr, "profile level=%s creature=%s calls=%lu"
+			    " clocks=%llu percent=%.1f\n",
+		    label, crnames[n], counts->crcalls[n],
+		    counts->crclocks[n], 100.0 * counts->crclocks[n] / sum);
+}
+
+/* Write the totals when the program exits.
+ */
+static void writetotals(void)
+{
+    pthread_mutex_lock(&totalslock);
+    writecounts(&totals, "all");
+    pthread_mutex_unlock(&totalslock);
+}
+
+/* Add this thread's counts for the level to the totals, and clear
+ * them for the next level.
+ */
+void profileendlevel(int number)
+{
+    char	label[16];
+    char const *env;
+    int		n;
+
+    pthread_mutex_lock(&totalslock);
+    if (!registered) {
+	atexit(writetotals);
+	registered = TRUE;
+    }
+    if ((env = getenv("TWORLD_PROFILE_LEVELS")) && *env) {
+	sprintf(label, "%d", number);
+	writecounts(&level, label);
+    }
+    for (n = 0 ; n < Phase_Count ; ++n) {
+	totals.phaseclocks[n] += level.phaseclocks[n];
+	totals.phasecalls[n] += level.phasecalls[n];
+	level.phaseclocks[n] = 0;
+	level.phasecalls[n] = 0;
+    }
+    for (n = 0 ; n < CREATURE_TYPES ; ++n) {
+	totals.crclocks[n] += level.crclocks[n];
+	totals.crcalls[n] += level.crcalls[n];
+	level.crclocks[n] = 0;
+	level.crcalls[n] = 0;
+    }
+    pthread_mutex_unlock(&totalslock);
+}
+
+#else
+
+/* ISO C does not allow a translation unit to be empty.
+ */
+typedef int profile_not_compiled_in;
+
+#endif
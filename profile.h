@@ -0,0 +1,64 @@
+/* profile.h: Measuring where the time goes within each tick.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#ifndef	_profile_h_
+#define	_profile_h_
+
+/* The phases of a tick that are timed separately. Not every phase is
+ * used by both logic modules.
+ */
+enum {
+    Phase_Housekeeping,		/* initial housekeeping */
+    Phase_ChooseMoves,		/* choosing the creatures' moves */
+    Phase_MoveCreatures,	/* moving the creatures */
+    Phase_MoveChip,		/* choosing and making Chip's move */
+    Phase_FloorMovements,	/* forced moves from the floor (MS) */
+    Phase_SlipList,		/* maintaining the slip list (MS) */
+    Phase_Clones,		/* creating clones (MS) */
+    Phase_Teleports,		/* teleporting creatures (Lynx) */
+    Phase_FinalHousekeeping,	/* final housekeeping and hashing */
+    Phase_Display,		/* preparing the map for display */
+    Phase_Count
+};
+
+#ifdef PROFILE_TICKS
+
+/* Start timing from the current moment.
+ */
+#define	profmark()		(profilemark())
+
+/* Charge the time since the last mark to a phase of the tick, and
+ * start timing anew.
+ */
+#define	profphase(phase)	(profilephase(phase))
+
+/* Charge the time since the last mark to a phase of the tick and to
+ * one type of creature, and start timing anew.
+ */
+#define	profcreature(id, phase)	(profilecreature(id, phase))
+
+/* Add the current level's counts to the running totals. If the
+ * TWORLD_PROFILE_LEVELS environment variable is set, the level's
+ * counts are first written to stderr. The totals are written to
+ * stderr when the program exits.
+ */
+#define	profendlevel(number)	(profileendlevel(number))
+
+extern void profilemark(void);
+extern void profilephase(int phase);
+extern void profilecreature(int id, int phase);
+extern void profileendlevel(int number);
+
+#else
+
+#define	profmark()		((void)0)
+#define	profphase(phase)	((void)0)
+#define	profcreature(id, phase)	((void)(id))
+#define	profendlevel(number)	((void)0)
+
+#endif
+
+#endif
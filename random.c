@@ -22,9 +22,11 @@
 #include	"random.h"
 
 /* The most recently generated random number is stashed here, so that
- * it can provide the initial seed of the next PRNG.
+ * it can provide the initial seed of the next PRNG. Each thread keeps
+ * its own, so that games running on separate threads do not disturb
+ * each other's sequence.
  */
-static unsigned long	lastvalue = 0x80000000UL;
+static THREADLOCAL unsigned long	lastvalue = 0x80000000UL;
 
 /* The standard linear congruential random-number generator needs no
  * introduction.
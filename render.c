@@ -0,0 +1,414 @@
+/* render.c: Writing the frames of solution playbacks to image files.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"play.h"
+#include	"oshw.h"
+#include	"render.h"
+
+/*
+ * Compressing image data. The PNG format requires its pixels to be
+ * stored as a zlib stream, and this is written here directly, so that
+ * the program does not depend on any image or compression libraries.
+ * The compressor is a simple one: it looks for repeated strings with
+ * a short hash chain, and encodes them with the fixed Huffman codes
+ * that every inflater knows. The game's display, being built from
+ * tiles and flat areas of color, compresses well enough this way.
+ */
+
+/* The size of the sliding window, and of the table of hash chains.
+ */
+#define	WINDOWSIZE	32768
+#define	HASHBITS	15
+#define	HASHSIZE	(1 << HASHBITS)
+
+/* The most strings to compare against when looking for a match, and
+ * the shortest and longest matches that can be encoded.
+ */
+#define	MAXCHAIN	16
+#define	MINMATCH	3
+#define	MAXMATCH	258
+
+/* A compressed stream under construction.
+ */
+typedef	struct zstream {
+    unsigned char      *data;		/* the compressed bytes */
+    unsigned long	size;		/* the number of bytes in data */
+    unsigned long	bits;		/* bits not yet added to data */
+    int			bitcount;	/* the number of bits in bits */
+} zstream;
+
+/* The lengths and distances at which each length and distance code
+ * begins, and the number of extra bits that follow each code.
+ */
+static unsigned short const lengthbase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static unsigned char const lengthextra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static unsigned short const distbase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+static unsigned char const distextra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* Add count bits to the stream, least significant bit first.
+ */
+static void putbits(zstream *zs, unsigned long value, int count)
+{
+    zs->bits |= value << zs->bitcount;
+    zs->bitcount += count;
+    while (zs->bitcount >= 8) {
+	zs->data[zs->size++] = (unsigned char)(zs->bits & 255);
+	zs->bits >>= 8;
+	zs->bitcount -= 8;
+    }
+}
+
+/* Add a Huffman code to the stream. Huffman codes are stored most
+ * significant bit first, unlike everything else.
+ */
+static void putcode(zstream *zs, unsigned int code, int length)
+{
+    unsigned int	r = 0;
+    int			n;
+
+    for (n = 0 ; n < length ; ++n, code >>= 1)
+	r = (r << 1) | (code & 1);
+    putbits(zs, r, length);
+}
+
+/* Add a symbol from the literal/length alphabet, using the fixed
+ * Huffman codes.
+ */
+static void putsymbol(zstream *zs, int sym)
+{
+    if (sym < 144)
+	putcode(zs, 0x30 + sym, 8);
+    else if (sym < 256)
+	putcode(zs, 0x190 + sym - 144, 9);
+    else if (sym < 280)
+	putcode(zs, sym - 256, 7);
+    else
+	putcode(zs, 0xC0 + sym - 280, 8);
+}
+
+/* Add a copy of an earlier string to the stream.
+ */
+static void putmatch(zstream *zs, int length, int distance)
+{
+    int	n;
+
+    for (n = 0 ; n < 28 && lengthbase[n + 1] <= length ; ++n) ;
+    putsymbol(zs, 257 + n);
+    putbits(zs, length - lengthbase[n], lengthextra[n]);
+    for (n = 0 ; n < 29 && distbase[n + 1] <= distance ; ++n) ;
+    putcode(zs, n, 5);
+    putbits(zs, distance - distbase[n], distextra[n]);
+}
+
+/* Return the hash chain for the three bytes at p.
+ */
+static int hash3(unsigned char const *p)
+{
+    return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (HASHSIZE - 1);
+}
+
+/* Compress size bytes of data as a single fixed-Huffman deflate
+ * block, and append it to the stream.
+ */
+static void deflatedata(zstream *zs, unsigned char const *data,
+			unsigned long size)
+{
+    long	       *head, *prev;
+    long		pos, cand, bestdist, end;
+    int			bestlen, len, maxlen, chain;
+
+    if (!(head = malloc(HASHSIZE * sizeof *head))
+			|| !(prev = malloc(WINDOWSIZE * sizeof *prev)))
+	memerrexit();
+    for (pos = 0 ; pos < HASHSIZE ; ++pos)
+	head[pos] = -1;
+
+    putbits(zs, 1, 1);
+    putbits(zs, 1, 2);
+    end = (long)size - MINMATCH + 1;
+    pos = 0;
+    while (pos < (long)size) {
+	bestlen = 0;
+	bestdist = 0;
+	if (pos < end) {
+	    maxlen = size - pos < MAXMATCH ? (int)(size - pos) : MAXMATCH;
+	    cand = head[hash3(data + pos)];
+	    for (chain = MAXCHAIN ; chain && cand >= 0 ; --chain) {
+		if (pos - cand > WINDOWSIZE)
+		    break;
+		for (len = 0 ; len < maxlen ; ++len)
+		    if (data[cand + len] != data[pos + len])
+			break;
+		if (len > bestlen) {
+		    bestlen = len;
+		    bestdist = pos - cand;
+		    if (len == maxlen)
+			break;
+		}
+		if (prev[cand & (WINDOWSIZE - 1)] >= cand)
+		    break;
+		cand = prev[cand & (WINDOWSIZE - 1)];
+	    }
+	}
+	if (bestlen >= MINMATCH) {
+	    putmatch(zs, bestlen, bestdist);
+	} else {
+	    putsymbol(zs, data[pos]);
+	    bestlen = 1;
+	}
+	for ( ; bestlen ; --bestlen, ++pos) {
+	    if (pos < end) {
+		prev[pos & (WINDOWSIZE - 1)] = head[hash3(data + pos)];
+		head[hash3(data + pos)] = pos;
+	    }
+	}
+    }
+    putsymbol(zs, 256);
+    if (zs->bitcount)
+	putbits(zs, 0, 8 - zs->bitcount);
+
+    free(head);
+    free(prev);
+}
+
+/* Return the Adler-32 checksum of the given data.
+ */
+static unsigned long adler32(unsigned char const *data, unsigned long size)
+{
+    unsigned long	a = 1, b = 0;
+    unsigned long	n;
+
+    while (size) {
+	n = size < 5552 ? size : 5552;
+	size -= n;
+	while (n--) {
+	    a += *data++;
+	    b += a;
+	}
+	a %= 65521;
+	b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+/*
+ * Writing PNG files.
+ */
+
+/* The CRC-32 of every byte value, computed on first use.
+ */
+static unsigned long	crctable[256];
+
+/* Store a 32-bit value in big-endian order.
+ */
+static void putbe32(unsigned char *p, unsigned long value)
+{
+    p[0] = (unsigned char)((value >> 24) & 255);
+    p[1] = (unsigned char)((value >> 16) & 255);
+    p[2] = (unsigned char)((value >> 8) & 255);
+    p[3] = (unsigned char)(value & 255);
+}
+
+/* Continue a running CRC-32 over the given data.
+ */
+static unsigned long updatecrc(unsigned long crc,
+			       unsigned char const *data, unsigned long size)
+{
+    unsigned long	c;
+    int			n, k;
+
+    if (!crctable[1]) {
+	for (n = 0 ; n < 256 ; ++n) {
+	    c = n;
+	    for (k = 0 ; k < 8 ; ++k)
+		c = c & 1 ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+	    crctable[n] = c;
+	}
+    }
+    while (size--)
+	crc = crctable[(crc ^ *data++) & 255] ^ (crc >> 8);
+    return crc;
+}
+
+/* Write one chunk of a PNG file.
+ */
+static int writechunk(fileinfo *file, char const *type,
+		      unsigned char const *data, unsigned long size)
+{
+    unsigned char	buf[8];
+    unsigned long	crc;
+
+    putbe32(buf, size);
+    memcpy(buf + 4, type, 4);
+    crc = updatecrc(0xFFFFFFFFUL, buf + 4, 4);
+    crc = updatecrc(crc, data, size) ^ 0xFFFFFFFFUL;
+    if (!filewrite(file, buf, 8, NULL))
+	return FALSE;
+    if (size && !filewrite(file, data, size, NULL))
+	return FALSE;
+    putbe32(buf, crc);
+    return filewrite(file, buf, 4, NULL);
+}
+
+/* Write an image of 24-bit RGB pixels to a file in PNG format.
+ */
+static int writepng(fileinfo *file, unsigned char const *image,
+		    int width, int height)
+{
+    static unsigned char const	signature[8] = {
+	0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+    };
+    unsigned char	header[13];
+    unsigned char      *raw;
+    zstream		zs;
+    unsigned long	rowsize, rawsize;
+    int			y, f;
+
+    rowsize = 3 * width;
+    rawsize = (rowsize + 1) * height;
+    if (!(raw = malloc(rawsize)))
+	memerrexit();
+    for (y = 0 ; y < height ; ++y) {
+	raw[y * (rowsize + 1)] = 0;
+	memcpy(raw + y * (rowsize + 1) + 1, image + y * rowsize, rowsize);
+    }
+    zs.size = 0;
+    zs.bits = 0;
+    zs.bitcount = 0;
+    if (!(zs.data = malloc(2 * rawsize + 64)))
+	memerrexit();
+    zs.data[zs.size++] = 0x78;
+    zs.data[zs.size++] = 0x01;
+    deflatedata(&zs, raw, rawsize);
+    putbe32(zs.data + zs.size, adler32(raw, rawsize));
+    zs.size += 4;
+    free(raw);
+
+    putbe32(header, width);
+    putbe32(header + 4, height);
+    header[8] = 8;		/* bits per sample */
+    header[9] = 2;		/* RGB color */
+    header[10] = 0;		/* deflate compression */
+    header[11] = 0;		/* adaptive filtering */
+    header[12] = 0;		/* no interlacing */
+    f = filewrite(file, signature, sizeof signature, NULL)
+	&& writechunk(file, "IHDR", header, sizeof header)
+	&& writechunk(file, "IDAT", zs.data, zs.size)
+	&& writechunk(file, "IEND", NULL, 0);
+    free(zs.data);
+    return f;
+}
+
+/*
+ * Rendering playbacks.
+ */
+
+/* Draw the current state of the game and write it to a file in dir,
+ * named after the level number and the tick.
+ */
+static int renderframe(char const *dir, int number, int tick)
+{
+    fileinfo		file;
+    char		name[32];
+    unsigned char      *image;
+    int			width, height, f;
+
+    drawscreen(TRUE);
+    if (!(image = getdisplayimage(&width, &height))) {
+	errmsg(NULL, "unable to read the display");
+	return FALSE;
+    }
+    sprintf(name, "%03d-%06d.png", number, tick);
+    clearfileinfo(&file);
+    f = openfileindir(&file, dir, name, "wb", "unknown error");
+    if (f) {
+	f = writepng(&file, image, width, height);
+	if (!f)
+	    fileerr(&file, "unable to write image");
+	fileclose(&file, NULL);
+    }
+    free(image);
+    return f;
+}
+
+/* Play back the user's solution for a single level, writing the
+ * selected frames. The return value is FALSE if a frame could not be
+ * written.
+ */
+static int renderlevel(gamesetup *game, int ruleset, char const *dir,
+		       renderrange const *range)
+{
+    int	tick, done = 0, f = TRUE;
+
+    if (initgamestate(game, ruleset, TRUE) && prepareplayback()) {
+	setgameplaymode(BeginVerify);
+	for (;;) {
+	    tick = ticksplayed();
+	    if (range->last >= 0 && tick > range->last)
+		break;
+	    if (tick >= range->first && (done || (tick - range->first)
+						    % range->step == 0)) {
+		if (!(f = renderframe(dir, game->number, tick)))
+		    break;
+	    }
+	    if (done)
+		break;
+	    done = doturn(CmdNone);
+	}
+	setgameplaymode(EndVerify);
+    } else {
+	warn("level %d: unable to play back the solution", game->number);
+    }
+    endgamestate();
+    return f;
+}
+
+/* Render the playbacks of the user's solutions, one level at a time.
+ */
+int renderseries(gameseries *series, int number, char const *dir,
+		 renderrange const *range)
+{
+    gamesetup  *game;
+    int		count = 0, i;
+
+    if (!finddir(dir)) {
+	errmsg(dir, "unable to use the directory");
+	return FALSE;
+    }
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	if (number && game->number != number)
+	    continue;
+	if (!hassolution(game))
+	    continue;
+	if (!renderlevel(game, series->ruleset, dir, range))
+	    return FALSE;
+	++count;
+    }
+    if (!count) {
+	errmsg(NULL, "no solutions to render");
+	return FALSE;
+    }
+    return TRUE;
+}
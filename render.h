@@ -0,0 +1,33 @@
+/* render.h: Writing the frames of solution playbacks to image files.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#ifndef	_render_h_
+#define	_render_h_
+
+#include	"defs.h"
+
+/* The ticks of a playback that are written out: every step'th tick
+ * from first through last. A negative value for last continues to
+ * the end of the playback.
+ */
+typedef	struct renderrange {
+    int		first;		/* the first tick to write */
+    int		last;		/* the last tick to write, or -1 */
+    int		step;		/* the number of ticks between frames */
+} renderrange;
+
+/* Play back the user's solutions for the series as quickly as
+ * possible, writing the selected frames of each playback to PNG files
+ * in dir. The files are named after the level number and the tick,
+ * e.g. "012-000340.png". The final frame of a playback is always
+ * written if it falls within the range. If number is nonzero, only
+ * that level is rendered. The return value is FALSE if an error
+ * occurred.
+ */
+extern int renderseries(gameseries *series, int number, char const *dir,
+			renderrange const *range);
+
+#endif
@@ -8,6 +8,7 @@
 #include	<stdlib.h>
 #include	<string.h>
 #include	<ctype.h>
+#include	<pthread.h>
 #include	"defs.h"
 #include	"err.h"
 #include	"fileio.h"
@@ -24,18 +25,14 @@
 #define	SIG_DATFILE_MS		0x0002
 #define	SIG_DATFILE_LYNX	0x0102
 
-/* The "signature bytes" of the configuration files.
+/* The size of a data file's header: the signature, the ruleset, and
+ * the number of levels. The first level follows immediately.
  */
-#define	SIG_DACFILE		0x656C6966
+#define	DATFILE_HEADER_SIZE	6
 
-/* Mini-structure for passing data in and out of findfiles().
+/* The "signature bytes" of the configuration files.
  */
-typedef	struct seriesdata {
-    gameseries *list;		/* the gameseries list */
-    int		allocated;	/* number of gameseries currently allocated */
-    int		count;		/* number of gameseries filled in */
-    int		usedatdir;	/* TRUE if the file is in seriesdatdir. */
-} seriesdata;
+#define	SIG_DACFILE		0x656C6966
 
 /* The directory containing the series files (data files and
  * configuration files).
@@ -120,62 +117,70 @@ static unsigned long hashvalue(unsigned char const *data, unsigned int size)
  * Reading the data file.
  */
 
-/* Examine the top of a data file and identify its type. FALSE is
- * returned if any header bytes appear to be invalid.
+/* Read the top of a data file, returning the file's ruleset and its
+ * number of levels. FALSE is returned if any header bytes appear to
+ * be invalid.
  */
-static int readseriesheader(gameseries *series)
+static int readdatheader(fileinfo *file, int *ruleset, int *count)
 {
     unsigned short	val16;
-    int			ruleset;
 
-    if (!filereadint16(&series->mapfile, &val16, "not a valid data file"))
+    if (!filereadint16(file, &val16, "not a valid data file"))
 	return FALSE;
     if (val16 != SIG_DATFILE)
-	return fileerr(&series->mapfile, "not a valid data file");
-    if (!filereadint16(&series->mapfile, &val16, "not a valid data file"))
+	return fileerr(file, "not a valid data file");
+    if (!filereadint16(file, &val16, "not a valid data file"))
 	return FALSE;
     switch (val16) {
-      case SIG_DATFILE_MS:	ruleset = Ruleset_MS;		break;
-      case SIG_DATFILE_LYNX:	ruleset = Ruleset_Lynx;		break;
+      case SIG_DATFILE_MS:	*ruleset = Ruleset_MS;		break;
+      case SIG_DATFILE_LYNX:	*ruleset = Ruleset_Lynx;	break;
       default:
-	fileerr(&series->mapfile, "data file uses an unrecognized ruleset");
+	fileerr(file, "data file uses an unrecognized ruleset");
 	return FALSE;
     }
-    if (series->ruleset == Ruleset_None)
-	series->ruleset = ruleset;
-    if (!filereadint16(&series->mapfile, &val16, "not a valid data file"))
+    if (!filereadint16(file, &val16, "not a valid data file"))
 	return FALSE;
-    series->count = val16;
-    if (!series->count) {
-	fileerr(&series->mapfile, "file contains no maps");
+    *count = val16;
+    if (!*count) {
+	fileerr(file, "file contains no maps");
 	return FALSE;
     }
 
     return TRUE;
 }
 
-/* Read a single level out of the given data file. The level's name,
- * password, and time limit are extracted from the data.
+/* Examine the top of a data file and identify its type. FALSE is
+ * returned if any header bytes appear to be invalid.
  */
-static int readleveldata(fileinfo *file, gamesetup *game)
+static int readseriesheader(gameseries *series)
+{
+    int	ruleset, count;
+
+    if (!readdatheader(&series->mapfile, &ruleset, &count))
+	return FALSE;
+    if (series->ruleset == Ruleset_None)
+	series->ruleset = ruleset;
+    series->count = count;
+    return TRUE;
+}
+
+/* Examine the data for a single level, which is already stored in
+ * the gamesetup. The level's name, password, and time limit are
+ * extracted from the data.
+ */
+static int parseleveldata(char const *filename, gamesetup *game)
 {
     unsigned char	       *data;
     unsigned char const	       *dataend;
     unsigned short		size;
     int				n;
 
-    if (!filereadint16(file, &size, NULL))
-	return FALSE;
-    data = filereadbuf(file, size, "missing or invalid level data");
-    if (!data)
-	return FALSE;
-    if (size < 2) {
-	fileerr(file, "invalid level data");
-	free(data);
+    if (game->levelsize < 2) {
+	errmsg(filename, "invalid level data");
 	return FALSE;
     }
-    game->levelsize = size;
-    game->leveldata = data;
+    data = game->leveldata;
+    size = game->levelsize;
     dataend = game->leveldata + game->levelsize;
 
     game->number = data[0] | (data[1] << 8);
@@ -228,13 +233,73 @@ static int readleveldata(fileinfo *file, gamesetup *game)
     return TRUE;
 
   badlevel:
+    errmsg(filename, "level %d: invalid level data", game->number);
+    return FALSE;
+}
+
+/* Read a single level out of the given data file into a buffer of its
+ * own.
+ */
+static int readleveldata(fileinfo *file, gamesetup *game)
+{
+    unsigned char      *data;
+    unsigned short	size;
+
+    if (!filereadint16(file, &size, NULL))
+	return FALSE;
+    data = filereadbuf(file, size, "missing or invalid level data");
+    if (!data)
+	return FALSE;
+    game->levelsize = size;
+    game->leveldata = data;
+    if (parseleveldata(file->name, game))
+	return TRUE;
     free(game->leveldata);
     game->levelsize = 0;
     game->leveldata = NULL;
-    errmsg(file->name, "level %d: invalid level data", game->number);
     return FALSE;
 }
 
+/* Find the levels in a data file that has been mapped into memory,
+ * starting at the given offset. Each level's data is used in place.
+ * Levels are dropped from the series in the same circumstances as
+ * when the file is read through readleveldata().
+ */
+static void findmappedlevels(gameseries *series, unsigned long pos)
+{
+    unsigned char      *data = series->mapdata;
+    gamesetup	       *game;
+    unsigned long	size;
+    int			n;
+
+    n = 0;
+    while (n < series->count && pos < series->mapsize) {
+	game = series->games + n;
+	if (pos + 2 > series->mapsize) {
+	    errmsg(series->mapfilename, "unexpected EOF");
+	    --series->count;
+	    break;
+	}
+	size = data[pos] | (data[pos + 1] << 8);
+	pos += 2;
+	if (pos + size > series->mapsize) {
+	    errmsg(series->mapfilename, "missing or invalid level data");
+	    --series->count;
+	    break;
+	}
+	game->levelsize = size;
+	game->leveldata = data + pos;
+	pos += size;
+	if (parseleveldata(series->mapfilename, game)) {
+	    ++n;
+	} else {
+	    game->levelsize = 0;
+	    game->leveldata = NULL;
+	    --series->count;
+	}
+    }
+}
+
 /* Assuming that the series passed in is in fact the original
  * chips.dat file, this function undoes the changes that MS introduced
  * to the original Lynx levels. A rather "ad hack" way to accomplish
@@ -274,7 +339,8 @@ static int undomschanges(gameseries *series)
 	if (series->games[fixup->num].levelsize <= fixup->pos)
 	    return FALSE;
 
-    free(series->games[144].leveldata);
+    if (!series->mapdata)
+	free(series->games[144].leveldata);
     memmove(series->games + 144, series->games + 145,
 	    4 * sizeof *series->games);
     --series->count;
@@ -294,6 +360,77 @@ static int undomschanges(gameseries *series)
     return TRUE;
 }
 
+/*
+ * The level index.
+ *
+ * Levels are looked up by number and by password, once for every
+ * solution read and whenever the user enters a password. Once a
+ * series has been read in, an index is built that allows these
+ * lookups to avoid scanning the entire series. The index is a single
+ * array of ints: two tables of buckets, one hashed on the level number
+ * and one hashed on the password, each holding the first level in the
+ * bucket (or -1), followed by two arrays with an entry for every
+ * level, giving the next level in the same bucket.
+ */
+
+/* Macros for accessing the four parts of the index.
+ */
+#define	numberbuckets(s)	((s)->levelindex)
+#define	passwdbuckets(s)	((s)->levelindex + (s)->indexsize)
+#define	nextbynumber(s)		((s)->levelindex + 2 * (s)->indexsize)
+#define	nextbypasswd(s)		(nextbynumber(s) + (s)->count)
+
+/* Return the buckets that a level number and a password belong in.
+ */
+#define	numberbucket(s, n)	((unsigned int)(n) & ((s)->indexsize - 1))
+#define	passwdbucket(s, p)	\
+    (hashvalue((unsigned char const*)(p), strlen(p)) & ((s)->indexsize - 1))
+
+/* Discard the series' level index.
+ */
+static void freelevelindex(gameseries *series)
+{
+    free(series->levelindex);
+    series->levelindex = NULL;
+    series->indexsize = 0;
+}
+
+/* Build the index for a series whose levels have all been read. The
+ * number of buckets is the smallest power of two that is at least
+ * the number of levels.
+ */
+static void buildlevelindex(gameseries *series)
+{
+    int	       *buckets;
+    int	       *next;
+    int		i, b;
+
+    freelevelindex(series);
+    if (series->count <= 0)
+	return;
+    for (series->indexsize = 1 ; series->indexsize < series->count ;
+	 series->indexsize <<= 1) ;
+    xalloc(series->levelindex, (2 * series->indexsize + 2 * series->count)
+					* sizeof *series->levelindex);
+    for (i = 0 ; i < 2 * series->indexsize ; ++i)
+	series->levelindex[i] = -1;
+
+    buckets = numberbuckets(series);
+    next = nextbynumber(series);
+    for (i = series->count - 1 ; i >= 0 ; --i) {
+	b = numberbucket(series, series->games[i].number);
+	next[i] = buckets[b];
+	buckets[b] = i;
+    }
+    buckets = passwdbuckets(series);
+    next = nextbypasswd(series);
+    for (i = series->count - 1 ; i >= 0 ; --i) {
+	b = passwdbucket(series, series->games[i].passwd);
+	next[i] = buckets[b];
+	buckets[b] = i;
+    }
+}
+
 /*
  * Functions to read the data files.
  */
@@ -324,17 +461,23 @@ int readseriesfile(gameseries *series)
     memset(series->games + series->allocated, 0,
 	   (series->count - series->allocated) * sizeof *series->games);
     series->allocated = series->count;
-    n = 0;
-    while (n < series->count && !filetestend(&series->mapfile)) {
-	if (readleveldata(&series->mapfile, series->games + n))
-	    ++n;
-	else
-	    --series->count;
+    series->mapdata = filemap(&series->mapfile, &series->mapsize);
+    if (series->mapdata) {
+	findmappedlevels(series, DATFILE_HEADER_SIZE);
+    } else {
+	n = 0;
+	while (n < series->count && !filetestend(&series->mapfile)) {
+	    if (readleveldata(&series->mapfile, series->games + n))
+		++n;
+	    else
+		--series->count;
+	}
     }
     fileclose(&series->mapfile, NULL);
     series->gsflags |= GSF_ALLMAPSREAD;
     if (series->gsflags & GSF_LYNXFIXES)
 	undomschanges(series);
+    buildlevelindex(series);
     markunsolvablelevels(series);
     readsolutions(series);
     if (series->msgfilename)
@@ -365,10 +508,15 @@ void freeseriesdata(gameseries *series)
     series->currentlevel = 0;
 
     for (n = 0, game = series->games ; n < series->count ; ++n, ++game) {
-	free(game->leveldata);
+	if (!series->mapdata)
+	    free(game->leveldata);
 	game->leveldata = NULL;
 	game->levelsize = 0;
     }
+    fileunmap(series->mapdata, series->mapsize);
+    series->mapdata = NULL;
+    series->mapsize = 0;
+    freelevelindex(series);
     free(series->games);
     series->games = NULL;
     series->allocated = 0;
@@ -384,13 +532,14 @@ void freeseriesdata(gameseries *series)
  * Reading the configuration file.
  */
 
-/* Parse the lines of the given configuration file. The return value
- * is the name of the corresponding data file, or NULL if the
+/* Parse the lines of the given configuration file. The name of the
+ * corresponding data file is stored in datfilename, which must have
+ * room for 256 bytes. The return value is datfilename, or NULL if the
  * configuration file could not be read or contained a syntax error.
  */
-static char *readconfigfile(fileinfo *file, gameseries *series)
+static char *readconfigfile(fileinfo *file, gameseries *series,
+			    char *datfilename)
 {
-    static char	datfilename[256];
     char	buf[256];
     char	name[256];
     char	value[256];
@@ -455,48 +604,267 @@ static char *readconfigfile(fileinfo *file, gameseries *series)
 }
 
 /*
- * Functions to locate the series files.
+ * Remembering the headers of the data files.
+ */
+
+/* The file in the user's save directory that records the header of
+ * every data file seen on the previous run, together with the file's
+ * size and modification time. A data file that has not changed since
+ * then does not need to be opened again.
+ */
+#define	HEADERCACHE_NAME	".seriescache"
+#define	HEADERCACHE_SIG		"tworld series cache 1"
+
+/* What is remembered about a data file.
+ */
+typedef	struct headerstamp {
+    unsigned long	size;		/* the file's size in bytes */
+    unsigned long	mtime;		/* the file's modification time */
+    int			ruleset;	/* the ruleset given in the header */
+    int			count;		/* the number of levels, or zero */
+} headerstamp;
+
+/* One data file's entry in the cache.
  */
+typedef	struct cacheentry {
+    char	       *path;		/* the data file's pathname */
+    headerstamp		stamp;		/* the file's header */
+} cacheentry;
 
-/* Open the given file and read the information in the file header (or
- * the entire file if it is a configuration file), then allocate and
- * initialize a gameseries structure for the file and add it to the
- * list stored under the second argument. This function is used as a
- * findfiles() callback.
+/* The contents of the cache file.
  */
-static int getseriesfile(char *filename, void *data)
+typedef	struct headercache {
+    cacheentry	       *list;		/* the entries, sorted by path */
+    int			count;		/* the number of entries */
+} headercache;
+
+/* A callback function to compare two cache entries by their paths.
+ */
+static int cacheentrycmp(void const *a, void const *b)
+{
+    return strcmp(((cacheentry*)a)->path, ((cacheentry*)b)->path);
+}
+
+/* Look up the data file at path in the cache. The file's current size
+ * and modification time are stored in stamp. TRUE is returned if these
+ * match the cache entry, in which case the rest of stamp is filled in
+ * from the cache.
+ */
+static int lookupheader(headercache const *cache, char const *path,
+			headerstamp *stamp)
+{
+    cacheentry const   *entry;
+    cacheentry		key;
+
+    stamp->ruleset = Ruleset_None;
+    stamp->count = 0;
+    if (!filestamp(path, &stamp->size, &stamp->mtime)) {
+	stamp->size = 0;
+	stamp->mtime = 0;
+	return FALSE;
+    }
+    if (!cache || !cache->count)
+	return FALSE;
+    key.path = (char*)path;
+    entry = bsearch(&key, cache->list, cache->count, sizeof *cache->list,
+		    cacheentrycmp);
+    if (!entry || entry->stamp.size != stamp->size
+	       || entry->stamp.mtime != stamp->mtime)
+	return FALSE;
+    *stamp = entry->stamp;
+    return TRUE;
+}
+
+/* Read the cache file from the user's save directory. The cache is
+ * left empty if the file is absent or unrecognized; a damaged entry
+ * causes it and the entries after it to be ignored.
+ */
+static void loadheadercache(headercache *cache)
 {
     fileinfo		file;
-    seriesdata	       *sdata = (seriesdata*)data;
-    gameseries	       *series;
-    unsigned long	magic;
-    char	       *datfilename;
-    int			config, f;
+    headerstamp		stamp;
+    char const	       *savedir;
+    char	       *buf;
+    int			allocated = 0;
+    int			size, pos, n;
 
+    cache->list = NULL;
+    cache->count = 0;
+    savedir = getsavedir();
+    if (!savedir || !*savedir)
+	return;
     clearfileinfo(&file);
-    if (!openfileindir(&file, seriesdir, filename, "rb", "unknown error"))
-	return 0;
-    if (!filereadint32(&file, &magic, "unexpected EOF")) {
-	fileclose(&file, NULL);
-	return 0;
+    if (!openfileindir(&file, savedir, HEADERCACHE_NAME, "r", NULL))
+	return;
+
+    size = getpathbufferlen() + 64;
+    if (!(buf = malloc(size)))
+	memerrexit();
+    n = size - 1;
+    if (!filegetline(&file, buf, &n, NULL))
+	n = 0;
+    buf[n] = '\0';
+    if (!strcmp(buf, HEADERCACHE_SIG)) {
+	for (;;) {
+	    n = size - 1;
+	    if (!filegetline(&file, buf, &n, NULL))
+		break;
+	    buf[n] = '\0';
+	    pos = 0;
+	    if (sscanf(buf, "%lu %lu %d %d %n", &stamp.size, &stamp.mtime,
+			    &stamp.ruleset, &stamp.count, &pos) < 4 || !pos)
+		break;
+	    if ((stamp.ruleset != Ruleset_MS && stamp.ruleset != Ruleset_Lynx)
+						|| stamp.count <= 0)
+		break;
+	    if (cache->count >= allocated) {
+		allocated = allocated ? allocated * 2 : 64;
+		xalloc(cache->list, allocated * sizeof *cache->list);
+	    }
+	    cache->list[cache->count].stamp = stamp;
+	    n = strlen(buf + pos) + 1;
+	    cache->list[cache->count].path = NULL;
+	    xalloc(cache->list[cache->count].path, n);
+	    memcpy(cache->list[cache->count].path, buf + pos, n);
+	    ++cache->count;
+	}
     }
-    filerewind(&file, NULL);
-    if (magic == SIG_DACFILE) {
-	config = TRUE;
-    } else if ((magic & 0xFFFF) == SIG_DATFILE) {
-	config = FALSE;
-    } else {
-	fileerr(&file, "not a valid data file or configuration file");
-	fileclose(&file, NULL);
-	return 0;
+    free(buf);
+    fileclose(&file, NULL);
+    if (cache->count > 1)
+	qsort(cache->list, cache->count, sizeof *cache->list, cacheentrycmp);
+}
+
+/* Write the given cache entries to the user's save directory, unless
+ * they are the same as the ones that were read in. entries is sorted
+ * and duplicates removed before the comparison.
+ */
+static void saveheadercache(headercache const *cache,
+			    cacheentry *entries, int count)
+{
+    fileinfo	file;
+    char const *savedir;
+    char       *path;
+    char       *tmpname;
+    char       *buf;
+    int		f, i, n;
+
+    if (count > 1)
+	qsort(entries, count, sizeof *entries, cacheentrycmp);
+    for (i = n = 0 ; i < count ; ++i)
+	if (!n || strcmp(entries[i].path, entries[n - 1].path))
+	    entries[n++] = entries[i];
+    count = n;
+    if (count == cache->count) {
+	for (i = 0 ; i < count ; ++i)
+	    if (strcmp(entries[i].path, cache->list[i].path)
+			|| memcmp(&entries[i].stamp, &cache->list[i].stamp,
+				  sizeof entries[i].stamp))
+		break;
+	if (i == count)
+	    return;
     }
 
-    if (sdata->count >= sdata->allocated) {
-	sdata->allocated = sdata->count + 1;
-	xalloc(sdata->list, sdata->allocated * sizeof *sdata->list);
+    savedir = getsavedir();
+    if (iscachereadonly() || !savedir || !*savedir || !finddir(savedir))
+	return;
+    if (!(path = getpathforfileindir(savedir, HEADERCACHE_NAME)))
+	return;
+    tmpname = NULL;
+    xalloc(tmpname, strlen(path) + 5);
+    sprintf(tmpname, "%s.tmp", path);
+    buf = NULL;
+    xalloc(buf, getpathbufferlen() + 64);
+
+    clearfileinfo(&file);
+    f = fileopen(&file, tmpname, "w", NULL);
+    if (f) {
+	n = sprintf(buf, "%s\n", HEADERCACHE_SIG);
+	f = filewrite(&file, buf, n, NULL);
+	for (i = 0 ; f && i < count ; ++i) {
+	    if ((int)strlen(entries[i].path) > getpathbufferlen())
+		continue;
+	    n = sprintf(buf, "%lu %lu %d %d %s\n",
+			entries[i].stamp.size, entries[i].stamp.mtime,
+			entries[i].stamp.ruleset, entries[i].stamp.count,
+			entries[i].path);
+	    f = filewrite(&file, buf, n, NULL);
+	}
+	if (f) {
+	    filereplace(&file, path, NULL);
+	} else {
+	    fileclose(&file, NULL);
+	    remove(tmpname);
+	}
     }
-    series = sdata->list + sdata->count;
+    free(buf);
+    free(tmpname);
+    free(path);
+}
+
+/* Free the memory used by the cache.
+ */
+static void freeheadercache(headercache *cache)
+{
+    int	n;
+
+    for (n = 0 ; n < cache->count ; ++n)
+	free(cache->list[n].path);
+    free(cache->list);
+    cache->list = NULL;
+    cache->count = 0;
+}
+
+/*
+ * Functions to locate the series files.
+ */
+
+/* The number of threads used to examine the files in the series
+ * directory. Most of the time is spent waiting on the disk, so this
+ * need not be tied to the number of processors.
+ */
+#define	SERIES_THREADS		8
+
+/* One file found in the series directory.
+ */
+typedef	struct seriesfile {
+    char	       *filename;	/* the file's name */
+    headerstamp		stamp;		/* the header of its data file */
+    int			found;		/* TRUE if it describes a series */
+    errlog		log;		/* messages issued while reading it */
+} seriesfile;
+
+/* Mini-structure for passing data in and out of findfiles(), and for
+ * sharing the work of examining the files among several threads.
+ */
+typedef	struct seriesdata {
+    gameseries	       *list;		/* the series, one per file */
+    seriesfile	       *files;		/* the files found */
+    int			allocated;	/* number of files allocated */
+    int			count;		/* number of files found */
+    int			next;		/* the next file to examine */
+    headercache		cache;		/* the previous run's headers */
+    pthread_mutex_t	lock;		/* protects next */
+} seriesdata;
+
+/* Store the ruleset and level count from a data file's header in
+ * series. A ruleset chosen by a configuration file takes precedence.
+ */
+static void setseriesheader(gameseries *series, headerstamp const *stamp)
+{
+    if (series->ruleset == Ruleset_None)
+	series->ruleset = stamp->ruleset;
+    series->count = stamp->count;
+}
+
+/* Initialize the fields of a gameseries structure for the file.
+ */
+static void initseries(gameseries *series, char const *filename)
+{
+    clearfileinfo(&series->mapfile);
     series->mapfilename = NULL;
+    series->mapdata = NULL;
+    series->mapsize = 0;
     clearfileinfo(&series->savefile);
     series->savefilename = NULL;
     series->msgfilename = NULL;
@@ -508,44 +876,190 @@ static int getseriesfile(char *filename, void *data)
     series->final = 0;
     series->ruleset = Ruleset_None;
     series->games = NULL;
+    series->levelindex = NULL;
+    series->indexsize = 0;
     sprintf(series->filebase, "%.*s", (int)(sizeof series->filebase - 1),
 				      filename);
     sprintf(series->name, "%.*s", (int)(sizeof series->name - 1),
 				  skippathname(filename));
+}
+
+/* Read the information in the header of the given file (or the entire
+ * file if it is a configuration file), and initialize a gameseries
+ * structure for it. A data file that is found unchanged in the cache
+ * is not opened. FALSE is returned if the file does not describe a
+ * usable series.
+ */
+static int getseriesfile(char const *filename, gameseries *series,
+			 headercache const *cache, headerstamp *stamp)
+{
+    fileinfo		file;
+    unsigned long	magic;
+    char		datfilename[256];
+    char	       *path;
+    int			f;
+
+    initseries(series, filename);
+    if (!(path = getpathforfileindir(seriesdir, filename)))
+	return FALSE;
+    if (lookupheader(cache, path, stamp)) {
+	setseriesheader(series, stamp);
+	series->mapfilename = path;
+	return TRUE;
+    }
 
-    f = FALSE;
-    if (config) {
+    clearfileinfo(&file);
+    if (!openfileindir(&file, seriesdir, filename, "rb", "unknown error")) {
+	free(path);
+	return FALSE;
+    }
+    if (!filereadint32(&file, &magic, "unexpected EOF")) {
 	fileclose(&file, NULL);
-	if (!openfileindir(&file, seriesdir, filename, "r", "unknown error"))
-	    return 0;
-	clearfileinfo(&series->mapfile);
-	free(series->mapfilename);
-	series->mapfilename = NULL;
-	datfilename = readconfigfile(&file, series);
+	free(path);
+	return FALSE;
+    }
+    filerewind(&file, NULL);
+    if ((magic & 0xFFFF) == SIG_DATFILE) {
+	f = readdatheader(&file, &stamp->ruleset, &stamp->count);
 	fileclose(&file, NULL);
-	if (datfilename) {
-	    if (openfileindir(&series->mapfile, seriesdatdir,
-			      datfilename, "rb", NULL))
-		f = readseriesheader(series);
-	    else
-		warn("cannot use %s: %s unavailable", filename, datfilename);
-	    fileclose(&series->mapfile, NULL);
-	    clearfileinfo(&series->mapfile);
-	    if (f)
-		series->mapfilename = getpathforfileindir(seriesdatdir,
-							  datfilename);
+	if (!f) {
+	    free(path);
+	    return FALSE;
 	}
-    } else {
-	series->mapfile = file;
-	f = readseriesheader(series);
-	fileclose(&series->mapfile, NULL);
-	clearfileinfo(&series->mapfile);
-	if (f)
-	    series->mapfilename = getpathforfileindir(seriesdir, filename);
-    }
-    if (f)
-	++sdata->count;
-    return 0;
+	setseriesheader(series, stamp);
+	series->mapfilename = path;
+	return TRUE;
+    }
+    free(path);
+    if (magic != SIG_DACFILE) {
+	fileerr(&file, "not a valid data file or configuration file");
+	fileclose(&file, NULL);
+	return FALSE;
+    }
+
+    fileclose(&file, NULL);
+    if (!openfileindir(&file, seriesdir, filename, "r", "unknown error"))
+	return FALSE;
+    f = readconfigfile(&file, series, datfilename) != NULL;
+    fileclose(&file, NULL);
+    if (!f)
+	return FALSE;
+
+    if (!(path = getpathforfileindir(seriesdatdir, datfilename)))
+	return FALSE;
+    if (!lookupheader(cache, path, stamp)) {
+	if (!openfileindir(&file, seriesdatdir, datfilename, "rb", NULL)) {
+	    warn("cannot use %s: %s unavailable", filename, datfilename);
+	    free(path);
+	    return FALSE;
+	}
+	f = readdatheader(&file, &stamp->ruleset, &stamp->count);
+	fileclose(&file, NULL);
+	if (!f) {
+	    free(path);
+	    return FALSE;
+	}
+    }
+    setseriesheader(series, stamp);
+    series->mapfilename = path;
+    return TRUE;
+}
+
+/* Add a file to the list of those to be examined. This function is
+ * used as a findfiles() callback.
+ */
+static int addseriesfile(char *filename, void *data)
+{
+    seriesdata *sdata = data;
+
+    if (sdata->count >= sdata->allocated) {
+	sdata->allocated = sdata->allocated ? sdata->allocated * 2 : 64;
+	xalloc(sdata->files, sdata->allocated * sizeof *sdata->files);
+    }
+    sdata->files[sdata->count].filename = filename;
+    sdata->files[sdata->count].found = FALSE;
+    sdata->files[sdata->count].log.list = NULL;
+    sdata->files[sdata->count].log.count = 0;
+    ++sdata->count;
+    return 1;
+}
+
+/* The body of a thread examining the series files. Each thread takes
+ * the next unexamined file until there are none left. The messages
+ * about each file are held back, so that they can be displayed in the
+ * order of the files instead of the order the threads reach them.
+ */
+static void *seriesthread(void *data)
+{
+    seriesdata *sdata = data;
+    seriesfile *sfile;
+    int		n;
+
+    for (;;) {
+	pthread_mutex_lock(&sdata->lock);
+	n = sdata->next < sdata->count ? sdata->next++ : -1;
+	pthread_mutex_unlock(&sdata->lock);
+	if (n < 0)
+	    break;
+	sfile = sdata->files + n;
+	holdmessages(&sfile->log);
+	sfile->found = getseriesfile(sfile->filename, sdata->list + n,
+				     &sdata->cache, &sfile->stamp);
+	holdmessages(NULL);
+    }
+    return NULL;
+}
+
+/* Examine every file in the series directory, using several threads,
+ * and return the series found in sdata->list, in the order that the
+ * files were found. The cache of data file headers is brought up to
+ * date afterwards.
+ */
+static void findseriesfiles(seriesdata *sdata)
+{
+    pthread_t	threads[SERIES_THREADS];
+    cacheentry *entries;
+    int		jobs, i, n;
+
+    sdata->list = NULL;
+    xalloc(sdata->list, (sdata->count + 1) * sizeof *sdata->list);
+    loadheadercache(&sdata->cache);
+    sdata->next = 0;
+    pthread_mutex_init(&sdata->lock, NULL);
+    jobs = sdata->count < SERIES_THREADS ? sdata->count : SERIES_THREADS;
+    for (n = 0 ; n < jobs - 1 ; ++n)
+	if (pthread_create(threads + n, NULL, seriesthread, sdata))
+	    break;
+    seriesthread(sdata);
+    for (i = 0 ; i < n ; ++i)
+	pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&sdata->lock);
+    for (i = 0 ; i < sdata->count ; ++i)
+	showheldmessages(&sdata->files[i].log);
+
+    entries = malloc((sdata->count + 1) * sizeof *entries);
+    if (!entries)
+	memerrexit();
+    for (i = n = 0 ; i < sdata->count ; ++i) {
+	if (sdata->files[i].found) {
+	    entries[n].path = sdata->list[i].mapfilename;
+	    entries[n].stamp = sdata->files[i].stamp;
+	    ++n;
+	}
+    }
+    saveheadercache(&sdata->cache, entries, n);
+    free(entries);
+    freeheadercache(&sdata->cache);
+
+    for (i = n = 0 ; i < sdata->count ; ++i) {
+	if (sdata->files[i].found)
+	    sdata->list[n++] = sdata->list[i];
+	free(sdata->files[i].filename);
+    }
+    free(sdata->files);
+    sdata->files = NULL;
+    sdata->allocated = 0;
+    sdata->count = n;
 }
 
 /* A callback function to compare two gameseries structures by
@@ -567,15 +1081,17 @@ static int gameseriescmp(void const *a, void const *b)
 static int getseriesfiles(char const *preferred, gameseries **list, int *count)
 {
     seriesdata	s;
+    headerstamp	stamp;
     int		n;
 
     s.list = NULL;
+    s.files = NULL;
     s.allocated = 0;
     s.count = 0;
-    s.usedatdir = FALSE;
     if (preferred && *preferred && haspathname(preferred)) {
-	if (getseriesfile((char*)preferred, &s) < 0)
-	    return FALSE;
+	xalloc(s.list, sizeof *s.list);
+	if (getseriesfile(preferred, s.list, NULL, &stamp))
+	    s.count = 1;
 	if (!s.count) {
 	    errmsg(preferred, "couldn't read data file");
 	    return FALSE;
@@ -585,7 +1101,11 @@ static int getseriesfiles(char const *preferred, gameseries **list, int *count)
     } else {
 	if (!*seriesdir)
 	    return FALSE;
-	if (!findfiles(seriesdir, &s, getseriesfile) || !s.count) {
+	if (!findfiles(seriesdir, &s, addseriesfile))
+	    s.count = 0;
+	else
+	    findseriesfiles(&s);
+	if (!s.count) {
 	    errmsg(seriesdir, "directory contains no data files");
 	    return FALSE;
 	}
@@ -708,6 +1228,44 @@ void freeserieslist(gameseries *list, int count, tablespec *table)
  * Miscellaneous functions
  */
 
+/* Look up a level using the series' index. The results are identical
+ * to those of the linear search below.
+ */
+static int findlevelinindex(gameseries const *series,
+			    int number, char const *passwd)
+{
+    int const  *next;
+    int		i, n;
+
+    n = -1;
+    if (number) {
+	next = nextbynumber(series);
+	for (i = numberbuckets(series)[numberbucket(series, number)] ;
+	     i >= 0 ; i = next[i]) {
+	    if (series->games[i].number == number) {
+		if (!passwd || !strcmp(series->games[i].passwd, passwd)) {
+		    if (n >= 0)
+			return -1;
+		    n = i;
+		}
+	    }
+	}
+    } else if (passwd) {
+	next = nextbypasswd(series);
+	for (i = passwdbuckets(series)[passwdbucket(series, passwd)] ;
+	     i >= 0 ; i = next[i]) {
+	    if (!strcmp(series->games[i].passwd, passwd)) {
+		if (n >= 0)
+		    return -1;
+		n = i;
+	    }
+	}
+    } else {
+	return -1;
+    }
+    return n;
+}
+
 /* A function for looking up a specific level in a series by number
  * and/or password.
  */
@@ -715,6 +1273,9 @@ int findlevelinseries(gameseries const *series, int number, char const *passwd)
 {
     int	i, n;
 
+    if (series->levelindex)
+	return findlevelinindex(series, number, passwd);
+
     n = -1;
     if (number) {
 	for (i = 0 ; i < series->count ; ++i) {
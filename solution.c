@@ -47,6 +47,11 @@
  * without a saved game. Otherwise, the offset should never be less
  * than 16.
  *
+ * A level may appear more than once in the file, in which case the
+ * last appearance is the one that counts. This allows a new solution
+ * to be saved by appending it to the end of the file, instead of
+ * rewriting the entire file.
+ *
  * Note that byte 11 contains the initial random slide direction in
  * the bottom three bits, and the initial stepping value in the next
  * three bits. The top two bits are unused. (The initial random slide
@@ -122,6 +127,11 @@
  */
 enum { F_READ, F_WRITE, F_MODIFY };
 
+/* The number of solutions that can be appended to a solution file
+ * before it is rewritten to remove the solutions they replaced.
+ */
+#define	maxappended(series)	((series)->count < 16 ? 16 : (series)->count)
+
 /* Translate move directions between three-bit and four-bit
  * representations.
  *
@@ -149,6 +159,25 @@ static int const idxdir8[8] = {
 #define	dirtoindex(dir)		(diridx8[dir])
 #define	indextodir(dir)		(idxdir8[dir])
 
+/* The size in bytes of each value in the solution bytes, indexed by
+ * the value's first byte.
+ */
+#define	VSIZE(b)	(((b) & 3) < 2 ? 1 : ((b) & 3) == 2 ? 2 :	\
+			 ((b) & 0x10) ? 2 + (((b) >> 2) & 3) : 4)
+#define	VSIZE4(b)	VSIZE(b), VSIZE((b) + 1), VSIZE((b) + 2),	\
+			VSIZE((b) + 3)
+#define	VSIZE16(b)	VSIZE4(b), VSIZE4((b) + 4), VSIZE4((b) + 8),	\
+			VSIZE4((b) + 12)
+#define	VSIZE64(b)	VSIZE16(b), VSIZE16((b) + 16), VSIZE16((b) + 32), \
+			VSIZE16((b) + 48)
+static unsigned char const valuesize[256] = {
+    VSIZE64(0), VSIZE64(64), VSIZE64(128), VSIZE64(192)
+};
+
+/* The number of moves stored in a value, given its first byte.
+ */
+#define	valuemoves(b)	((b) & 0x03 ? 1 : 3)
+
 /* The path of the directory containing the user's solution files.
  */
 static char const      *savedir = NULL;
@@ -157,6 +186,10 @@ static char const      *savedir = NULL;
  */
 static int		readonly = FALSE;
 
+/* TRUE if the cache files in the save directory may not be updated.
+ */
+static int		cachereadonly = FALSE;
+
 /* Getting and setting the save directory.
  */
 char const *getsavedir(void)		{ return savedir; }
@@ -169,6 +202,27 @@ void setreadonly(void)
     readonly = TRUE;
 }
 
+/* Return TRUE if the system is in read-only mode.
+ */
+int isreadonly(void)
+{
+    return readonly;
+}
+
+/* Prevent the cache files from being updated.
+ */
+void setcachereadonly(void)
+{
+    cachereadonly = TRUE;
+}
+
+/* Return TRUE if the cache files may not be updated.
+ */
+int iscachereadonly(void)
+{
+    return cachereadonly;
+}
+
 /*
  * Functions for manipulating move lists.
  */
@@ -286,15 +340,12 @@ static int writesolutionsetname(fileinfo *file, char const *setname)
  * Solution translation.
  */
 
-/* Expand a level's solution data into an actual list of moves.
+/* Read the solution's header and position the cursor at the start of
+ * the moves.
  */
-int expandsolution(solutioninfo *solution, gamesetup const *game)
+int opensolution(solutioncursor *cursor, solutioninfo *solution,
+		 gamesetup const *game)
 {
-    unsigned char const	       *dataend;
-    unsigned char const	       *p;
-    action			act;
-    int				n;
-
     if (game->solutionsize <= 16)
 	return FALSE;
 
@@ -305,73 +356,131 @@ int expandsolution(solutioninfo *solution, gamesetup const *game)
 					      | (game->solutiondata[10] << 16)
 					      | (game->solutiondata[11] << 24);
 
-    initmovelist(&solution->moves);
-    act.when = -1;
+    cursor->pos = game->solutiondata + 16;
+    cursor->end = game->solutiondata + game->solutionsize;
+    cursor->last.when = -1;
+    cursor->last.dir = NIL;
+    cursor->packed = 0;
+    cursor->packedcount = 0;
+    return TRUE;
+}
+
+/* Decode the next move from the solution data. The three moves stored
+ * in a single byte of the first format are handed out one at a time.
+ */
+int nextsolutionmove(solutioncursor *cursor, action *move)
+{
+    unsigned char const	       *p;
+    int				n;
+
+    if (cursor->packedcount) {
+	cursor->last.dir = indextodir(cursor->packed & 0x03);
+	cursor->last.when += 4;
+	cursor->packed >>= 2;
+	--cursor->packedcount;
+	*move = cursor->last;
+	return +1;
+    }
+
+    p = cursor->pos;
+    if (p >= cursor->end)
+	return 0;
+    if (p + valuesize[*p] > cursor->end)
+	return -1;
+    switch (*p & 0x03) {
+      case 0:
+	cursor->last.dir = indextodir((*p >> 2) & 0x03);
+	cursor->last.when += 4;
+	cursor->packed = *p >> 4;
+	cursor->packedcount = 2;
+	break;
+      case 1:
+	cursor->last.dir = indextodir((*p >> 2) & 0x07);
+	cursor->last.when += ((*p >> 5) & 0x07) + 1;
+	break;
+      case 2:
+	cursor->last.dir = indextodir((*p >> 2) & 0x07);
+	cursor->last.when += ((p[0] >> 5) & 0x07)
+				+ ((unsigned long)p[1] << 3) + 1;
+	break;
+      case 3:
+	if (*p & 0x10) {
+	    n = (*p >> 2) & 0x03;
+	    cursor->last.dir = ((p[0] >> 5) & 0x07) | ((p[1] & 0x3F) << 3);
+	    cursor->last.when += (p[1] >> 6) & 0x03;
+	    while (n--)
+		cursor->last.when += (unsigned long)p[2 + n] << (2 + n * 8);
+	    ++cursor->last.when;
+	} else {
+	    cursor->last.dir = indextodir((*p >> 2) & 0x03);
+	    cursor->last.when += ((p[0] >> 5) & 0x07)
+					| ((unsigned long)p[1] << 3)
+					| ((unsigned long)p[2] << 11)
+					| ((unsigned long)p[3] << 19);
+	    ++cursor->last.when;
+	}
+	break;
+    }
+    cursor->pos = p + valuesize[*p];
+    *move = cursor->last;
+    return +1;
+}
+
+/* Count the moves in the solution data by stepping from the first
+ * byte of each value to the next, without decoding them.
+ */
+int countsolutionmoves(gamesetup const *game)
+{
+    unsigned char const	       *p;
+    unsigned char const	       *dataend;
+    int				count = 0;
+
+    if (game->solutionsize <= 16)
+	return 0;
     p = game->solutiondata + 16;
     dataend = game->solutiondata + game->solutionsize;
     while (p < dataend) {
-	switch (*p & 0x03) {
-	  case 0:
-	    act.dir = indextodir((*p >> 2) & 0x03);
-	    act.when += 4;
-	    addtomovelist(&solution->moves, act);
-	    act.dir = indextodir((*p >> 4) & 0x03);
-	    act.when += 4;
-	    addtomovelist(&solution->moves, act);
-	    act.dir = indextodir((*p >> 6) & 0x03);
-	    act.when += 4;
-	    addtomovelist(&solution->moves, act);
-	    ++p;
-	    break;
-	  case 1:
-	    act.dir = indextodir((*p >> 2) & 0x07);
-	    act.when += ((*p >> 5) & 0x07) + 1;
-	    addtomovelist(&solution->moves, act);
-	    ++p;
-	    break;
-	  case 2:
-	    if (p + 2 > dataend)
-		goto truncated;
-	    act.dir = indextodir((*p >> 2) & 0x07);
-	    act.when += ((p[0] >> 5) & 0x07) + ((unsigned long)p[1] << 3) + 1;
-	    addtomovelist(&solution->moves, act);
-	    p += 2;
-	    break;
-	  case 3:
-	    if (*p & 0x10) {
-		n = (*p >> 2) & 0x03;
-		if (p + 2 + n > dataend)
-		    goto truncated;
-		act.dir = ((p[0] >> 5) & 0x07) | ((p[1] & 0x3F) << 3);
-		act.when += (p[1] >> 6) & 0x03;
-		while (n--)
-		    act.when += (unsigned long)p[2 + n] << (2 + n * 8);
-		++act.when;
-		p += 2 + ((*p >> 2) & 0x03);
-	    } else {
-		if (p + 4 > dataend)
-		    goto truncated;
-		act.dir = indextodir((*p >> 2) & 0x03);
-		act.when += ((p[0] >> 5) & 0x07) | ((unsigned long)p[1] << 3)
-						 | ((unsigned long)p[2] << 11)
-						 | ((unsigned long)p[3] << 19);
-		++act.when;
-		p += 4;
-	    }
-	    addtomovelist(&solution->moves, act);
-	    break;
-	}
+	count += valuemoves(*p);
+	p += valuesize[*p];
     }
-    return TRUE;
+    return p == dataend ? count : -1;
+}
+
+/* Expand a level's solution data into an actual list of moves. The
+ * moves are counted first, so that the list can be allocated once and
+ * filled in directly.
+ */
+int expandsolution(solutioninfo *solution, gamesetup const *game)
+{
+    solutioncursor	cursor;
+    action	       *move;
+    int			count;
+
+    if (!opensolution(&cursor, solution, game))
+	return FALSE;
 
-  truncated:
-    errmsg(NULL, "level %d: truncated solution data", game->number);
     initmovelist(&solution->moves);
-    return FALSE;
+    count = countsolutionmoves(game);
+    if (count < 0) {
+	errmsg(NULL, "level %d: truncated solution data", game->number);
+	return FALSE;
+    }
+    if (solution->moves.allocated < count) {
+	solution->moves.allocated = count;
+	xalloc(solution->moves.list, count * sizeof *solution->moves.list);
+    }
+    move = solution->moves.list;
+    while (nextsolutionmove(&cursor, move) > 0)
+	++move;
+    solution->moves.count = count;
+    return TRUE;
 }
 
 /* Take the given solution and compress it, storing the compressed
- * data as part of the level's setup.
+ * data as part of the level's setup. The buffer is allocated to hold
+ * the largest possible encoding (five bytes per move), so that the
+ * moves can be compressed in a single pass, and is then trimmed to
+ * the size actually used.
  */
 int contractsolution(solutioninfo const *solution, gamesetup *game)
 {
@@ -382,16 +491,11 @@ int contractsolution(solutioninfo const *solution, gamesetup *game)
     free(game->solutiondata);
     game->solutionsize = 0;
     game->solutiondata = NULL;
+    game->sgflags |= SGF_UNSAVED;
     if (!solution->moves.count)
 	return TRUE;
 
-    size = 21;
-    move = solution->moves.list + 1;
-    for (i = 1 ; i < solution->moves.count ; ++i, ++move)
-	size += !isorthogonal(move->dir) ? 5
-			: move[0].when - move[-1].when <= (1 << 3) ? 1
-			: move[0].when - move[-1].when <= (1 << 11) ? 2 : 4;
-    data = malloc(size);
+    data = malloc(16 + 5 * solution->moves.count);
     if (!data) {
 	errmsg(NULL, "failed to record level %d solution:"
 		     " out of memory", game->number);
@@ -556,31 +660,42 @@ static int writesolution(fileinfo *file, gamesetup const *game)
  * File I/O for solution files.
  */
 
+/* Return the name of the solution file for the given data file. If
+ * the name is not already set, it is derived from the data file's
+ * name, and the returned buffer must be freed by the caller.
+ */
+static char const *solutionfilename(fileinfo const *file, char const *datname,
+				    char **buf)
+{
+    int	n;
+
+    *buf = NULL;
+    if (file->name)
+	return file->name;
+    n = strlen(datname);
+    if (datname[n - 4] == '.' && tolower(datname[n - 3]) == 'd'
+			      && tolower(datname[n - 2]) == 'a'
+			      && tolower(datname[n - 1]) == 't')
+	n -= 4;
+    xalloc(*buf, n + 5);
+    memcpy(*buf, datname, n);
+    memcpy(*buf + n, ".tws", 5);
+    return *buf;
+}
+
 /* Locate the solution file for the given data file and open it.
  */
 static int opensolutionfile(fileinfo *file, char const *datname, int mode)
 {
     static int	savedirchecked = FALSE;
-    char       *buf = NULL;
+    char       *buf;
     char const *filename;
     int		n;
 
     if (mode != F_READ && readonly)
 	return FALSE;
 
-    if (file->name) {
-	filename = file->name;
-    } else {
-	n = strlen(datname);
-	if (datname[n - 4] == '.' && tolower(datname[n - 3]) == 'd'
-				  && tolower(datname[n - 2]) == 'a'
-				  && tolower(datname[n - 1]) == 't')
-	    n -= 4;
-	xalloc(buf, n + 5);
-	memcpy(buf, datname, n);
-	memcpy(buf + n, ".tws", 5);
-	filename = buf;
-    }
+    filename = solutionfilename(file, datname, &buf);
 
     if (mode != F_WRITE) {
 	if (!savedirchecked && savedir && *savedir && !haspathname(filename)) {
@@ -607,6 +722,7 @@ int readsolutions(gameseries *series)
     gamesetup	gametmp;
     int		n;
 
+    series->solappended = -1;
     if (!series->savefile.name)
 	series->savefile.name = series->savefilename;
     if ((!series->savefile.name && (series->gsflags & GSF_NODEFAULTSAVE))
@@ -625,10 +741,15 @@ int readsolutions(gameseries *series)
 	return FALSE;
     }
 
+    series->solappended = 0;
     memset(&gametmp, 0, sizeof gametmp);
     for (;;) {
-	if (!readsolution(&series->savefile, &gametmp))
+	if (filetestend(&series->savefile))
+	    break;
+	if (!readsolution(&series->savefile, &gametmp)) {
+	    series->solappended = -1;
 	    break;
+	}
 	if (gametmp.sgflags & SGF_SETNAME) {
 	    if (strcmp(gametmp.name, series->name)) {
 		errmsg(series->name, "ignoring solution file %s as it was"
@@ -650,6 +771,11 @@ int readsolutions(gameseries *series)
 	    warn("level %d has been moved to level %d",
 		 gametmp.number, series->games[n].number);
 	}
+	if (series->games[n].sgflags & SGF_HASPASSWD) {
+	    free(series->games[n].solutiondata);
+	    if (series->solappended >= 0)
+		++series->solappended;
+	}
 	series->games[n].besttime = gametmp.besttime;
 	series->games[n].sgflags = gametmp.sgflags;
 	series->games[n].solutionsize = gametmp.solutionsize;
@@ -660,13 +786,109 @@ int readsolutions(gameseries *series)
     return TRUE;
 }
 
-/* Write out all the solutions for the given series.
+/* Append the solutions that have changed since the solution file was
+ * last written to the end of the file, and update the current level
+ * number in the header. FALSE is returned if the file needs to be
+ * rewritten instead.
  */
-int savesolutions(gameseries *series)
+static int appendsolutions(gameseries *series)
 {
     gamesetup  *game;
-    int		i;
+    int		i, n;
+
+    if (series->solappended < 0)
+	return FALSE;
+    n = 0;
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	if (!(game->sgflags & SGF_UNSAVED))
+	    continue;
+	if (!game->solutionsize && !(game->sgflags & SGF_HASPASSWD))
+	    return FALSE;
+	++n;
+    }
+    if (series->solappended + n > maxappended(series))
+	return FALSE;
 
+    if (!opensolutionfile(&series->savefile, series->filebase, F_MODIFY))
+	return FALSE;
+    if (!fileskip(&series->savefile, 5, NULL)
+	    || !filewriteint16(&series->savefile, series->currentlevel, NULL)
+	    || !fileseekend(&series->savefile, NULL)) {
+	fileclose(&series->savefile, NULL);
+	return FALSE;
+    }
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	if (!(game->sgflags & SGF_UNSAVED))
+	    continue;
+	if (!writesolution(&series->savefile, game)) {
+	    fileclose(&series->savefile, NULL);
+	    series->solappended = -1;
+	    return FALSE;
+	}
+	game->sgflags &= ~SGF_UNSAVED;
+    }
+    fileclose(&series->savefile, NULL);
+    series->solappended += n;
+    return TRUE;
+}
+
+/* Write out all the solutions for the given series to a new file, and
+ * then put it in place of the old one, so that a failure partway
+ * through leaves the old file intact.
+ */
+static int rewritesolutions(gameseries *series)
+{
+    fileinfo	file;
+    gamesetup  *game;
+    char       *buf;
+    char       *path;
+    char       *tmpname;
+    int		f, i;
+
+    path = getpathforfileindir(savedir,
+			       solutionfilename(&series->savefile,
+						series->filebase, &buf));
+    free(buf);
+    if (!path)
+	return fileerr(&series->savefile, "can't access file");
+    tmpname = NULL;
+    xalloc(tmpname, strlen(path) + 5);
+    sprintf(tmpname, "%s.tmp", path);
+
+    clearfileinfo(&file);
+    f = fileopen(&file, tmpname, "wb", "can't access file");
+    if (f) {
+	f = writesolutionheader(&file, series->ruleset, series->currentlevel,
+				series->solheadersize, series->solheader)
+	    && writesolutionsetname(&file, series->name);
+	for (i = 0, game = series->games ; f && i < series->count ;
+	     ++i, ++game)
+	    f = writesolution(&file, game);
+	if (f) {
+	    f = filereplace(&file, path, "can't save solutions");
+	} else {
+	    fileclose(&file, NULL);
+	    remove(tmpname);
+	}
+    }
+    free(tmpname);
+    free(path);
+    if (!f)
+	return FALSE;
+
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game)
+	game->sgflags &= ~SGF_UNSAVED;
+    series->solappended = 0;
+    return TRUE;
+}
+
+/* Save the solutions for the given series. Normally the solutions that
+ * have changed are simply appended to the solution file. The entire
+ * file is rewritten if it doesn't exist yet, if it has accumulated too
+ * many outdated solutions, or if appending fails.
+ */
+int savesolutions(gameseries *series)
+{
     if (readonly || (series->gsflags & GSF_NOSAVING))
 	return TRUE;
 
@@ -676,25 +898,10 @@ int savesolutions(gameseries *series)
 	series->savefile.name = series->savefilename;
     if (!series->savefile.name && (series->gsflags & GSF_NODEFAULTSAVE))
 	return TRUE;
-    if (!opensolutionfile(&series->savefile, series->filebase, F_WRITE))
-	return FALSE;
-
-    if (!writesolutionheader(&series->savefile, series->ruleset,
-			     series->currentlevel,
-			     series->solheadersize, series->solheader))
-	return fileerr(&series->savefile,
-		       "saved-game file has become corrupted!");
-    if (!writesolutionsetname(&series->savefile, series->name))
-	return fileerr(&series->savefile,
-		       "saved-game file has become corrupted!");
-    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
-	if (!writesolution(&series->savefile, game))
-	    return fileerr(&series->savefile,
-			   "saved-game file has become corrupted!");
-    }
 
-    fileclose(&series->savefile, NULL);
-    return TRUE;
+    if (appendsolutions(series))
+	return TRUE;
+    return rewritesolutions(series);
 }
 
 /* Write out just the current level number to the existing solution
@@ -734,6 +941,7 @@ void clearsolutions(gameseries *series)
 	game->solutiondata = NULL;
     }
     series->solheadersize = 0;
+    series->solappended = -1;
     series->currentlevel = 0;
     fileclose(&series->savefile, NULL);
     clearfileinfo(&series->savefile);
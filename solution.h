@@ -19,6 +19,20 @@ extern void setsavedir(char const *dir);
  */
 extern void setreadonly(void);
 
+/* Return TRUE if file modification has been prohibited.
+ */
+extern int isreadonly(void);
+
+/* The cache files kept in the save directory are not affected by
+ * read-only mode, since they hold no solutions. They are only left
+ * untouched after this function is called.
+ */
+extern void setcachereadonly(void);
+
+/* Return TRUE if the cache files may not be updated.
+ */
+extern int iscachereadonly(void);
+
 /* Initialize or reinitialize list as empty.
  */
 extern void initmovelist(actlist *list);
@@ -35,6 +49,35 @@ extern void copymovelist(actlist *to, actlist const *from);
  */
 extern void destroymovelist(actlist *list);
 
+/* A position within a level's solution data, from which the moves
+ * can be read one at a time without expanding the whole list.
+ */
+typedef	struct solutioncursor {
+    unsigned char const	       *pos;		/* the next byte to decode */
+    unsigned char const	       *end;		/* the end of the data */
+    action			last;		/* the move last returned */
+    unsigned char		packed;		/* moves left from a byte */
+    unsigned char		packedcount;	/* number of packed moves */
+} solutioncursor;
+
+/* Read the header of a level's solution data into solution, leaving
+ * its move list untouched, and set cursor to the first move. FALSE is
+ * returned if the solution is absent.
+ */
+extern int opensolution(solutioncursor *cursor, solutioninfo *solution,
+			gamesetup const *game);
+
+/* Decode the next move of a solution into move. The return value is
+ * positive if a move was read, zero at the end of the solution, and
+ * negative if the data is truncated.
+ */
+extern int nextsolutionmove(solutioncursor *cursor, action *move);
+
+/* Return the number of moves in a level's solution, or -1 if the
+ * solution data is truncated.
+ */
+extern int countsolutionmoves(gamesetup const *game);
+
 /* Expand a level's solution data into the actual solution, including
  * the full list of moves. FALSE is returned if the solution is
  * invalid or absent.
@@ -56,7 +99,9 @@ extern int readsolutions(gameseries *series);
 /* Write out all the solutions for the given series. The solution file
  * is created if it does not currently exist. The solution file's
  * directory is also created if it does not currently exist. (Nothing
- * is done if the directory's name has been unset, however.) FALSE is
+ * is done if the directory's name has been unset, however.) Only the
+ * levels marked with SGF_UNSAVED are written if the file can be
+ * appended to; otherwise the file is replaced as a whole. FALSE is
  * returned if an error occurs.
  */
 extern int savesolutions(gameseries *series);
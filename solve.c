@@ -0,0 +1,532 @@
+/* solve.c: Searching for solutions to levels automatically.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdlib.h>
+#include	<string.h>
+#include	<pthread.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"play.h"
+#include	"hash.h"
+#include	"solve.h"
+
+/* The moves that are tried at every turn, in the order that they are
+ * preferred when two solutions are equally quick.
+ */
+static int const solvecmds[] = { NIL, NORTH, WEST, SOUTH, EAST };
+
+#define	SOLVE_CMDS	((int)(sizeof solvecmds / sizeof *solvecmds))
+
+/* Returned by expandlayer() when the search is to continue.
+ */
+#define	Solve_Continue	(-1)
+
+/* How a position was first reached. The positions are numbered in
+ * the order that they are found, and the starting position is number
+ * zero.
+ */
+typedef	struct solvenode {
+    int			parent;		/* the position moved from */
+    int			cmd;		/* the move made */
+} solvenode;
+
+/* A position that is to be expanded. In the frontier, from is the
+ * position's own number. In the list of positions that a worker
+ * found, it is the index of the frontier entry that was expanded, and
+ * cmd is the index into solvecmds of the move that was made.
+ */
+typedef	struct solvestate {
+    statehash		key;		/* identifies the position */
+    int			from;		/* see above */
+    int			cmd;		/* see above */
+    int			size;		/* the size of the snapshot */
+    unsigned char      *snap;		/* the game, as of this position */
+} solvestate;
+
+/* A growable list of positions.
+ */
+typedef	struct statelist {
+    solvestate	       *list;		/* the positions */
+    int			count;		/* the number of positions */
+    int			allocated;	/* the size of the array */
+    long		memory;		/* the total size of the snapshots */
+} statelist;
+
+/* The share of one layer of the search given to one worker. The
+ * workers only read the frontier and the table of positions already
+ * seen, so they need no locking. Anything that they find is added to
+ * the search by the main thread once all of them are done.
+ */
+typedef	struct solveworker {
+    struct solvesearch *search;		/* the search being done */
+    gameplay	       *gp;		/* the worker's own game */
+    pthread_t		thread;		/* the worker's thread */
+    int			first;		/* the first entry to expand */
+    int			end;		/* one past the last entry to expand */
+    long		budget;		/* the most memory found may use */
+    statelist		found;		/* the new positions found */
+    int			wintick;	/* the length of the quickest win */
+    int			winfrom;	/* the frontier entry it came from */
+    int			wincmd;		/* the index of its last move */
+    int			overflow;	/* TRUE if the budget ran out */
+    int			pruned;		/* TRUE if the tick limit was hit */
+    int			failed;		/* TRUE if a snapshot was rejected */
+} solveworker;
+
+/* The data for one whole search.
+ */
+typedef	struct solvesearch {
+    solveparams const  *params;		/* the limits of the search */
+    solveworker	       *workers;	/* one worker for each thread */
+    statelist		frontier;	/* the positions to expand next */
+    solvenode	       *nodes;		/* every position found so far */
+    int			nodecount;	/* the number of positions */
+    int			nodesallocated;	/* the size of the nodes array */
+    statehash	       *seen;		/* a hash table of the positions */
+    int			seensize;	/* the size of the table */
+    int			pruned;		/* TRUE if the tick limit was hit */
+} solvesearch;
+
+/*
+ * Keeping track of positions.
+ */
+
+/* Return the key that identifies the position of the current game.
+ * The state hash leaves out the tick count, but the creatures do not
+ * all move on every tick, so its low bits are folded in. Zero marks
+ * an empty slot in the table, and so is never used as a key.
+ */
+static statehash positionkey(void)
+{
+    statehash	key;
+
+    key = hashvalue(gamestatehash(), ticksplayed() & 7);
+    return key ? key : 1;
+}
+
+/* Return the slot of the table where the given key is, or where it
+ * would go.
+ */
+static int findseen(statehash const *seen, int size, statehash key)
+{
+    int	n;
+
+    n = (int)((key ^ (key >> 32)) & (size - 1));
+    while (seen[n] && seen[n] != key)
+	n = (n + 1) & (size - 1);
+    return n;
+}
+
+/* Add a key to the table of positions already seen. The table is
+ * kept no more than half full. FALSE is returned if the key was
+ * already present.
+ */
+static int addseen(solvesearch *search, statehash key)
+{
+    statehash  *seen;
+    int		size, i, n;
+
+    if (2 * (search->nodecount + 1) > search->seensize) {
+	size = search->seensize ? 2 * search->seensize : 4096;
+	seen = calloc(size, sizeof *seen);
+	if (!seen)
+	    memerrexit();
+	for (i = 0 ; i < search->seensize ; ++i)
+	    if (search->seen[i])
+		seen[findseen(seen, size, search->seen[i])] = search->seen[i];
+	free(search->seen);
+	search->seen = seen;
+	search->seensize = size;
+    }
+    n = findseen(search->seen, search->seensize, key);
+    if (search->seen[n])
+	return FALSE;
+    search->seen[n] = key;
+    return TRUE;
+}
+
+/* Record how a new position was reached, and return its number.
+ */
+static int addnode(solvesearch *search, int parent, int cmd)
+{
+    solvenode  *nodes;
+    int		n;
+
+    if (search->nodecount >= search->nodesallocated) {
+	n = search->nodesallocated ? 2 * search->nodesallocated : 4096;
+	nodes = realloc(search->nodes, n * sizeof *nodes);
+	if (!nodes)
+	    memerrexit();
+	search->nodes = nodes;
+	search->nodesallocated = n;
+    }
+    search->nodes[search->nodecount].parent = parent;
+    search->nodes[search->nodecount].cmd = cmd;
+    return search->nodecount++;
+}
+
+/* Append a position to a list.
+ */
+static void addstate(statelist *list, solvestate const *pos)
+{
+    solvestate *p;
+    int		n;
+
+    if (list->count >= list->allocated) {
+	n = list->allocated ? 2 * list->allocated : 256;
+	p = realloc(list->list, n * sizeof *p);
+	if (!p)
+	    memerrexit();
+	list->list = p;
+	list->allocated = n;
+    }
+    list->list[list->count++] = *pos;
+    list->memory += pos->size;
+}
+
+/* Free the snapshots in a list and empty it.
+ */
+static void clearstates(statelist *list)
+{
+    int	n;
+
+    for (n = 0 ; n < list->count ; ++n)
+	free(list->list[n].snap);
+    list->count = 0;
+    list->memory = 0;
+}
+
+/* Return the memory that the search is using outside of the workers.
+ */
+static long searchmemory(solvesearch const *search)
+{
+    return search->frontier.memory
+	 + search->frontier.allocated * (long)sizeof(solvestate)
+	 + search->nodesallocated * (long)sizeof(solvenode)
+	 + search->seensize * (long)sizeof(statehash);
+}
+
+/*
+ * Expanding the search.
+ */
+
+/* Try every move from the worker's share of the frontier, in the
+ * worker's own game. Wins are noted, and positions not seen in an
+ * earlier layer are kept until the budget runs out. Once a win has
+ * been found, the layer will be the last one, so new positions are no
+ * longer kept.
+ */
+static void expandrange(solveworker *worker)
+{
+    solvesearch const  *search = worker->search;
+    solvestate const   *from;
+    solvestate		pos;
+    int			i, j, n, t, f;
+
+    for (i = worker->first ; i < worker->end ; ++i) {
+	from = search->frontier.list + i;
+	for (j = 0 ; j < SOLVE_CMDS ; ++j) {
+	    if (!branchgamestate(from->snap, from->size)) {
+		worker->failed = TRUE;
+		return;
+	    }
+	    f = 0;
+	    for (t = 0 ; t < search->params->step && !f ; ++t)
+		f = doturn(solvecmds[j]);
+	    n = ticksplayed();
+	    if (f > 0) {
+		if (worker->wintick < 0 || n < worker->wintick) {
+		    worker->wintick = n;
+		    worker->winfrom = i;
+		    worker->wincmd = j;
+		}
+		continue;
+	    }
+	    if (f < 0 || worker->wintick >= 0)
+		continue;
+	    if (search->params->maxticks && n >= search->params->maxticks) {
+		worker->pruned = TRUE;
+		continue;
+	    }
+	    pos.key = positionkey();
+	    if (search->seen[findseen(search->seen, search->seensize,
+				      pos.key)])
+		continue;
+	    pos.size = snapshotgamestate(NULL, 0);
+	    if (worker->found.memory + pos.size + (long)sizeof pos
+				> worker->budget) {
+		worker->overflow = TRUE;
+		return;
+	    }
+	    pos.snap = malloc(pos.size);
+	    if (!pos.snap)
+		memerrexit();
+	    snapshotgamestate(pos.snap, pos.size);
+	    pos.from = i;
+	    pos.cmd = j;
+	    addstate(&worker->found, &pos);
+	}
+    }
+}
+
+/* The body of a worker thread.
+ */
+static void *solvethread(void *data)
+{
+    solveworker	       *worker = data;
+    gameplay	       *prev;
+
+    prev = selectgameplay(worker->gp);
+    expandrange(worker);
+    selectgameplay(prev);
+    return NULL;
+}
+
+/* Expand every position in the frontier, dividing the frontier among
+ * the workers. The workers' findings are then gathered in order, so
+ * that the outcome does not depend upon how many threads were used.
+ * If a win was found, the quickest one is stored in the first worker.
+ */
+static int expandlayer(solvesearch *search, solveresult *result)
+{
+    solveworker	       *worker;
+    solvestate	       *pos;
+    statelist		next;
+    long		avail, used;
+    int			jobs, started, outcome;
+    int			i, n;
+
+    jobs = search->params->jobs;
+    if (jobs > search->frontier.count)
+	jobs = search->frontier.count;
+    avail = search->params->budget - searchmemory(search);
+    if (avail <= 0)
+	return Solve_OutOfMemory;
+
+    for (i = 0, worker = search->workers ; i < jobs ; ++i, ++worker) {
+	worker->first = (search->frontier.count * i) / jobs;
+	worker->end = (search->frontier.count * (i + 1)) / jobs;
+	worker->budget = avail / jobs;
+	worker->wintick = -1;
+	worker->overflow = FALSE;
+	worker->pruned = FALSE;
+	worker->failed = FALSE;
+    }
+    for (started = 1 ; started < jobs ; ++started)
+	if (pthread_create(&search->workers[started].thread, NULL,
+			   solvethread, search->workers + started))
+	    break;
+    solvethread(search->workers);
+    for (i = 1 ; i < started ; ++i)
+	pthread_join(search->workers[i].thread, NULL);
+    for (i = started ; i < jobs ; ++i)
+	solvethread(search->workers + i);
+
+    outcome = Solve_Continue;
+    used = 0;
+    for (i = 0, worker = search->workers ; i < jobs ; ++i, ++worker) {
+	used += worker->found.memory
+	      + worker->found.allocated * (long)sizeof(solvestate);
+	if (worker->pruned)
+	    search->pruned = TRUE;
+	if (worker->failed)
+	    outcome = Solve_Failed;
+	else if (worker->overflow && outcome == Solve_Continue)
+	    outcome = Solve_OutOfMemory;
+	if (worker->wintick >= 0 && (search->workers->wintick < 0
+			|| worker->wintick < search->workers->wintick)) {
+	    search->workers->wintick = worker->wintick;
+	    search->workers->winfrom = worker->winfrom;
+	    search->workers->wincmd = worker->wincmd;
+	}
+    }
+    used += searchmemory(search);
+    if (result->memory < used)
+	result->memory = used;
+    if (search->workers->wintick >= 0)
+	outcome = Solve_Solved;
+    if (outcome != Solve_Continue) {
+	for (i = 0 ; i < jobs ; ++i)
+	    clearstates(&search->workers[i].found);
+	return outcome;
+    }
+
+    memset(&next, 0, sizeof next);
+    for (i = 0, worker = search->workers ; i < jobs ; ++i, ++worker) {
+	for (n = 0, pos = worker->found.list ; n < worker->found.count
+					       ; ++n, ++pos) {
+	    if (!addseen(search, pos->key)) {
+		free(pos->snap);
+		continue;
+	    }
+	    pos->from = addnode(search, search->frontier.list[pos->from].from,
+				solvecmds[pos->cmd]);
+	    addstate(&next, pos);
+	}
+	worker->found.count = 0;
+	worker->found.memory = 0;
+    }
+    clearstates(&search->frontier);
+    free(search->frontier.list);
+    search->frontier = next;
+    return Solve_Continue;
+}
+
+/*
+ * Running a search.
+ */
+
+/* Play the route that ends with the given position and move from the
+ * starting position in the current game, so that its moves are
+ * recorded, and replace the user's solution with it. FALSE is
+ * returned if the route does not actually win.
+ */
+static int playroute(solvesearch const *search, gamesetup *game, int ruleset,
+		     int node, int cmd)
+{
+    int	       *route;
+    int		count, i, n, f;
+
+    count = 0;
+    for (n = node ; n > 0 ; n = search->nodes[n].parent)
+	++count;
+    route = malloc((count + 1) * sizeof *route);
+    if (!route)
+	memerrexit();
+    route[count] = cmd;
+    for (n = node, i = count ; n > 0 ; n = search->nodes[n].parent)
+	route[--i] = search->nodes[n].cmd;
+
+    f = 0;
+    if (initgamestate(game, ruleset, FALSE)) {
+	seedgamestate(game->number);
+	setgameplaymode(BeginVerify);
+	for (i = 0 ; i <= count && !f ; ++i)
+	    for (n = 0 ; n < search->params->step && !f ; ++n)
+		f = doturn(route[i]);
+	setgameplaymode(EndVerify);
+	if (f > 0)
+	    replacesolution();
+    }
+    endgamestate();
+    free(route);
+    return f > 0;
+}
+
+/* Set up the workers' games and the starting position. The main
+ * PRNG is seeded with the level number, so that a search can be
+ * repeated exactly.
+ */
+static int startsearch(solvesearch *search, gamesetup *game, int ruleset)
+{
+    solveworker	       *worker;
+    gameplay	       *prev;
+    solvestate		pos;
+    int			i;
+
+    search->workers = calloc(search->params->jobs, sizeof *search->workers);
+    if (!search->workers)
+	memerrexit();
+    for (i = 0, worker = search->workers ; i < search->params->jobs
+					   ; ++i, ++worker) {
+	worker->search = search;
+	worker->gp = creategameplay();
+	prev = selectgameplay(worker->gp);
+	if (!initgamestate(game, ruleset, FALSE)) {
+	    selectgameplay(prev);
+	    return FALSE;
+	}
+	setgameplaymode(BeginVerify);
+	selectgameplay(prev);
+    }
+
+    if (!initgamestate(game, ruleset, FALSE))
+	return FALSE;
+    seedgamestate(game->number);
+    pos.size = snapshotgamestate(NULL, 0);
+    pos.snap = malloc(pos.size);
+    if (!pos.snap)
+	memerrexit();
+    snapshotgamestate(pos.snap, pos.size);
+    pos.key = positionkey();
+    pos.from = addnode(search, -1, NIL);
+    pos.cmd = 0;
+    addseen(search, pos.key);
+    addstate(&search->frontier, &pos);
+    endgamestate();
+    return TRUE;
+}
+
+/* Free everything that the search allocated.
+ */
+static void endsearch(solvesearch *search)
+{
+    gameplay   *prev;
+    int		i;
+
+    if (search->workers) {
+	for (i = 0 ; i < search->params->jobs ; ++i) {
+	    if (!search->workers[i].gp)
+		continue;
+	    prev = selectgameplay(search->workers[i].gp);
+	    endgamestate();
+	    selectgameplay(prev);
+	    destroygameplay(search->workers[i].gp);
+	    clearstates(&search->workers[i].found);
+	    free(search->workers[i].found.list);
+	}
+	free(search->workers);
+    }
+    clearstates(&search->frontier);
+    free(search->frontier.list);
+    free(search->nodes);
+    free(search->seen);
+}
+
+/* Search for the quickest solution to a level, one layer of turns at
+ * a time.
+ */
+int solvelevel(gamesetup *game, int ruleset,
+	       solveparams const *params, solveresult *result)
+{
+    solvesearch	search;
+    solveworker *win;
+    int		outcome;
+
+    memset(result, 0, sizeof *result);
+    result->ticks = -1;
+    memset(&search, 0, sizeof search);
+    search.params = params;
+
+    if (!startsearch(&search, game, ruleset)) {
+	outcome = Solve_Failed;
+    } else {
+	do {
+	    if (!search.frontier.count)
+		outcome = search.pruned ? Solve_TooLong : Solve_Unsolvable;
+	    else
+		outcome = expandlayer(&search, result);
+	} while (outcome == Solve_Continue);
+    }
+
+    result->states = search.nodecount;
+    if (outcome == Solve_Solved) {
+	win = search.workers;
+	if (playroute(&search, game, ruleset,
+		      search.frontier.list[win->winfrom].from,
+		      solvecmds[win->wincmd])) {
+	    result->ticks = win->wintick;
+	} else {
+	    errmsg(NULL, "level %d: the solution found could not be replayed",
+		   game->number);
+	    outcome = Solve_Failed;
+	}
+    }
+
+    endsearch(&search);
+    result->outcome = outcome;
+    return outcome;
+}
@@ -0,0 +1,57 @@
+/* solve.h: Searching for solutions to levels automatically.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#ifndef	_solve_h_
+#define	_solve_h_
+
+#include	"defs.h"
+
+/* The most threads that a search will use.
+ */
+#define	MAX_SOLVE_JOBS		64
+
+/* The ways in which a search can end.
+ */
+enum {
+    Solve_Solved,		/* a solution was found */
+    Solve_Unsolvable,		/* every reachable position was tried */
+    Solve_TooLong,		/* no solution within the tick limit */
+    Solve_OutOfMemory,		/* the memory budget was used up */
+    Solve_Failed		/* the level could not be played */
+};
+
+/* The limits placed upon a search.
+ */
+typedef	struct solveparams {
+    int		jobs;		/* the number of threads to search with */
+    int		step;		/* the number of ticks each move is held */
+    int		maxticks;	/* the longest solution wanted, or zero */
+    long	budget;		/* the most memory to use, in bytes */
+} solveparams;
+
+/* What a search found, and what it cost.
+ */
+typedef	struct solveresult {
+    int		outcome;	/* one of the Solve_ values */
+    int		ticks;		/* the length of the solution, if found */
+    long	states;		/* the number of distinct positions seen */
+    long	memory;		/* the most memory in use at once */
+} solveresult;
+
+/* Search for the quickest solution to the given level, in the
+ * currently selected game. The search goes breadth-first from the
+ * starting position, trying every direction (or none) at every turn,
+ * with each move held for step ticks, so the solution found is the
+ * quickest one that makes its moves on those ticks. Positions that
+ * have already been seen are not searched again. If a solution is
+ * found, it replaces the user's solution for the level if it is
+ * faster. The outcome of the search is returned, and is also stored
+ * in result along with the search's statistics.
+ */
+extern int solvelevel(gamesetup *game, int ruleset,
+		      solveparams const *params, solveresult *result);
+
+#endif
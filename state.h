@@ -194,7 +194,9 @@ typedef struct creature {
 
 /* Ideally, everything that the gameplay module, the display module,
  * and both logic modules need to know about a game in progress is
- * in here.
+ * in here. The fields from trapcount through map are filled in from
+ * the level data, and encoding.c copies them as a single block, so
+ * they must be kept together.
  */
 typedef struct gamestate {
     gamesetup	       *game;			/* the level specification */
@@ -225,6 +227,8 @@ typedef struct gamestate {
     short		crlist[256];		/* list of creatures */
     char		hinttext[256];		/* text of the hint */
     mapcell		map[CXGRID * CYGRID];	/* the game's map */
+    statehash		maphash;		/* hash of the map alone */
+    statehash		hash;			/* hash of the whole state */
     void	       *localstateinfo;		/* rule-specific state data */
 } gamestate;
 
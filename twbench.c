@@ -0,0 +1,444 @@
+/* twbench.c: Measuring the speed of the game logic.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* This program plays every level in a level set for a fixed number of
+ * ticks, using a stream of moves generated from a fixed seed, and then
+ * plays back every solution that the user has for the level set. It
+ * reports how long the game logic took, along with a hash of the
+ * final state of every game, so that the output of two builds can be
+ * compared line by line. Like twverify, it is linked with the null
+ * OS/hardware layer, and it never modifies the solution file.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#if defined __unix__ || defined __APPLE__
+#include	<sys/resource.h>
+#endif
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"series.h"
+#include	"solution.h"
+#include	"play.h"
+#include	"encoding.h"
+#include	"random.h"
+#include	"hash.h"
+#include	"cmdline.h"
+#include	"ver.h"
+
+/* The online help.
+ */
+static char const *usage =
+    "Usage: twbench [OPTIONS] LEVELSET [SOLUTIONFILE]\n"
+    "Play every level in a level set for a fixed number of ticks, and\n"
+    "play back the user's solutions, and report the time taken.\n"
+    "\n"
+    "  -D, --data-dir=DIR      Read data files from DIR\n"
+    "  -L, --levelset-dir=DIR  Read level sets from DIR\n"
+    "  -S, --save-dir=DIR      Read solution files from DIR\n"
+    "  -t, --ticks=N           Play each level for N ticks (default 2000)\n"
+    "  -r, --seed=N            Generate the moves from seed N (default 1)\n"
+    "  -R, --ruleset=RULES     Play under RULES (ms or lynx) instead of\n"
+    "                          the level set's own ruleset\n"
+    "  -P, --pedantic          Use pedantic Lynx rules\n"
+    "  -h, --help              Display this help and exit\n"
+    "  -v, --version           Display the version and exit\n"
+    "\n"
+    "One line is output for the generated moves and one for the\n"
+    "solutions. The peak memory is that of the whole program, so only\n"
+    "one level set is measured per run.\n";
+
+/* The exit status used when nothing could be measured.
+ */
+#define	EXIT_CANNOTBENCH	101
+
+/* The values that the user can set on the command line.
+ */
+typedef	struct benchdata {
+    char       *filename;	/* the level set */
+    char       *savefilename;	/* the solution file, if given */
+    char const *seriesdir;	/* the level set directory (-L) */
+    char const *seriesdatdir;	/* the data file directory (-D) */
+    char const *savedir;	/* the solution file directory (-S) */
+    int		ticks;		/* the number of ticks to play each level */
+    int		seed;		/* the seed for the generated moves */
+    int		ruleset;	/* the ruleset to use, if overridden */
+    int		pedantic;	/* TRUE for pedantic Lynx rules */
+} benchdata;
+
+/* The measurements taken over one pass through the level set.
+ */
+typedef	struct benchresult {
+    int		levels;		/* the number of levels played */
+    int		solved;		/* the number of games won */
+    long	ticks;		/* the number of ticks played */
+    clock_t	elapsed;	/* the processor time used */
+    statehash	hash;		/* the combined final game states */
+    unsigned long cachehits;	/* levels started from the level cache */
+    unsigned long cachemisses;	/* levels that had to be decoded */
+} benchresult;
+
+/* Allocate and assemble a directory path based on a root location, a
+ * default subdirectory name, and an optional override value.
+ */
+static char const *choosepath(char const *root, char const *dirname,
+			      char const *override)
+{
+    char       *dir;
+
+    dir = getpathbuffer();
+    if (override && *override)
+	strcpy(dir, override);
+    else
+	combinepath(dir, root, dirname);
+    return dir;
+}
+
+/* Set the directories used for finding level sets and solution files,
+ * using the same defaults as the main program.
+ */
+static void initdirs(benchdata const *data)
+{
+    char const *root;
+    char const *dir;
+    char const *save = data->savedir;
+
+    if (!save && (dir = getenv("TWORLDSAVEDIR")) && *dir)
+	save = dir;
+    if (!(root = getenv("TWORLDDIR")) || !*root) {
+#ifdef ROOTDIR
+	root = ROOTDIR;
+#else
+	root = ".";
+#endif
+    }
+
+    setseriesdir(choosepath(root, "sets", data->seriesdir));
+    setseriesdatdir(choosepath(root, "data", data->seriesdatdir));
+#ifdef SAVEDIR
+    setsavedir(choosepath(SAVEDIR, ".", save));
+#else
+    if ((dir = getenv("HOME")) && *dir)
+	setsavedir(choosepath(dir, ".tworld", save));
+    else
+	setsavedir(choosepath(root, "save", save));
+#endif
+}
+
+/* Basic number-parsing function that silently clamps input to a valid
+ * value.
+ */
+static int nparse(char const *str, int min, int max)
+{
+    int n;
+
+    parseint(str, &n, min);
+    return n < min ? min : n > max ? max : n;
+}
+
+/* Handle one option/argument from the command line.
+ */
+static int processoption(int opt, char const *val, void *ptr)
+{
+    benchdata  *data = ptr;
+
+    switch (opt) {
+      case 0:
+	if (data->savefilename) {
+	    fprintf(stderr, "too many arguments: %s\n", val);
+	    return 1;
+	} else if (*data->filename) {
+	    data->savefilename = getpathbuffer();
+	    sprintf(data->savefilename, "%.*s", getpathbufferlen(), val);
+	} else {
+	    sprintf(data->filename, "%.*s", getpathbufferlen(), val);
+	}
+	break;
+      case 'D':	    data->seriesdatdir = val;			    break;
+      case 'L':	    data->seriesdir = val;			    break;
+      case 'S':	    data->savedir = val;			    break;
+      case 't':	    data->ticks = nparse(val, 0, MAXIMUM_TICK_COUNT); break;
+      case 'r':	    data->seed = nparse(val, 0, 0x7FFFFFFF);	    break;
+      case 'R':
+	if (!strcmp(val, "ms"))
+	    data->ruleset = Ruleset_MS;
+	else if (!strcmp(val, "lynx"))
+	    data->ruleset = Ruleset_Lynx;
+	else {
+	    fprintf(stderr, "invalid ruleset: %s\n", val);
+	    return 1;
+	}
+	break;
+      case 'P':	    data->pedantic = !data->pedantic;		    break;
+      case 'h':	    fputs(usage, stdout);	       exit(EXIT_SUCCESS);
+      case 'v':	    puts(VERSION);		       exit(EXIT_SUCCESS);
+      case ':':
+	fprintf(stderr, "option requires an argument: %s\n", val);
+	return 1;
+      case '=':
+	fprintf(stderr, "option does not take an argument: %s\n", val);
+	return 1;
+      default:
+	fprintf(stderr, "unrecognized option: %s\n", val);
+	return 1;
+    }
+    return 0;
+}
+
+/* Parse the command line.
+ */
+static int getsettings(int argc, char *argv[], benchdata *data)
+{
+    static option const optlist[] = {
+	{ "data-dir",		'D', 'D', 1 },
+	{ "help",		'h', 'h', 0 },
+	{ "levelset-dir",	'L', 'L', 1 },
+	{ "pedantic",		'P', 'P', 0 },
+	{ "ruleset",		'R', 'R', 1 },
+	{ "save-dir",		'S', 'S', 1 },
+	{ "seed",		'r', 'r', 1 },
+	{ "ticks",		't', 't', 1 },
+	{ "version",		'v', 'v', 0 },
+	{ 0, 0, 0, 0 }
+    };
+
+    char	buf[256];
+
+    data->filename = getpathbuffer();
+    *data->filename = '\0';
+    data->savefilename = NULL;
+    data->seriesdir = NULL;
+    data->seriesdatdir = NULL;
+    data->savedir = NULL;
+    data->ticks = 2000;
+    data->seed = 1;
+    data->ruleset = Ruleset_None;
+    data->pedantic = FALSE;
+
+    if (readoptions(optlist, argc, argv, processoption, data)) {
+	fprintf(stderr, "Try --help for more information.\n");
+	return FALSE;
+    }
+    if (!*data->filename) {
+	fputs(usage, stderr);
+	return FALSE;
+    }
+    if (data->pedantic)
+	setpedanticmode();
+    initdirs(data);
+
+    if (!data->savefilename) {
+	if (loadsolutionsetname(data->filename, buf) > 0) {
+	    data->savefilename = getpathbuffer();
+	    strcpy(data->savefilename, data->filename);
+	    strcpy(data->filename, buf);
+	}
+    }
+    return TRUE;
+}
+
+/* Fold the final state of a game into the running hash. The state
+ * hash is folded in as two halves, since hashvalue() only accepts a
+ * long.
+ */
+static void addgamehash(benchresult *result)
+{
+    statehash	hash;
+
+    hash = gamestatehash();
+    result->hash = hashvalue(result->hash, (unsigned long)(hash >> 32));
+    result->hash = hashvalue(result->hash,
+			     (unsigned long)(hash & 0xFFFFFFFFUL));
+}
+
+/* Play one level for the given number of ticks, choosing a new
+ * direction to move in every few ticks. If the game ends early, it is
+ * restarted, so that every level is played for the same length of
+ * time.
+ */
+static void benchlevel(gamesetup *game, int ruleset, int ticks,
+		       unsigned long seed, benchresult *result)
+{
+    prng	input;
+    clock_t	start;
+    int		cmd, hold, n, f;
+
+    restartprng(&input, seed);
+    cmd = NIL;
+    hold = 0;
+    n = 0;
+    if (!initgamestate(game, ruleset, FALSE)) {
+	endgamestate();
+	return;
+    }
+    while (n < ticks) {
+	if (n && !restartgamestate()) {
+	    endgamestate();
+	    if (!initgamestate(game, ruleset, FALSE)) {
+		endgamestate();
+		return;
+	    }
+	}
+	seedgamestate(seed + n);
+	setgameplaymode(BeginVerify);
+	start = clock();
+	do {
+	    if (hold-- <= 0) {
+		cmd = random4(&input) ? idxdir(random4(&input)) : NIL;
+		hold = random4(&input) * 2;
+	    }
+	    f = doturn(cmd);
+	    ++n;
+	} while (!f && n < ticks);
+	result->elapsed += clock() - start;
+	setgameplaymode(EndVerify);
+	if (f > 0)
+	    ++result->solved;
+	addgamehash(result);
+    }
+    endgamestate();
+    result->ticks += n;
+    ++result->levels;
+}
+
+/* Play back the user's solution for one level, if there is one.
+ */
+static void benchsolution(gamesetup *game, int ruleset, benchresult *result)
+{
+    clock_t	start;
+    int		n, f;
+
+    if (initgamestate(game, ruleset, FALSE) && prepareplayback()) {
+	setgameplaymode(BeginVerify);
+	start = clock();
+	n = 0;
+	do {
+	    f = doturn(CmdNone);
+	    ++n;
+	} while (!f);
+	result->elapsed += clock() - start;
+	setgameplaymode(EndVerify);
+	if (f > 0)
+	    ++result->solved;
+	addgamehash(result);
+	result->ticks += n;
+	++result->levels;
+    }
+    endgamestate();
+}
+
+/* Return the most memory that the program has used so far, in
+ * kilobytes, or -1 if the system doesn't say.
+ */
+static long peakmemory(void)
+{
+#if defined __unix__ || defined __APPLE__
+    struct rusage	usage;
+
+    if (!getrusage(RUSAGE_SELF, &usage))
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+    return -1;
+}
+
+/* Output one line of measurements, as a list of name=value pairs.
+ */
+static void report(gameseries const *series, int ruleset, char const *mode,
+		   benchresult const *result)
+{
+    double	secs;
+
+    secs = (double)result->elapsed / CLOCKS_PER_SEC;
+    printf("set=%s ruleset=%s mode=%s levels=%d solved=%d ticks=%ld"
+	   " seconds=%.3f",
+	   series->filebase,
+	   ruleset == Ruleset_Lynx ? "lynx" : "ms",
+	   mode, result->levels, result->solved, result->ticks, secs);
+    if (result->elapsed > 0)
+	printf(" ticks_per_sec=%.0f ns_per_tick=%.0f",
+	       result->ticks / secs, secs * 1e9 / result->ticks);
+    else
+	printf(" ticks_per_sec=- ns_per_tick=-");
+    printf(" cache_hits=%lu cache_misses=%lu",
+	   result->cachehits, result->cachemisses);
+    printf(" hash=%016llx peak_kb=%ld\n", result->hash, peakmemory());
+}
+
+/* Start or stop counting the uses of the level cache.
+ */
+static void countcache(benchresult *result, int start)
+{
+    unsigned long	hits, misses;
+
+    getlevelcachestats(&hits, &misses);
+    if (start) {
+	result->cachehits = hits;
+	result->cachemisses = misses;
+    } else {
+	result->cachehits = hits - result->cachehits;
+	result->cachemisses = misses - result->cachemisses;
+    }
+}
+
+/* Load the level set and its solutions, and measure them.
+ */
+int main(int argc, char *argv[])
+{
+    benchdata	data;
+    benchresult	result;
+    gameseries *list;
+    tablespec	table;
+    int		ruleset;
+    int		count;
+    int		n;
+
+    if (!getsettings(argc, argv, &data))
+	return EXIT_CANNOTBENCH;
+    setreadonly();
+
+    if (!createserieslist(data.filename, &list, &count, &table))
+	return EXIT_CANNOTBENCH;
+    if (count != 1) {
+	errmsg(data.filename, count ? "more than one level set matches"
+				    : "no level sets found");
+	return EXIT_CANNOTBENCH;
+    }
+    if (data.savefilename)
+	list->savefilename = data.savefilename;
+    if (!readseriesfile(list)) {
+	errmsg(list->filebase, "cannot read level set");
+	return EXIT_CANNOTBENCH;
+    }
+
+    ruleset = data.ruleset ? data.ruleset : list->ruleset;
+
+    memset(&result, 0, sizeof result);
+    countcache(&result, TRUE);
+    for (n = 0 ; n < list->count ; ++n)
+	benchlevel(list->games + n, ruleset, data.ticks,
+		   data.seed + list->games[n].number, &result);
+    countcache(&result, FALSE);
+    report(list, ruleset, "input", &result);
+
+    memset(&result, 0, sizeof result);
+    countcache(&result, TRUE);
+    for (n = 0 ; n < list->count ; ++n)
+	if (hassolution(list->games + n))
+	    benchsolution(list->games + n, ruleset, &result);
+    countcache(&result, FALSE);
+    report(list, ruleset, "solutions", &result);
+
+    freeserieslist(list, count, &table);
+    shutdowngamestate();
+    return EXIT_SUCCESS;
+}
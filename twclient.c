@@ -0,0 +1,261 @@
+/* twclient.c: Sending requests to twdaemon.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* This program sends a single request to a running twdaemon and
+ * prints the reply. Solution filenames are made absolute before they
+ * are sent, since the daemon does not share the client's working
+ * directory. The exit status follows the conventions of twverify.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<errno.h>
+#include	<unistd.h>
+#include	<sys/types.h>
+#include	<sys/socket.h>
+#include	<sys/un.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"cmdline.h"
+#include	"twdaemon.h"
+#include	"ver.h"
+
+/* The online help.
+ */
+static char const *usage =
+    "Usage: twclient [OPTIONS] REQUEST [ARGUMENTS]\n"
+    "Send a request to twdaemon and display the reply.\n"
+    "\n"
+    "  -s, --socket=PATH       Connect to PATH (default $TWORLDSOCKET,\n"
+    "                          or else /tmp/tworld-UID.sock)\n"
+    "  -q, --quiet             Report only through the exit status\n"
+    "  -h, --help              Display this help and exit\n"
+    "  -v, --version           Display the version and exit\n"
+    "\n"
+    "The requests are:\n"
+    "  list                    List the level sets that are loaded\n"
+    "  verify SET FILE         Play back every solution in FILE\n"
+    "  replay SET LEVEL FILE   Play back one solution in FILE\n"
+    "  solve SET LEVEL [SECS]  Search for a solution to a level\n"
+    "\n"
+    "The exit status of verify is the number of invalid solutions (at\n"
+    "most 100). The exit status of replay or solve is 1 if the solution\n"
+    "is invalid or none was found. In every case, the exit status is\n"
+    "101 if the request could not be carried out.\n";
+
+/* The exit status used when the request fails.
+ */
+#define	EXIT_CANNOTREQUEST	101
+
+/* The most arguments that a request can have.
+ */
+#define	MAX_ARGS		4
+
+/* The values that the user can set on the command line.
+ */
+typedef	struct clientdata {
+    char       *socketname;	/* the socket to connect to */
+    char const *args[MAX_ARGS];	/* the request and its arguments */
+    int		argcount;	/* the number of entries in args */
+    int		quiet;		/* TRUE to suppress the reply */
+} clientdata;
+
+/* Handle one option/argument from the command line.
+ */
+static int processoption(int opt, char const *val, void *ptr)
+{
+    clientdata *data = ptr;
+
+    switch (opt) {
+      case 0:
+	if (data->argcount >= MAX_ARGS) {
+	    fprintf(stderr, "too many arguments: %s\n", val);
+	    return 1;
+	}
+	data->args[data->argcount++] = val;
+	break;
+      case 's':
+	sprintf(data->socketname, "%.*s", getpathbufferlen(), val);
+	break;
+      case 'q':	    data->quiet = !data->quiet;			    break;
+      case 'h':	    fputs(usage, stdout);	       exit(EXIT_SUCCESS);
+      case 'v':	    puts(VERSION);		       exit(EXIT_SUCCESS);
+      case ':':
+	fprintf(stderr, "option requires an argument: %s\n", val);
+	return 1;
+      case '=':
+	fprintf(stderr, "option does not take an argument: %s\n", val);
+	return 1;
+      default:
+	fprintf(stderr, "unrecognized option: %s\n", val);
+	return 1;
+    }
+    return 0;
+}
+
+/* Parse the command line.
+ */
+static int getsettings(int argc, char *argv[], clientdata *data)
+{
+    static option const optlist[] = {
+	{ "help",		'h', 'h', 0 },
+	{ "quiet",		'q', 'q', 0 },
+	{ "socket",		's', 's', 1 },
+	{ "version",		'v', 'v', 0 },
+	{ 0, 0, 0, 0 }
+    };
+
+    char const *env;
+
+    data->socketname = getpathbuffer();
+    *data->socketname = '\0';
+    data->argcount = 0;
+    data->quiet = FALSE;
+
+    if (readoptions(optlist, argc, argv, processoption, data)) {
+	fprintf(stderr, "Try --help for more information.\n");
+	return FALSE;
+    }
+    if (!data->argcount) {
+	fputs(usage, stderr);
+	return FALSE;
+    }
+    if (!*data->socketname) {
+	if ((env = getenv(DAEMON_SOCKETVAR)) && *env)
+	    sprintf(data->socketname, "%.*s", getpathbufferlen(), env);
+	else
+	    sprintf(data->socketname, DAEMON_SOCKETFMT,
+		    (unsigned long)getuid());
+    }
+    return TRUE;
+}
+
+/* Assemble the request line from the arguments. The last argument of
+ * a verify or replay request is a filename, which is prefixed with
+ * the current directory if it is not already absolute. FALSE is
+ * returned if the request is too long.
+ */
+static int buildrequest(clientdata const *data, char *line)
+{
+    char       *dir;
+    int		file, used, n;
+
+    file = -1;
+    if (!strcmp(data->args[0], "verify") && data->argcount == 3)
+	file = 2;
+    else if (!strcmp(data->args[0], "replay") && data->argcount == 4)
+	file = 3;
+
+    used = 0;
+    for (n = 0 ; n < data->argcount ; ++n) {
+	if (used + strlen(data->args[n]) + 2 >= DAEMON_MAXLINE)
+	    return FALSE;
+	if (n)
+	    line[used++] = ' ';
+	if (n == file && *data->args[n] != '/') {
+	    dir = getpathbuffer();
+	    if (!getcwd(dir, getpathbufferlen())
+			|| used + strlen(dir) + 1 >= DAEMON_MAXLINE) {
+		free(dir);
+		return FALSE;
+	    }
+	    used += sprintf(line + used, "%s/", dir);
+	    free(dir);
+	    if (used + strlen(data->args[n]) + 2 >= DAEMON_MAXLINE)
+		return FALSE;
+	}
+	used += sprintf(line + used, "%s", data->args[n]);
+    }
+    line[used++] = '\n';
+    line[used] = '\0';
+    return TRUE;
+}
+
+/* Connect to the daemon's socket, returning a stream that is open for
+ * reading and writing, or NULL if the daemon cannot be reached.
+ */
+static FILE *opendaemon(char const *socketname)
+{
+    struct sockaddr_un	addr;
+    FILE	       *fp;
+    int			fd;
+
+    if (strlen(socketname) >= sizeof addr.sun_path) {
+	errmsg(socketname, "socket name is too long");
+	return NULL;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketname);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+		|| connect(fd, (struct sockaddr*)&addr, sizeof addr)) {
+	errmsg(socketname, "cannot connect to daemon: %s", strerror(errno));
+	if (fd >= 0)
+	    close(fd);
+	return NULL;
+    }
+    if (!(fp = fdopen(fd, "r+"))) {
+	close(fd);
+	memerrexit();
+    }
+    return fp;
+}
+
+/* Send the request, display the reply, and turn the final line of the
+ * reply into an exit status.
+ */
+int main(int argc, char *argv[])
+{
+    clientdata	data;
+    FILE       *fp;
+    char	line[DAEMON_MAXLINE];
+    int		valid, invalid;
+    int		status;
+
+    if (!getsettings(argc, argv, &data))
+	return EXIT_CANNOTREQUEST;
+    if (!buildrequest(&data, line)) {
+	errmsg(NULL, "request is too long");
+	return EXIT_CANNOTREQUEST;
+    }
+    if (!(fp = opendaemon(data.socketname)))
+	return EXIT_CANNOTREQUEST;
+    if (fputs(line, fp) == EOF || fflush(fp)) {
+	errmsg(data.socketname, "cannot send request: %s", strerror(errno));
+	fclose(fp);
+	return EXIT_CANNOTREQUEST;
+    }
+
+    status = EXIT_CANNOTREQUEST;
+    while (fgets(line, sizeof line, fp)) {
+	if (!strncmp(line, "error", 5)) {
+	    fprintf(stderr, "twdaemon: %s", line + 5 + (line[5] == ' '));
+	    break;
+	}
+	if (!data.quiet)
+	    fputs(line, stdout);
+	if (!strncmp(line, "ok", 2)) {
+	    status = EXIT_SUCCESS;
+	    if (!strcmp(data.args[0], "verify")) {
+		if (sscanf(line, "ok %d %d", &valid, &invalid) == 2)
+		    status = invalid > 100 ? 100 : invalid;
+	    } else if (!strcmp(data.args[0], "replay")) {
+		if (strncmp(line, "ok valid", 8))
+		    status = 1;
+	    } else if (!strcmp(data.args[0], "solve")) {
+		if (strncmp(line, "ok solved", 9))
+		    status = 1;
+	    }
+	    break;
+	}
+    }
+    if (status == EXIT_CANNOTREQUEST && ferror(fp))
+	errmsg(data.socketname, "cannot read reply: %s", strerror(errno));
+    fclose(fp);
+    return status;
+}
@@ -0,0 +1,759 @@
+/* twdaemon.c: Serving verification requests over a local socket.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* This program reads every level set once at startup and then waits
+ * for requests on a Unix domain socket, so that each request pays
+ * only for the playing of its solutions, and not for finding and
+ * parsing the level sets first. Several clients are served at once,
+ * each by a thread of its own with a game of its own. The solutions
+ * named in a request are read into a private copy of the level set's
+ * list of levels, so requests never see each other's solutions, and
+ * the solution files are never modified. The protocol is described
+ * in twdaemon.h. Like twverify, it is linked with the null
+ * OS/hardware layer.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<errno.h>
+#include	<signal.h>
+#include	<time.h>
+#include	<unistd.h>
+#include	<pthread.h>
+#include	<sys/types.h>
+#include	<sys/stat.h>
+#include	<sys/time.h>
+#include	<sys/socket.h>
+#include	<sys/un.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"series.h"
+#include	"solution.h"
+#include	"play.h"
+#include	"verify.h"
+#include	"solve.h"
+#include	"cmdline.h"
+#include	"twdaemon.h"
+#include	"ver.h"
+
+/* The online help.
+ */
+static char const *usage =
+    "Usage: twdaemon [OPTIONS] [LEVELSET]\n"
+    "Load the level sets and serve requests to verify solutions on a\n"
+    "local socket, until interrupted.\n"
+    "\n"
+    "  -D, --data-dir=DIR      Read data files from DIR\n"
+    "  -L, --levelset-dir=DIR  Read level sets from DIR\n"
+    "  -S, --save-dir=DIR      Look for solution files given without\n"
+    "                          a directory in DIR\n"
+    "  -s, --socket=PATH       Listen on PATH (default $TWORLDSOCKET,\n"
+    "                          or else /tmp/tworld-UID.sock)\n"
+    "  -j, --jobs=N            Serve N requests at once (default 4)\n"
+    "  -m, --memory=N          Use no more than N megabytes per solve\n"
+    "                          request (default 256)\n"
+    "  -P, --pedantic          Use pedantic Lynx rules\n"
+    "  -q, --quiet             Do not log each request\n"
+    "  -h, --help              Display this help and exit\n"
+    "  -v, --version           Display the version and exit\n"
+    "\n"
+    "If LEVELSET is given, only that level set is loaded. Use twclient\n"
+    "to send requests.\n";
+
+/* The most requests that can be served at once.
+ */
+#define	MAX_DAEMON_JOBS		64
+
+/* How long a client may be silent before it is disconnected, in
+ * seconds.
+ */
+#define	IDLE_TIMEOUT		60
+
+/* The values that the user can set on the command line.
+ */
+typedef	struct daemondata {
+    char       *filename;	/* the one level set to load, if any */
+    char       *socketname;	/* the socket to listen on */
+    char const *seriesdir;	/* the level set directory (-L) */
+    char const *seriesdatdir;	/* the data file directory (-D) */
+    char const *savedir;	/* the solution file directory (-S) */
+    int		jobs;		/* the number of threads to use */
+    int		memory;		/* the search budget, in megabytes */
+    int		pedantic;	/* TRUE for pedantic Lynx rules */
+    int		quiet;		/* TRUE to suppress the log */
+} daemondata;
+
+/* The resident data shared by all of the serving threads.
+ */
+typedef	struct server {
+    gameseries	       *sets;		/* the level sets */
+    int			count;		/* the number of level sets */
+    int			listenfd;	/* the socket taking connections */
+    long		budget;		/* the memory allowed per search */
+    int			quiet;		/* TRUE if requests are not logged */
+} server;
+
+/* Allocate and assemble a directory path based on a root location, a
+ * default subdirectory name, and an optional override value.
+ */
+static char const *choosepath(char const *root, char const *dirname,
+			      char const *override)
+{
+    char       *dir;
+
+    dir = getpathbuffer();
+    if (override && *override)
+	strcpy(dir, override);
+    else
+	combinepath(dir, root, dirname);
+    return dir;
+}
+
+/* Set the directories used for finding level sets and solution files,
+ * using the same defaults as the main program.
+ */
+static void initdirs(daemondata const *data)
+{
+    char const *root;
+    char const *dir;
+    char const *save = data->savedir;
+
+    if (!save && (dir = getenv("TWORLDSAVEDIR")) && *dir)
+	save = dir;
+    if (!(root = getenv("TWORLDDIR")) || !*root) {
+#ifdef ROOTDIR
+	root = ROOTDIR;
+#else
+	root = ".";
+#endif
+    }
+
+    setseriesdir(choosepath(root, "sets", data->seriesdir));
+    setseriesdatdir(choosepath(root, "data", data->seriesdatdir));
+#ifdef SAVEDIR
+    setsavedir(choosepath(SAVEDIR, ".", save));
+#else
+    if ((dir = getenv("HOME")) && *dir)
+	setsavedir(choosepath(dir, ".tworld", save));
+    else
+	setsavedir(choosepath(root, "save", save));
+#endif
+}
+
+/* Basic number-parsing function that silently clamps input to a valid
+ * value.
+ */
+static int nparse(char const *str, int min, int max)
+{
+    int n;
+
+    parseint(str, &n, min);
+    return n < min ? min : n > max ? max : n;
+}
+
+/* Handle one option/argument from the command line.
+ */
+static int processoption(int opt, char const *val, void *ptr)
+{
+    daemondata *data = ptr;
+
+    switch (opt) {
+      case 0:
+	if (*data->filename) {
+	    fprintf(stderr, "too many arguments: %s\n", val);
+	    return 1;
+	}
+	sprintf(data->filename, "%.*s", getpathbufferlen(), val);
+	break;
+      case 'D':	    data->seriesdatdir = val;			    break;
+      case 'L':	    data->seriesdir = val;			    break;
+      case 'S':	    data->savedir = val;			    break;
+      case 's':
+	sprintf(data->socketname, "%.*s", getpathbufferlen(), val);
+	break;
+      case 'j':	    data->jobs = nparse(val, 1, MAX_DAEMON_JOBS);   break;
+      case 'm':	    data->memory = nparse(val, 1, 0x7FFFFFFF >> 20);  break;
+      case 'P':	    data->pedantic = !data->pedantic;		    break;
+      case 'q':	    data->quiet = !data->quiet;			    break;
+      case 'h':	    fputs(usage, stdout);	       exit(EXIT_SUCCESS);
+      case 'v':	    puts(VERSION);		       exit(EXIT_SUCCESS);
+      case ':':
+	fprintf(stderr, "option requires an argument: %s\n", val);
+	return 1;
+      case '=':
+	fprintf(stderr, "option does not take an argument: %s\n", val);
+	return 1;
+      default:
+	fprintf(stderr, "unrecognized option: %s\n", val);
+	return 1;
+    }
+    return 0;
+}
+
+/* Parse the command line.
+ */
+static int getsettings(int argc, char *argv[], daemondata *data)
+{
+    static option const optlist[] = {
+	{ "data-dir",		'D', 'D', 1 },
+	{ "help",		'h', 'h', 0 },
+	{ "jobs",		'j', 'j', 1 },
+	{ "levelset-dir",	'L', 'L', 1 },
+	{ "memory",		'm', 'm', 1 },
+	{ "pedantic",		'P', 'P', 0 },
+	{ "quiet",		'q', 'q', 0 },
+	{ "save-dir",		'S', 'S', 1 },
+	{ "socket",		's', 's', 1 },
+	{ "version",		'v', 'v', 0 },
+	{ 0, 0, 0, 0 }
+    };
+
+    char const *env;
+
+    data->filename = getpathbuffer();
+    *data->filename = '\0';
+    data->socketname = getpathbuffer();
+    *data->socketname = '\0';
+    data->seriesdir = NULL;
+    data->seriesdatdir = NULL;
+    data->savedir = NULL;
+    data->jobs = 4;
+    data->memory = 256;
+    data->pedantic = FALSE;
+    data->quiet = FALSE;
+
+    if (readoptions(optlist, argc, argv, processoption, data)) {
+	fprintf(stderr, "Try --help for more information.\n");
+	return FALSE;
+    }
+    if (!*data->socketname) {
+	if ((env = getenv(DAEMON_SOCKETVAR)) && *env)
+	    sprintf(data->socketname, "%.*s", getpathbufferlen(), env);
+	else
+	    sprintf(data->socketname, DAEMON_SOCKETFMT,
+		    (unsigned long)getuid());
+    }
+    if (data->pedantic)
+	setpedanticmode();
+    initdirs(data);
+    return TRUE;
+}
+
+/* Return the time elapsed since an arbitrary moment, in seconds.
+ */
+static double wallclock(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    return (double)time(NULL);
+#endif
+}
+
+/*
+ * Preparing the levels for a request.
+ */
+
+/* Find a resident level set by its filename.
+ */
+static gameseries const *findset(server const *srv, char const *name)
+{
+    int	n;
+
+    for (n = 0 ; n < srv->count ; ++n)
+	if (!strcmp(srv->sets[n].name, name)
+			|| !strcmp(srv->sets[n].filebase, name))
+	    return srv->sets + n;
+    return NULL;
+}
+
+/* Make a copy of a resident level set for one request, sharing the
+ * level data but not the solutions. If filename is not NULL, the
+ * solutions are read from that file. FALSE is returned if the file
+ * cannot be read, in which case nothing is left to free.
+ */
+static int loadrequest(gameseries const *set, char const *filename,
+		       gameseries *req)
+{
+    fileinfo	file;
+    gamesetup  *game;
+    int		n;
+
+    *req = *set;
+    req->games = NULL;
+    xalloc(req->games, (set->count + 1) * sizeof *req->games);
+    for (n = 0, game = req->games ; n < set->count ; ++n, ++game) {
+	*game = set->games[n];
+	game->besttime = TIME_NIL;
+	game->sgflags = 0;
+	game->solutionsize = 0;
+	game->solutiondata = NULL;
+    }
+    req->allocated = set->count + 1;
+    req->gsflags |= GSF_NOSAVING | GSF_NODEFAULTSAVE;
+    req->savefilename = NULL;
+    clearfileinfo(&req->savefile);
+    if (!filename)
+	return TRUE;
+
+    clearfileinfo(&file);
+    if (openfileindir(&file, getsavedir(), filename, "rb", NULL)) {
+	fileclose(&file, NULL);
+	req->savefilename = (char*)filename;
+	if (readsolutions(req))
+	    return TRUE;
+	clearsolutions(req);
+    }
+    free(req->games);
+    return FALSE;
+}
+
+/* Free the solutions and the copy of the levels made for a request.
+ */
+static void droprequest(gameseries *req)
+{
+    clearsolutions(req);
+    free(req->games);
+    req->games = NULL;
+}
+
+/* Separate the next word from the rest of a request. An empty string
+ * is returned if the request has no more words.
+ */
+static char *nextword(char **line)
+{
+    char       *word;
+
+    while (**line == ' ')
+	++*line;
+    word = *line;
+    while (**line && **line != ' ')
+	++*line;
+    if (**line)
+	*(*line)++ = '\0';
+    return word;
+}
+
+/* Return the rest of a request, which is taken to be a filename.
+ */
+static char *resttext(char **line)
+{
+    while (**line == ' ')
+	++*line;
+    return *line;
+}
+
+/* Parse a level number from a request, returning zero if it is not a
+ * valid number.
+ */
+static int levelnumber(char const *word)
+{
+    int	n;
+
+    if (!*word || !parseint(word, &n, 0) || n <= 0)
+	return 0;
+    return n;
+}
+
+/*
+ * The requests.
+ */
+
+/* Describe the resident level sets.
+ */
+static void listrequest(server const *srv, FILE *out, char *args)
+{
+    gameseries const   *set;
+    int			n;
+
+    (void)args;
+    for (n = 0, set = srv->sets ; n < srv->count ; ++n, ++set)
+	fprintf(out, "set %s %s %d\n", set->name,
+		set->ruleset == Ruleset_Lynx ? "lynx" : "ms", set->count);
+    fprintf(out, "ok %d\n", srv->count);
+}
+
+/* Play back every solution in a solution file, and report the result
+ * of each one.
+ */
+static void verifyrequest(server const *srv, FILE *out, char *args)
+{
+    gameseries const   *set;
+    gameseries		req;
+    gamesetup	       *game;
+    char const	       *filename;
+    int			valid = 0, invalid = 0;
+    int			f, n;
+
+    if (!(set = findset(srv, nextword(&args)))) {
+	fputs("error no such level set\n", out);
+	return;
+    }
+    filename = resttext(&args);
+    if (!*filename) {
+	fputs("error no solution file given\n", out);
+	return;
+    }
+    if (!loadrequest(set, filename, &req)) {
+	fputs("error cannot read solution file\n", out);
+	return;
+    }
+
+    for (n = 0, game = req.games ; n < req.count ; ++n, ++game) {
+	if (!hassolution(game))
+	    continue;
+	f = verifylevel(game, req.ruleset);
+	if (f > 0) {
+	    fprintf(out, "level %d valid %d\n", game->number, game->besttime);
+	    ++valid;
+	} else {
+	    fprintf(out, "level %d %s\n", game->number,
+		    f < 0 ? "invalid" : "unplayable");
+	    ++invalid;
+	}
+    }
+    fprintf(out, "ok %d %d\n", valid, invalid);
+    droprequest(&req);
+}
+
+/* Play back one solution in a solution file, and report where it
+ * ends up.
+ */
+static void replayrequest(server const *srv, FILE *out, char *args)
+{
+    gameseries const   *set;
+    gameseries		req;
+    gamesetup	       *game;
+    char const	       *filename;
+    statehash		hash = 0;
+    int			ticks = 0;
+    int			f, n;
+
+    if (!(set = findset(srv, nextword(&args)))) {
+	fputs("error no such level set\n", out);
+	return;
+    }
+    if (!(n = levelnumber(nextword(&args)))) {
+	fputs("error no level number given\n", out);
+	return;
+    }
+    filename = resttext(&args);
+    if (!*filename) {
+	fputs("error no solution file given\n", out);
+	return;
+    }
+    if (!loadrequest(set, filename, &req)) {
+	fputs("error cannot read solution file\n", out);
+	return;
+    }
+
+    n = findlevelinseries(&req, n, NULL);
+    if (n < 0 || !hassolution(req.games + n)) {
+	fputs("error no solution for that level\n", out);
+	droprequest(&req);
+	return;
+    }
+    game = req.games + n;
+    f = 0;
+    if (initgamestate(game, req.ruleset, FALSE) && prepareplayback()) {
+	setgameplaymode(BeginVerify);
+	while (!(f = doturn(CmdNone))) ;
+	ticks = ticksplayed();
+	hash = gamestatehash();
+	setgameplaymode(EndVerify);
+    }
+    endgamestate();
+    if (f)
+	fprintf(out, "ok %s %d %016llx\n", f > 0 ? "valid" : "invalid",
+		ticks, hash);
+    else
+	fputs("error the level cannot be played\n", out);
+    droprequest(&req);
+}
+
+/* Search for a solution to one level, and report its length.
+ */
+static void solverequest(server const *srv, FILE *out, char *args)
+{
+    static char const *outcomes[] = {
+	"solved", "unsolvable", "toolong", "outofmemory", NULL
+    };
+
+    gameseries const   *set;
+    gameseries		req;
+    solveparams		params;
+    solveresult		result;
+    char const	       *word;
+    int			n;
+
+    if (!(set = findset(srv, nextword(&args)))) {
+	fputs("error no such level set\n", out);
+	return;
+    }
+    if (!(n = levelnumber(nextword(&args)))) {
+	fputs("error no level number given\n", out);
+	return;
+    }
+    params.jobs = 1;
+    params.step = set->ruleset == Ruleset_Lynx ? 4 : 2;
+    params.maxticks = 0;
+    params.budget = srv->budget;
+    word = nextword(&args);
+    if (*word)
+	params.maxticks = nparse(word, 0, 999) * TICKS_PER_SECOND;
+
+    loadrequest(set, NULL, &req);
+    n = findlevelinseries(&req, n, NULL);
+    if (n < 0) {
+	fputs("error no such level\n", out);
+    } else {
+	solvelevel(req.games + n, req.ruleset, &params, &result);
+	if (!outcomes[result.outcome])
+	    fputs("error the level cannot be played\n", out);
+	else if (result.outcome == Solve_Solved)
+	    fprintf(out, "ok %s %d\n", outcomes[result.outcome],
+		    result.ticks);
+	else
+	    fprintf(out, "ok %s\n", outcomes[result.outcome]);
+    }
+    droprequest(&req);
+}
+
+/* Carry out one request and send the reply.
+ */
+static void handlerequest(server const *srv, FILE *out, char *line)
+{
+    static struct {
+	char const     *name;
+	void	      (*handler)(server const*, FILE*, char*);
+    } const requests[] = {
+	{ "list",	listrequest },
+	{ "verify",	verifyrequest },
+	{ "replay",	replayrequest },
+	{ "solve",	solverequest }
+    };
+
+    char       *name;
+    int		n;
+
+    name = nextword(&line);
+    for (n = 0 ; n < (int)(sizeof requests / sizeof *requests) ; ++n) {
+	if (!strcmp(name, requests[n].name)) {
+	    (*requests[n].handler)(srv, out, line);
+	    return;
+	}
+    }
+    fprintf(out, "error unknown request: %.64s\n", name);
+}
+
+/*
+ * Serving clients.
+ */
+
+/* Read requests from a client and answer them, one at a time, until
+ * the client disconnects. The socket is closed afterwards.
+ */
+static void serveclient(server const *srv, int fd)
+{
+    struct timeval	timeout;
+    FILE	       *in, *out;
+    char	       *line;
+    char	       *copy;
+    double		start;
+    int			n;
+
+    timeout.tv_sec = IDLE_TIMEOUT;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    if (!(in = fdopen(fd, "r"))) {
+	close(fd);
+	return;
+    }
+    if ((n = dup(fd)) < 0 || !(out = fdopen(n, "w"))) {
+	if (n >= 0)
+	    close(n);
+	fclose(in);
+	return;
+    }
+
+    line = NULL;
+    copy = NULL;
+    xalloc(line, DAEMON_MAXLINE);
+    xalloc(copy, DAEMON_MAXLINE);
+    while (fgets(line, DAEMON_MAXLINE, in)) {
+	n = strlen(line);
+	if (n && line[n - 1] != '\n' && !feof(in)) {
+	    fputs("error request too long\n", out);
+	    fflush(out);
+	    break;
+	}
+	while (n && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+	    line[--n] = '\0';
+	if (!n)
+	    continue;
+	memcpy(copy, line, n + 1);
+	start = wallclock();
+	handlerequest(srv, out, line);
+	if (fflush(out))
+	    break;
+	if (!srv->quiet) {
+	    printf("%s (%.1f ms)\n", copy, (wallclock() - start) * 1000.0);
+	    fflush(stdout);
+	}
+    }
+    free(copy);
+    free(line);
+    fclose(out);
+    fclose(in);
+}
+
+/* The body of each serving thread. Each one has its own game, and
+ * takes connections as they arrive.
+ */
+static void *servethread(void *data)
+{
+    server const       *srv = data;
+    gameplay	       *gp;
+    int			fd;
+
+    gp = creategameplay();
+    selectgameplay(gp);
+    for (;;) {
+	fd = accept(srv->listenfd, NULL, NULL);
+	if (fd < 0) {
+	    if (errno == EINTR || errno == ECONNABORTED)
+		continue;
+	    break;
+	}
+	serveclient(srv, fd);
+    }
+    selectgameplay(NULL);
+    destroygameplay(gp);
+    return NULL;
+}
+
+/* Create the socket and start listening on it. FALSE is returned if
+ * the socket cannot be created, or if another daemon is already using
+ * it.
+ */
+static int opensocket(server *srv, char const *socketname)
+{
+    struct sockaddr_un	addr;
+    mode_t		mask;
+    int			fd;
+
+    if (strlen(socketname) >= sizeof addr.sun_path) {
+	errmsg(socketname, "socket name is too long");
+	return FALSE;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketname);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	errmsg(socketname, "cannot create socket: %s", strerror(errno));
+	return FALSE;
+    }
+    if (!connect(fd, (struct sockaddr*)&addr, sizeof addr)) {
+	errmsg(socketname, "another daemon is already listening");
+	close(fd);
+	return FALSE;
+    }
+    close(fd);
+    unlink(socketname);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	errmsg(socketname, "cannot create socket: %s", strerror(errno));
+	return FALSE;
+    }
+    mask = umask(077);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof addr)
+			|| listen(fd, SOMAXCONN)) {
+	errmsg(socketname, "cannot listen on socket: %s", strerror(errno));
+	umask(mask);
+	close(fd);
+	return FALSE;
+    }
+    umask(mask);
+    srv->listenfd = fd;
+    return TRUE;
+}
+
+/* Load the level sets, and serve requests until a signal arrives.
+ */
+int main(int argc, char *argv[])
+{
+    daemondata	data;
+    server	srv;
+    gameseries *list;
+    pthread_t	thread;
+    sigset_t	sigs;
+    int		count, started;
+    int		sig, n;
+
+    if (!getsettings(argc, argv, &data))
+	return EXIT_FAILURE;
+    setreadonly();
+
+    if (!createserieslist(*data.filename ? data.filename : NULL,
+			  &list, &count, NULL))
+	return EXIT_FAILURE;
+    srv.sets = list;
+    srv.count = 0;
+    for (n = 0 ; n < count ; ++n) {
+	if (readseriesfile(list + n)) {
+	    list[srv.count++] = list[n];
+	} else {
+	    warn("%s: cannot read level set", list[n].filebase);
+	    freeseriesdata(list + n);
+	}
+    }
+    if (!srv.count) {
+	errmsg(NULL, "no level sets could be read");
+	return EXIT_FAILURE;
+    }
+    srv.budget = (long)data.memory << 20;
+    srv.quiet = data.quiet;
+    if (!opensocket(&srv, data.socketname))
+	return EXIT_FAILURE;
+
+    signal(SIGPIPE, SIG_IGN);
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    sigaddset(&sigs, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+    started = 0;
+    for (n = 0 ; n < data.jobs ; ++n) {
+	if (pthread_create(&thread, NULL, servethread, &srv))
+	    break;
+	pthread_detach(thread);
+	++started;
+    }
+    if (!started) {
+	errmsg(NULL, "cannot start any threads");
+	unlink(data.socketname);
+	return EXIT_FAILURE;
+    }
+    if (!srv.quiet) {
+	printf("Serving %d level set%s on %s with %d thread%s.\n",
+	       srv.count, srv.count == 1 ? "" : "s", data.socketname,
+	       started, started == 1 ? "" : "s");
+	fflush(stdout);
+    }
+
+    sigwait(&sigs, &sig);
+    unlink(data.socketname);
+    if (!srv.quiet)
+	printf("Stopped by signal %d.\n", sig);
+    return EXIT_SUCCESS;
+}
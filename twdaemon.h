@@ -0,0 +1,55 @@
+/* twdaemon.h: The protocol spoken between twdaemon and twclient.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#ifndef	_twdaemon_h_
+#define	_twdaemon_h_
+
+/* A client connects to the daemon's Unix domain socket and sends
+ * requests, one per line. Words are separated by spaces, and a
+ * filename, which may contain spaces, is always the last item on the
+ * line. Filenames are used as given, so clients should send absolute
+ * pathnames. The requests are:
+ *
+ *   list			List the resident level sets.
+ *   verify SET FILE		Play back every solution in FILE.
+ *   replay SET LEVEL FILE	Play back one level's solution in FILE.
+ *   solve SET LEVEL [SECONDS]	Search for a solution to a level.
+ *
+ * The daemon answers each request with zero or more lines of detail,
+ * followed by a single line that begins with "ok" or "error", after
+ * which the next request can be sent. The detail lines are:
+ *
+ *   set NAME RULESET LEVELS	(list) one line per level set
+ *   level N valid TICKS	(verify) one line per solution, giving
+ *   level N invalid		its corrected time if it is valid
+ *   level N unplayable
+ *
+ * and the final lines are:
+ *
+ *   ok COUNT			(list) the number of level sets
+ *   ok VALID INVALID		(verify) the totals of each kind
+ *   ok RESULT TICKS HASH	(replay) valid or invalid, the ticks
+ *				played, and the hash of the final state
+ *   ok RESULT [TICKS]		(solve) solved, followed by the length
+ *				of the solution, or else unsolvable,
+ *				toolong, or outofmemory
+ *   error MESSAGE		(any) the request could not be carried
+ *				out
+ */
+
+/* The environment variable that overrides the default socket.
+ */
+#define	DAEMON_SOCKETVAR	"TWORLDSOCKET"
+
+/* The default socket, with the user's ID filled in.
+ */
+#define	DAEMON_SOCKETFMT	"/tmp/tworld-%lu.sock"
+
+/* The longest request or reply line, including the newline.
+ */
+#define	DAEMON_MAXLINE		4096
+
+#endif
@@ -0,0 +1,530 @@
+/* twfuzz.c: Checking the solution codec against its reference version.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* This program generates random move lists and compresses each one
+ * with contractsolution(), checking that the bytes are identical to
+ * those produced by the reference encoder below, and that the moves
+ * read back are the ones that went in. The data is then truncated or
+ * damaged at random, and every decoder (opensolution() with
+ * nextsolutionmove(), countsolutionmoves(), and expandsolution()) is
+ * checked against the reference decoder, move by move.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"solution.h"
+#include	"cmdline.h"
+#include	"ver.h"
+
+/* The online help.
+ */
+static char const *usage =
+    "Usage: twfuzz [OPTIONS]\n"
+    "Compress and expand random solutions, and check the results against\n"
+    "a reference version of the solution codec.\n"
+    "\n"
+    "  -n, --count=N           Check N random solutions (default 100000)\n"
+    "  -r, --seed=N            Generate the solutions from seed N\n"
+    "                          (default 1)\n"
+    "  -h, --help              Display this help and exit\n"
+    "  -v, --version           Display the version and exit\n"
+    "\n"
+    "The exit status is zero if every check passed.\n";
+
+/* The values that the user can set on the command line.
+ */
+typedef	struct fuzzdata {
+    long	count;		/* the number of solutions to check */
+    unsigned long seed;		/* the seed for the random solutions */
+} fuzzdata;
+
+/* The largest number of moves in a generated solution.
+ */
+#define	MAX_FUZZMOVES	64
+
+/* The number of mismatches that are described in full.
+ */
+#define	MAX_REPORTED	10
+
+/*
+ * The reference codec. This is the solution codec as it stood before
+ * moves were decoded on demand and the encoded values were sized with
+ * a table, and it is the standard that the current codec is held to.
+ * (See solution.c for a description of the format.)
+ */
+
+/* Translate move directions between three-bit and four-bit
+ * representations.
+ */
+static int const refdiridx8[16] = {
+    -1,  0,  1,  4,  2, -1,  5, -1,  3,  6, -1, -1,  7, -1, -1, -1
+};
+static int const refidxdir8[8] = {
+    NORTH, WEST, SOUTH, EAST,
+    NORTH | WEST, SOUTH | WEST, NORTH | EAST, SOUTH | EAST
+};
+
+#define	isdirectmove(dir)	(directionalcmd(dir))
+#define	ismousemove(dir)	(!isdirectmove(dir))
+#define	isdiagonal(dir)		(isdirectmove(dir) && refdiridx8[dir] > 3)
+#define isorthogonal(dir)	(isdirectmove(dir) && refdiridx8[dir] <= 3)
+#define	dirtoindex(dir)		(refdiridx8[dir])
+#define	indextodir(dir)		(refidxdir8[dir])
+
+/* Expand a level's solution data into an actual list of moves. FALSE
+ * is returned if there is no solution, or if the data is truncated.
+ * Unlike the original, a truncation is not reported, and the moves
+ * read up to that point are kept, so that the other decoders can be
+ * checked against them.
+ */
+static int refexpandsolution(solutioninfo *solution, gamesetup const *game)
+{
+    unsigned char const	       *dataend;
+    unsigned char const	       *p;
+    action			act;
+    int				n;
+
+    if (game->solutionsize <= 16)
+	return FALSE;
+
+    solution->flags = game->solutiondata[6];
+    solution->rndslidedir = indextodir(game->solutiondata[7] & 7);
+    solution->stepping = (game->solutiondata[7] >> 3) & 7;
+    solution->rndseed = game->solutiondata[8] | (game->solutiondata[9] << 8)
+					      | (game->solutiondata[10] << 16)
+					      | (game->solutiondata[11] << 24);
+
+    initmovelist(&solution->moves);
+    act.when = -1;
+    p = game->solutiondata + 16;
+    dataend = game->solutiondata + game->solutionsize;
+    while (p < dataend) {
+	switch (*p & 0x03) {
+	  case 0:
+	    act.dir = indextodir((*p >> 2) & 0x03);
+	    act.when += 4;
+	    addtomovelist(&solution->moves, act);
+	    act.dir = indextodir((*p >> 4) & 0x03);
+	    act.when += 4;
+	    addtomovelist(&solution->moves, act);
+	    act.dir = indextodir((*p >> 6) & 0x03);
+	    act.when += 4;
+	    addtomovelist(&solution->moves, act);
+	    ++p;
+	    break;
+	  case 1:
+	    act.dir = indextodir((*p >> 2) & 0x07);
+	    act.when += ((*p >> 5) & 0x07) + 1;
+	    addtomovelist(&solution->moves, act);
+	    ++p;
+	    break;
+	  case 2:
+	    if (p + 2 > dataend)
+		return FALSE;
+	    act.dir = indextodir((*p >> 2) & 0x07);
+	    act.when += ((p[0] >> 5) & 0x07) + ((unsigned long)p[1] << 3) + 1;
+	    addtomovelist(&solution->moves, act);
+	    p += 2;
+	    break;
+	  case 3:
+	    if (*p & 0x10) {
+		n = (*p >> 2) & 0x03;
+		if (p + 2 + n > dataend)
+		    return FALSE;
+		act.dir = ((p[0] >> 5) & 0x07) | ((p[1] & 0x3F) << 3);
+		act.when += (p[1] >> 6) & 0x03;
+		while (n--)
+		    act.when += (unsigned long)p[2 + n] << (2 + n * 8);
+		++act.when;
+		p += 2 + ((*p >> 2) & 0x03);
+	    } else {
+		if (p + 4 > dataend)
+		    return FALSE;
+		act.dir = indextodir((*p >> 2) & 0x03);
+		act.when += ((p[0] >> 5) & 0x07) | ((unsigned long)p[1] << 3)
+						 | ((unsigned long)p[2] << 11)
+						 | ((unsigned long)p[3] << 19);
+		++act.when;
+		p += 4;
+	    }
+	    addtomovelist(&solution->moves, act);
+	    break;
+	}
+    }
+    return TRUE;
+}
+
+/* Take the given solution and compress it, storing the compressed
+ * data as part of the level's setup.
+ */
+static int refcontractsolution(solutioninfo const *solution,
+			       gamesetup *game)
+{
+    action const       *move;
+    unsigned char      *data;
+    int			size, delta, when, i;
+
+    free(game->solutiondata);
+    game->solutionsize = 0;
+    game->solutiondata = NULL;
+    game->sgflags |= SGF_UNSAVED;
+    if (!solution->moves.count)
+	return TRUE;
+
+    size = 21;
+    move = solution->moves.list + 1;
+    for (i = 1 ; i < solution->moves.count ; ++i, ++move)
+	size += !isorthogonal(move->dir) ? 5
+			: move[0].when - move[-1].when <= (1 << 3) ? 1
+			: move[0].when - move[-1].when <= (1 << 11) ? 2 : 4;
+    data = malloc(size);
+    if (!data)
+	return FALSE;
+
+    data[0] = game->number & 0xFF;
+    data[1] = (game->number >> 8) & 0xFF;
+    data[2] = game->passwd[0];
+    data[3] = game->passwd[1];
+    data[4] = game->passwd[2];
+    data[5] = game->passwd[3];
+    data[6] = solution->flags;
+    data[7] = dirtoindex(solution->rndslidedir) | (solution->stepping << 3);
+    data[8] = solution->rndseed & 0xFF;
+    data[9] = (solution->rndseed >> 8) & 0xFF;
+    data[10] = (solution->rndseed >> 16) & 0xFF;
+    data[11] = (solution->rndseed >> 24) & 0xFF;
+    data[12] = game->besttime & 0xFF;
+    data[13] = (game->besttime >> 8) & 0xFF;
+    data[14] = (game->besttime >> 16) & 0xFF;
+    data[15] = (game->besttime >> 24) & 0xFF;
+
+    when = -1;
+    size = 16;
+    move = solution->moves.list;
+    for (i = 0 ; i < solution->moves.count ; ++i, ++move) {
+	delta = -when - 1;
+	when = move->when;
+	delta += when;
+	if (ismousemove(move->dir)
+			|| (isdiagonal(move->dir) && delta >= (1 << 11))) {
+	    data[size] = 0x13 | ((move->dir << 5) & 0xE0);
+	    data[size + 1] = ((move->dir >> 3) & 0x3F) | ((delta & 0x03) << 6);
+	    if (delta < (1 << 2)) {
+		size += 2;
+	    } else {
+		data[size + 2] = (delta >> 2) & 0xFF;
+		if (delta < (1 << 10)) {
+		    data[size] |= 1 << 2;
+		    size += 3;
+		} else {
+		    data[size + 3] = (delta >> 10) & 0xFF;
+		    if (delta < (1 << 18)) {
+			data[size] |= 2 << 2;
+			size += 4;
+		    } else {
+			data[size + 4] = (delta >> 18) & 0xFF;
+			data[size] |= 3 << 2;
+			size += 5;
+		    }
+		}
+	    }
+	} else if (delta == 3 && i + 2 < solution->moves.count
+			      && isorthogonal(move[0].dir)
+			      && move[1].when - move[0].when == 4
+			      && isorthogonal(move[1].dir)
+			      && move[2].when - move[1].when == 4
+			      && isorthogonal(move[2].dir)) {
+	    data[size++] = (dirtoindex(move[0].dir) << 2)
+			 | (dirtoindex(move[1].dir) << 4)
+			 | (dirtoindex(move[2].dir) << 6);
+	    move += 2;
+	    i += 2;
+	    when = move->when;
+	} else if (delta < (1 << 3)) {
+	    data[size++] = 0x01 | (dirtoindex(move->dir) << 2)
+				| ((delta << 5) & 0xE0);
+	} else if (delta < (1 << 11)) {
+	    data[size++] = 0x02 | (dirtoindex(move->dir) << 2)
+				| ((delta << 5) & 0xE0);
+	    data[size++] = (delta >> 3) & 0xFF;
+	} else {
+	    data[size++] = 0x03 | (dirtoindex(move->dir) << 2)
+				| ((delta << 5) & 0xE0);
+	    data[size++] = (delta >> 3) & 0xFF;
+	    data[size++] = (delta >> 11) & 0xFF;
+	    data[size++] = (delta >> 19) & 0xFF;
+	}
+    }
+
+    game->solutionsize = size;
+    game->solutiondata = realloc(data, size);
+    if (!game->solutiondata)
+	game->solutiondata = data;
+    return TRUE;
+}
+
+/*
+ * Generating the test cases.
+ */
+
+/* The state of the random-number generator.
+ */
+static unsigned long	fuzzseed;
+
+/* Return a random integer between zero and n - 1, inclusive.
+ */
+static int fuzzrandom(int n)
+{
+    fuzzseed = (fuzzseed * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+    return (int)((fuzzseed >> 8) % n);
+}
+
+/* Fill the solution with a random list of moves. The gaps between the
+ * moves and the directions are weighted towards those that select
+ * each of the encoded formats, including the one that packs three
+ * moves into a byte. Only the relative mouse moves are used, since
+ * the format has no room for the others, and the seed is kept to the
+ * 31 bits that the game's random-number generator produces.
+ */
+static void makesolution(solutioninfo *solution)
+{
+    action	move;
+    int		count, gap, k, n;
+
+    initmovelist(&solution->moves);
+    count = 1 + fuzzrandom(MAX_FUZZMOVES);
+    move.when = -1;
+    for (n = 0 ; n < count ; ++n) {
+	k = fuzzrandom(10);
+	gap = k < 4 ? 4 : k < 6 ? 1 + fuzzrandom(8)
+		    : k < 8 ? 1 + fuzzrandom(2100)
+		    : k < 9 ? 1 + fuzzrandom(600000) : 1 + fuzzrandom(20);
+	move.when += gap;
+	k = fuzzrandom(12);
+	if (k < 8)
+	    move.dir = 1 << (k & 3);
+	else if (k < 10)
+	    move.dir = indextodir(4 + fuzzrandom(4));
+	else
+	    move.dir = CmdMouseMoveFirst
+		     + fuzzrandom(CmdMouseMoveLast - CmdMouseMoveFirst + 1);
+	addtomovelist(&solution->moves, move);
+    }
+    solution->flags = 0;
+    solution->rndseed = (unsigned long)fuzzrandom(0x8000) << 16
+		      | fuzzrandom(0x10000);
+    solution->rndslidedir = indextodir(fuzzrandom(4));
+    solution->stepping = fuzzrandom(8);
+}
+
+/* Cut the solution data short, or overwrite some of its bytes, or
+ * both. The header is left intact.
+ */
+static void damagesolution(gamesetup *game)
+{
+    int	n;
+
+    if (fuzzrandom(2) && game->solutionsize > 17)
+	game->solutionsize = 17 + fuzzrandom(game->solutionsize - 17);
+    if (fuzzrandom(2) && game->solutionsize > 16) {
+	for (n = 1 + fuzzrandom(4) ; n ; --n)
+	    game->solutiondata[16 + fuzzrandom(game->solutionsize - 16)]
+		= fuzzrandom(256);
+    }
+}
+
+/*
+ * The checks.
+ */
+
+/* The number of mismatches found so far.
+ */
+static long	mismatches = 0;
+
+/* Record a mismatch, and describe it if not too many have been found.
+ */
+static void mismatch(long iteration, char const *what)
+{
+    if (mismatches++ < MAX_REPORTED)
+	printf("case %ld: %s\n", iteration, what);
+}
+
+/* Return TRUE if two move lists are identical.
+ */
+static int samemoves(actlist const *a, actlist const *b)
+{
+    return a->count == b->count
+	&& !memcmp(a->list, b->list, a->count * sizeof *a->list);
+}
+
+/* Compress the solution with both encoders, and check that they agree
+ * and that the moves survive the round trip. The current encoder's
+ * output is left in game.
+ */
+static void checkencoding(long iteration, solutioninfo const *solution,
+			  gamesetup *game)
+{
+    gamesetup		ref;
+    solutioninfo	back;
+
+    memset(&ref, 0, sizeof ref);
+    ref.number = game->number;
+    memcpy(ref.passwd, game->passwd, sizeof ref.passwd);
+    ref.besttime = game->besttime;
+    if (!refcontractsolution(solution, &ref))
+	memerrexit();
+    if (!contractsolution(solution, game))
+	memerrexit();
+    if (ref.solutionsize != game->solutionsize
+		|| memcmp(ref.solutiondata, game->solutiondata,
+			  ref.solutionsize))
+	mismatch(iteration, "encoded bytes differ");
+    free(ref.solutiondata);
+
+    memset(&back, 0, sizeof back);
+    if (!expandsolution(&back, game))
+	mismatch(iteration, "encoded solution cannot be expanded");
+    else if (!samemoves(&back.moves, &solution->moves)
+			|| back.rndseed != solution->rndseed
+			|| back.rndslidedir != solution->rndslidedir
+			|| back.stepping != solution->stepping)
+	mismatch(iteration, "solution changed in the round trip");
+    destroymovelist(&back.moves);
+}
+
+/* Decode the solution data with every decoder, and check them against
+ * the reference decoder.
+ */
+static void checkdecoding(long iteration, gamesetup const *game)
+{
+    solutioncursor	cursor;
+    solutioninfo	refsol, sol;
+    action		move;
+    int			refret, ret, n;
+
+    memset(&refsol, 0, sizeof refsol);
+    memset(&sol, 0, sizeof sol);
+    refret = refexpandsolution(&refsol, game);
+    if (!opensolution(&cursor, &sol, game)) {
+	if (game->solutionsize > 16)
+	    mismatch(iteration, "opensolution() disagrees");
+	goto done;
+    }
+    if (sol.flags != refsol.flags || sol.rndseed != refsol.rndseed
+				  || sol.rndslidedir != refsol.rndslidedir
+				  || sol.stepping != refsol.stepping) {
+	mismatch(iteration, "opensolution() disagrees");
+	goto done;
+    }
+
+    for (n = 0 ; (ret = nextsolutionmove(&cursor, &move)) > 0 ; ++n) {
+	if (n >= refsol.moves.count || move.when != refsol.moves.list[n].when
+				    || move.dir != refsol.moves.list[n].dir) {
+	    mismatch(iteration, "nextsolutionmove() disagrees");
+	    goto done;
+	}
+    }
+    if (n != refsol.moves.count || (ret < 0) != !refret) {
+	mismatch(iteration, "nextsolutionmove() disagrees");
+	goto done;
+    }
+    if (countsolutionmoves(game) != (refret ? refsol.moves.count : -1)) {
+	mismatch(iteration, "countsolutionmoves() disagrees");
+	goto done;
+    }
+    if (!refret)
+	goto done;
+
+    if (!expandsolution(&sol, game))
+	mismatch(iteration, "expandsolution() fails");
+    else if (!samemoves(&refsol.moves, &sol.moves))
+	mismatch(iteration, "expandsolution() disagrees");
+
+  done:
+    destroymovelist(&refsol.moves);
+    destroymovelist(&sol.moves);
+}
+
+/* Handle one option/argument from the command line.
+ */
+static int processoption(int opt, char const *val, void *ptr)
+{
+    fuzzdata   *data = ptr;
+    int		n;
+
+    switch (opt) {
+      case 'n':
+	parseint(val, &n, 1);
+	data->count = n < 1 ? 1 : n;
+	break;
+      case 'r':
+	parseint(val, &n, 0);
+	data->seed = n < 0 ? 0 : n;
+	break;
+      case 'h':	    fputs(usage, stdout);	       exit(EXIT_SUCCESS);
+      case 'v':	    puts(VERSION);		       exit(EXIT_SUCCESS);
+      case 0:
+	fprintf(stderr, "too many arguments: %s\n", val);
+	return 1;
+      case ':':
+	fprintf(stderr, "option requires an argument: %s\n", val);
+	return 1;
+      case '=':
+	fprintf(stderr, "option does not take an argument: %s\n", val);
+	return 1;
+      default:
+	fprintf(stderr, "unrecognized option: %s\n", val);
+	return 1;
+    }
+    return 0;
+}
+
+/* Generate and check the requested number of solutions.
+ */
+int main(int argc, char *argv[])
+{
+    static option const optlist[] = {
+	{ "count",		'n', 'n', 1 },
+	{ "help",		'h', 'h', 0 },
+	{ "seed",		'r', 'r', 1 },
+	{ "version",		'v', 'v', 0 },
+	{ 0, 0, 0, 0 }
+    };
+
+    fuzzdata		data;
+    solutioninfo	solution;
+    gamesetup		game;
+    long		n;
+
+    data.count = 100000;
+    data.seed = 1;
+    if (readoptions(optlist, argc, argv, processoption, &data)) {
+	fprintf(stderr, "Try --help for more information.\n");
+	return EXIT_FAILURE;
+    }
+
+    fuzzseed = data.seed;
+    memset(&solution, 0, sizeof solution);
+    memset(&game, 0, sizeof game);
+    for (n = 0 ; n < data.count ; ++n) {
+	makesolution(&solution);
+	game.number = 1 + fuzzrandom(999);
+	memcpy(game.passwd, "ABCD", 4);
+	game.besttime = solution.moves.list[solution.moves.count - 1].when;
+	checkencoding(n, &solution, &game);
+	checkdecoding(n, &game);
+	damagesolution(&game);
+	checkdecoding(n, &game);
+	destroymovelist(&solution.moves);
+    }
+    free(game.solutiondata);
+
+    printf("%ld solutions checked, %ld mismatches\n", data.count, mismatches);
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
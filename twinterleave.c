@@ -0,0 +1,354 @@
+/* twinterleave.c: Checking that separate games do not share state.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* This program plays the levels of a level set two at a time, each
+ * on a game of its own, taking turns a tick at a time. The same two
+ * levels are also played one after the other, again on two games of
+ * their own. Every game is new, since the Lynx logic carries a little
+ * state over from one level to the next. The moves are generated from
+ * a fixed seed, and the hash of the state after every tick is folded
+ * into a running hash for each level, so any state that leaks from
+ * one game into the other shows up as a difference between the
+ * interleaved and the serial run.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"series.h"
+#include	"solution.h"
+#include	"play.h"
+#include	"random.h"
+#include	"cmdline.h"
+#include	"ver.h"
+
+/* The online help.
+ */
+static char const *usage =
+    "Usage: twinterleave [OPTIONS] LEVELSET\n"
+    "Play the levels in a level set two at a time, alternating ticks,\n"
+    "and check that every level plays out as it does on its own.\n"
+    "\n"
+    "  -D, --data-dir=DIR      Read data files from DIR\n"
+    "  -L, --levelset-dir=DIR  Read level sets from DIR\n"
+    "  -t, --ticks=N           Play each level for N ticks (default 2000)\n"
+    "  -r, --seed=N            Generate the moves from seed N (default 1)\n"
+    "  -R, --ruleset=RULES     Play under RULES (ms or lynx) instead of\n"
+    "                          the level set's own ruleset\n"
+    "  -P, --pedantic          Use pedantic Lynx rules\n"
+    "  -h, --help              Display this help and exit\n"
+    "  -v, --version           Display the version and exit\n"
+    "\n"
+    "The exit status is the number of levels that played out\n"
+    "differently (at most 100), or 101 if a level could not be checked.\n";
+
+/* The exit status used when a level could not be checked.
+ */
+#define	EXIT_CANNOTCHECK	101
+
+/* The values that the user can set on the command line.
+ */
+typedef	struct checkdata {
+    char       *filename;	/* the level set */
+    char const *seriesdir;	/* the level set directory (-L) */
+    char const *seriesdatdir;	/* the data file directory (-D) */
+    int		ticks;		/* the number of ticks to play each level */
+    int		seed;		/* the seed for the generated moves */
+    int		ruleset;	/* the ruleset to use, if overridden */
+    int		pedantic;	/* TRUE for pedantic Lynx rules */
+} checkdata;
+
+/* One level being played.
+ */
+typedef	struct testgame {
+    gameplay   *gp;		/* the game it is played on */
+    prng	input;		/* the source of the generated moves */
+    int		cmd;		/* the move being made */
+    int		hold;		/* ticks left before the next move */
+    int		ticks;		/* the number of ticks left to play */
+    int		done;		/* TRUE once the game is over */
+    statehash	hash;		/* the combined state of every tick */
+} testgame;
+
+/* Fold a value into a running hash.
+ */
+#define	foldhash(hash, value)	((hash) * 0x100000001B3ULL ^ (value))
+
+/* Allocate and assemble a directory path based on a root location, a
+ * default subdirectory name, and an optional override value.
+ */
+static char const *choosepath(char const *root, char const *dirname,
+			      char const *override)
+{
+    char       *dir;
+
+    dir = getpathbuffer();
+    if (override && *override)
+	strcpy(dir, override);
+    else
+	combinepath(dir, root, dirname);
+    return dir;
+}
+
+/* Set the directories used for finding level sets, using the same
+ * defaults as the main program. No solutions are read.
+ */
+static void initdirs(checkdata const *data)
+{
+    char const *root;
+
+    if (!(root = getenv("TWORLDDIR")) || !*root) {
+#ifdef ROOTDIR
+	root = ROOTDIR;
+#else
+	root = ".";
+#endif
+    }
+    setseriesdir(choosepath(root, "sets", data->seriesdir));
+    setseriesdatdir(choosepath(root, "data", data->seriesdatdir));
+}
+
+/* Basic number-parsing function that silently clamps input to a valid
+ * value.
+ */
+static int nparse(char const *str, int min, int max)
+{
+    int n;
+
+    parseint(str, &n, min);
+    return n < min ? min : n > max ? max : n;
+}
+
+/* Handle one option/argument from the command line.
+ */
+static int processoption(int opt, char const *val, void *ptr)
+{
+    checkdata  *data = ptr;
+
+    switch (opt) {
+      case 0:
+	if (*data->filename) {
+	    fprintf(stderr, "too many arguments: %s\n", val);
+	    return 1;
+	}
+	sprintf(data->filename, "%.*s", getpathbufferlen(), val);
+	break;
+      case 'D':	    data->seriesdatdir = val;			    break;
+      case 'L':	    data->seriesdir = val;			    break;
+      case 't':	    data->ticks = nparse(val, 1, MAXIMUM_TICK_COUNT); break;
+      case 'r':	    data->seed = nparse(val, 0, 0x7FFFFFFF);	    break;
+      case 'R':
+	if (!strcmp(val, "ms"))
+	    data->ruleset = Ruleset_MS;
+	else if (!strcmp(val, "lynx"))
+	    data->ruleset = Ruleset_Lynx;
+	else {
+	    fprintf(stderr, "invalid ruleset: %s\n", val);
+	    return 1;
+	}
+	break;
+      case 'P':	    data->pedantic = !data->pedantic;		    break;
+      case 'h':	    fputs(usage, stdout);	       exit(EXIT_SUCCESS);
+      case 'v':	    puts(VERSION);		       exit(EXIT_SUCCESS);
+      case ':':
+	fprintf(stderr, "option requires an argument: %s\n", val);
+	return 1;
+      case '=':
+	fprintf(stderr, "option does not take an argument: %s\n", val);
+	return 1;
+      default:
+	fprintf(stderr, "unrecognized option: %s\n", val);
+	return 1;
+    }
+    return 0;
+}
+
+/* Parse the command line.
+ */
+static int getsettings(int argc, char *argv[], checkdata *data)
+{
+    static option const optlist[] = {
+	{ "data-dir",		'D', 'D', 1 },
+	{ "help",		'h', 'h', 0 },
+	{ "levelset-dir",	'L', 'L', 1 },
+	{ "pedantic",		'P', 'P', 0 },
+	{ "ruleset",		'R', 'R', 1 },
+	{ "seed",		'r', 'r', 1 },
+	{ "ticks",		't', 't', 1 },
+	{ "version",		'v', 'v', 0 },
+	{ 0, 0, 0, 0 }
+    };
+
+    data->filename = getpathbuffer();
+    *data->filename = '\0';
+    data->seriesdir = NULL;
+    data->seriesdatdir = NULL;
+    data->ticks = 2000;
+    data->seed = 1;
+    data->ruleset = Ruleset_None;
+    data->pedantic = FALSE;
+
+    if (readoptions(optlist, argc, argv, processoption, data)) {
+	fprintf(stderr, "Try --help for more information.\n");
+	return FALSE;
+    }
+    if (!*data->filename) {
+	fputs(usage, stderr);
+	return FALSE;
+    }
+    if (data->pedantic)
+	setpedanticmode();
+    initdirs(data);
+    return TRUE;
+}
+
+/* Begin playing a level on a new game. FALSE is returned if the level
+ * cannot be set up.
+ */
+static int startgame(testgame *tg, gamesetup *game,
+		     int ruleset, int ticks, unsigned long seed)
+{
+    tg->gp = creategameplay();
+    restartprng(&tg->input, seed);
+    tg->cmd = NIL;
+    tg->hold = 0;
+    tg->ticks = ticks;
+    tg->done = FALSE;
+    tg->hash = 0;
+    selectgameplay(tg->gp);
+    if (!initgamestate(game, ruleset, FALSE)) {
+	endgamestate();
+	tg->done = TRUE;
+	return FALSE;
+    }
+    seedgamestate(seed);
+    setgameplaymode(BeginVerify);
+    return TRUE;
+}
+
+/* Play one tick of a level, choosing a new direction to move in every
+ * few ticks, and fold the resulting state into the level's hash. The
+ * game is ended when it is over or has run out of ticks.
+ */
+static void playtick(testgame *tg)
+{
+    statehash	hash;
+    int		f;
+
+    if (tg->done)
+	return;
+    selectgameplay(tg->gp);
+    if (tg->hold-- <= 0) {
+	tg->cmd = random4(&tg->input) ? idxdir(random4(&tg->input)) : NIL;
+	tg->hold = random4(&tg->input) * 2;
+    }
+    f = doturn(tg->cmd);
+    hash = gamestatehash();
+    tg->hash = foldhash(tg->hash, hash);
+    if (f || --tg->ticks <= 0) {
+	setgameplaymode(EndVerify);
+	endgamestate();
+	tg->done = TRUE;
+    }
+}
+
+/* Play two levels one after the other, and then side by side, and
+ * compare the results. The number of levels that played out
+ * differently is returned, and the number of levels that could not be
+ * set up is added to failed.
+ */
+static int checkpair(gamesetup *a, gamesetup *b,
+		     int ruleset, int ticks, unsigned long seed, int *failed)
+{
+    testgame	serial[2], inter[2];
+    gamesetup  *games[2];
+    int		ok[2];
+    int		count, n;
+
+    games[0] = a;
+    games[1] = b;
+    for (n = 0 ; n < 2 ; ++n) {
+	ok[n] = startgame(serial + n, games[n], ruleset, ticks,
+			  seed + games[n]->number);
+	while (!serial[n].done)
+	    playtick(serial + n);
+    }
+
+    for (n = 0 ; n < 2 ; ++n)
+	if (!startgame(inter + n, games[n], ruleset, ticks,
+		       seed + games[n]->number))
+	    ok[n] = FALSE;
+    while (!inter[0].done || !inter[1].done)
+	for (n = 0 ; n < 2 ; ++n)
+	    playtick(inter + n);
+
+    count = 0;
+    for (n = 0 ; n < 2 ; ++n) {
+	destroygameplay(serial[n].gp);
+	destroygameplay(inter[n].gp);
+	if (!ok[n]) {
+	    printf("Level %d could not be set up\n", games[n]->number);
+	    ++*failed;
+	} else if (serial[n].hash != inter[n].hash) {
+	    printf("Level %d plays differently when interleaved with"
+		   " level %d\n", games[n]->number, games[1 - n]->number);
+	    ++count;
+	}
+    }
+    return count;
+}
+
+/* Load the level set, and play every level alongside its neighbor.
+ */
+int main(int argc, char *argv[])
+{
+    checkdata	data;
+    gameseries *list;
+    tablespec	table;
+    int		ruleset;
+    int		count;
+    int		bad, failed, n;
+
+    if (!getsettings(argc, argv, &data))
+	return EXIT_CANNOTCHECK;
+    setreadonly();
+    setcachereadonly();
+
+    if (!createserieslist(data.filename, &list, &count, &table))
+	return EXIT_CANNOTCHECK;
+    if (count != 1) {
+	errmsg(data.filename, count ? "more than one level set matches"
+				    : "no level sets found");
+	return EXIT_CANNOTCHECK;
+    }
+    if (!readseriesfile(list)) {
+	errmsg(list->filebase, "cannot read level set");
+	return EXIT_CANNOTCHECK;
+    }
+    if (list->count < 2) {
+	errmsg(list->filebase, "at least two levels are needed");
+	return EXIT_CANNOTCHECK;
+    }
+
+    ruleset = data.ruleset ? data.ruleset : list->ruleset;
+    bad = failed = 0;
+    for (n = 0 ; n < list->count ; n += 2)
+	bad += checkpair(list->games + n,
+			 list->games + (n + 1) % list->count,
+			 ruleset, data.ticks, data.seed, &failed);
+    printf("%d levels checked, %d played differently\n", list->count, bad);
+    if (failed)
+	printf("%d levels could not be set up\n", failed);
+
+    freeserieslist(list, count, &table);
+    shutdowngamestate();
+    if (failed)
+	return EXIT_CANNOTCHECK;
+    return bad > 100 ? 100 : bad;
+}
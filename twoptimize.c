@@ -0,0 +1,312 @@
+/* twoptimize.c: Making the solutions for a level set quicker.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* This program takes the user's solutions for a level set and tries
+ * many small variations of each one, keeping any that win sooner. It
+ * will not find a different route through a level, but it can remove
+ * the hesitations and wasted moves from a route that works. Quicker
+ * solutions replace the old ones in the user's solution file, exactly
+ * as if they had been played. Like twverify, it is linked with the
+ * null OS/hardware layer.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"series.h"
+#include	"solution.h"
+#include	"play.h"
+#include	"optimize.h"
+#include	"cmdline.h"
+#include	"ver.h"
+
+/* The online help.
+ */
+static char const *usage =
+    "Usage: twoptimize [OPTIONS] LEVELSET [LEVEL]\n"
+    "Look for quicker versions of the user's solutions for a level set,\n"
+    "and save any that are found.\n"
+    "\n"
+    "  -D, --data-dir=DIR      Read data files from DIR\n"
+    "  -L, --levelset-dir=DIR  Read level sets from DIR\n"
+    "  -S, --save-dir=DIR      Read and write solution files in DIR\n"
+    "  -j, --jobs=N            Try variations on N threads at once\n"
+    "  -t, --time=N            Spend no more than about N seconds on\n"
+    "                          each level (default 60, 0 for no limit)\n"
+    "  -n, --dry-run           Do not save the solutions found\n"
+    "  -P, --pedantic          Use pedantic Lynx rules\n"
+    "  -h, --help              Display this help and exit\n"
+    "  -v, --version           Display the version and exit\n"
+    "\n"
+    "If LEVEL is given, only that level's solution is optimized.\n";
+
+/* The exit status used when the level set cannot be optimized at all.
+ */
+#define	EXIT_CANNOTOPTIMIZE	101
+
+/* The values that the user can set on the command line.
+ */
+typedef	struct optimizedata {
+    char       *filename;	/* the level set */
+    char       *savefilename;	/* the solution file, if given */
+    char const *seriesdir;	/* the level set directory (-L) */
+    char const *seriesdatdir;	/* the data file directory (-D) */
+    char const *savedir;	/* the solution file directory (-S) */
+    int		level;		/* the one level to optimize, or zero */
+    int		jobs;		/* the number of threads to use */
+    int		seconds;	/* the time allowed per level, or zero */
+    int		dryrun;		/* TRUE to leave the solution file alone */
+    int		pedantic;	/* TRUE for pedantic Lynx rules */
+} optimizedata;
+
+/* Allocate and assemble a directory path based on a root location, a
+ * default subdirectory name, and an optional override value.
+ */
+static char const *choosepath(char const *root, char const *dirname,
+			      char const *override)
+{
+    char       *dir;
+
+    dir = getpathbuffer();
+    if (override && *override)
+	strcpy(dir, override);
+    else
+	combinepath(dir, root, dirname);
+    return dir;
+}
+
+/* Set the directories used for finding level sets and solution files,
+ * using the same defaults as the main program.
+ */
+static void initdirs(optimizedata const *data)
+{
+    char const *root;
+    char const *dir;
+    char const *save = data->savedir;
+
+    if (!save && (dir = getenv("TWORLDSAVEDIR")) && *dir)
+	save = dir;
+    if (!(root = getenv("TWORLDDIR")) || !*root) {
+#ifdef ROOTDIR
+	root = ROOTDIR;
+#else
+	root = ".";
+#endif
+    }
+
+    setseriesdir(choosepath(root, "sets", data->seriesdir));
+    setseriesdatdir(choosepath(root, "data", data->seriesdatdir));
+#ifdef SAVEDIR
+    setsavedir(choosepath(SAVEDIR, ".", save));
+#else
+    if ((dir = getenv("HOME")) && *dir)
+	setsavedir(choosepath(dir, ".tworld", save));
+    else
+	setsavedir(choosepath(root, "save", save));
+#endif
+}
+
+/* Basic number-parsing function that silently clamps input to a valid
+ * value.
+ */
+static int nparse(char const *str, int min, int max)
+{
+    int n;
+
+    parseint(str, &n, min);
+    return n < min ? min : n > max ? max : n;
+}
+
+/* Handle one option/argument from the command line.
+ */
+static int processoption(int opt, char const *val, void *ptr)
+{
+    optimizedata       *data = ptr;
+
+    switch (opt) {
+      case 0:
+	if (data->level) {
+	    fprintf(stderr, "too many arguments: %s\n", val);
+	    return 1;
+	} else if (*data->filename) {
+	    data->level = nparse(val, 1, 999);
+	} else {
+	    sprintf(data->filename, "%.*s", getpathbufferlen(), val);
+	}
+	break;
+      case 'D':	    data->seriesdatdir = val;			    break;
+      case 'L':	    data->seriesdir = val;			    break;
+      case 'S':	    data->savedir = val;			    break;
+      case 'j':	    data->jobs = nparse(val, 1, MAX_OPTIMIZE_JOBS); break;
+      case 't':	    data->seconds = nparse(val, 0, 99999);	    break;
+      case 'n':	    data->dryrun = !data->dryrun;		    break;
+      case 'P':	    data->pedantic = !data->pedantic;		    break;
+      case 'h':	    fputs(usage, stdout);	       exit(EXIT_SUCCESS);
+      case 'v':	    puts(VERSION);		       exit(EXIT_SUCCESS);
+      case ':':
+	fprintf(stderr, "option requires an argument: %s\n", val);
+	return 1;
+      case '=':
+	fprintf(stderr, "option does not take an argument: %s\n", val);
+	return 1;
+      default:
+	fprintf(stderr, "unrecognized option: %s\n", val);
+	return 1;
+    }
+    return 0;
+}
+
+/* Parse the command line.
+ */
+static int getsettings(int argc, char *argv[], optimizedata *data)
+{
+    static option const optlist[] = {
+	{ "data-dir",		'D', 'D', 1 },
+	{ "dry-run",		'n', 'n', 0 },
+	{ "help",		'h', 'h', 0 },
+	{ "jobs",		'j', 'j', 1 },
+	{ "levelset-dir",	'L', 'L', 1 },
+	{ "pedantic",		'P', 'P', 0 },
+	{ "save-dir",		'S', 'S', 1 },
+	{ "time",		't', 't', 1 },
+	{ "version",		'v', 'v', 0 },
+	{ 0, 0, 0, 0 }
+    };
+
+    char	buf[256];
+
+    data->filename = getpathbuffer();
+    *data->filename = '\0';
+    data->savefilename = NULL;
+    data->seriesdir = NULL;
+    data->seriesdatdir = NULL;
+    data->savedir = NULL;
+    data->level = 0;
+    data->jobs = 1;
+    data->seconds = 60;
+    data->dryrun = FALSE;
+    data->pedantic = FALSE;
+
+    if (readoptions(optlist, argc, argv, processoption, data)) {
+	fprintf(stderr, "Try --help for more information.\n");
+	return FALSE;
+    }
+    if (!*data->filename) {
+	fputs(usage, stderr);
+	return FALSE;
+    }
+    if (data->pedantic)
+	setpedanticmode();
+    initdirs(data);
+
+    if (loadsolutionsetname(data->filename, buf) > 0) {
+	data->savefilename = getpathbuffer();
+	strcpy(data->savefilename, data->filename);
+	strcpy(data->filename, buf);
+    }
+    return TRUE;
+}
+
+/* Optimize the solution for one level and report the outcome. The
+ * return value is the number of ticks saved.
+ */
+static int optimizeone(gamesetup *game, int ruleset,
+		       optimizeparams const *params)
+{
+    optimizeresult	result;
+
+    optimizelevel(game, ruleset, params, &result);
+    printf("Level %3d: ", game->number);
+    switch (result.outcome) {
+      case Optimize_Improved:
+	printf("%d.%02d -> %d.%02d seconds, %d ticks saved",
+	       result.before / TICKS_PER_SECOND,
+	       (result.before % TICKS_PER_SECOND) * (100 / TICKS_PER_SECOND),
+	       result.after / TICKS_PER_SECOND,
+	       (result.after % TICKS_PER_SECOND) * (100 / TICKS_PER_SECOND),
+	       result.before - result.after);
+	break;
+      case Optimize_Unchanged:
+	printf("no quicker solution found");
+	break;
+      case Optimize_Invalid:
+	printf("solution is invalid\n");
+	return 0;
+      default:
+	printf("cannot be played\n");
+	return 0;
+    }
+    printf(" (%ld candidates, %.0f/s)\n", result.candidates,
+	   result.seconds > 0 ? result.candidates / result.seconds : 0.0);
+    fflush(stdout);
+    return result.outcome == Optimize_Improved
+		? result.before - result.after : 0;
+}
+
+/* Load the level set and its solutions, optimize them, and save them.
+ */
+int main(int argc, char *argv[])
+{
+    optimizedata	data;
+    optimizeparams	params;
+    gameseries	       *list;
+    tablespec		table;
+    long		saved;
+    int			tried, improved, ticks;
+    int			count;
+    int			n;
+
+    if (!getsettings(argc, argv, &data))
+	return EXIT_CANNOTOPTIMIZE;
+    if (data.dryrun)
+	setreadonly();
+
+    if (!createserieslist(data.filename, &list, &count, &table))
+	return EXIT_CANNOTOPTIMIZE;
+    if (count != 1) {
+	errmsg(data.filename, count ? "more than one level set matches"
+				    : "no level sets found");
+	return EXIT_CANNOTOPTIMIZE;
+    }
+    if (data.savefilename)
+	list->savefilename = data.savefilename;
+    if (!readseriesfile(list)) {
+	errmsg(list->filebase, "cannot read level set");
+	return EXIT_CANNOTOPTIMIZE;
+    }
+
+    params.jobs = data.jobs;
+    params.seconds = data.seconds;
+
+    saved = 0;
+    tried = improved = 0;
+    for (n = 0 ; n < list->count ; ++n) {
+	if (data.level && list->games[n].number != data.level)
+	    continue;
+	if (!hassolution(list->games + n))
+	    continue;
+	++tried;
+	ticks = optimizeone(list->games + n, list->ruleset, &params);
+	if (ticks) {
+	    ++improved;
+	    saved += ticks;
+	    savesolutions(list);
+	}
+    }
+    if (!tried)
+	errmsg(list->filebase, "no solutions to optimize");
+    else
+	printf("Improved %d of %d solutions, saving %ld.%02ld seconds.\n",
+	       improved, tried, saved / TICKS_PER_SECOND,
+	       (saved % TICKS_PER_SECOND) * (100 / TICKS_PER_SECOND));
+
+    freeserieslist(list, count, &table);
+    shutdowngamestate();
+    return tried ? EXIT_SUCCESS : EXIT_FAILURE;
+}
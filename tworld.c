@@ -17,6 +17,8 @@
 #include	"solution.h"
 #include	"messages.h"
 #include	"help.h"
+#include	"verify.h"
+#include	"render.h"
 #include	"oshw.h"
 #include	"cmdline.h"
 #include	"ver.h"
@@ -58,14 +60,18 @@ typedef	struct startupdata {
     char const	       *seriesdir;	/* where the series files are */
     char const	       *seriesdatdir;	/* where the series data files are */
     char const	       *savedir;	/* where the solution files are */
+    char const	       *renderdir;	/* where to write rendered frames */
+    renderrange		render;		/* which frames to render */
     int			volumelevel;	/* the initial volume level */
     int			soundbufsize;	/* the sound buffer scaling factor */
     int			mudsucking;	/* slowdown factor (for debugging) */
+    int			jobs;		/* number of verification threads */
     unsigned char	listdirs;	/* TRUE to list directories */
     unsigned char	listseries;	/* TRUE to list files */
     unsigned char	listscores;	/* TRUE to list scores */
     unsigned char	listtimes;	/* TRUE to list times */
     unsigned char	batchverify;	/* TRUE to do batch verification */
+    unsigned char	nocache;	/* TRUE to ignore earlier results */
     unsigned char	showhistogram;	/* TRUE to display idle histogram */
     unsigned char	pedantic;	/* TRUE to set pedantic mode */
     unsigned char	fullscreen;	/* TRUE to run in full-screen mode */
@@ -84,6 +90,10 @@ static int		silence = FALSE;
  */
 static int		usepasswds = TRUE;
 
+/* The most memory, in bytes, to use for seeking within a playback.
+ */
+static long		seekmemory = 8192L * 1024;
+
 /* The top of the stack of subtitles.
  */
 static void	      **subtitlestack = NULL;
@@ -447,7 +457,7 @@ static void replaceablesolution(gamespec *gs, int change)
 static void passwordseen(gamespec *gs, int number)
 {
     if (!(gs->series.games[number].sgflags & SGF_HASPASSWD)) {
-	gs->series.games[number].sgflags |= SGF_HASPASSWD;
+	gs->series.games[number].sgflags |= SGF_HASPASSWD | SGF_UNSAVED;
 	savesolutions(&gs->series);
     }
 }
@@ -1075,12 +1085,20 @@ static int playgame(gamespec *gs, int firstcmd)
 /* Play back the user's best solution for the current level in real
  * time. Other than the fact that this function runs from a
  * prerecorded series of moves, it has the same behavior as
- * playgame().
+ * playgame(), except that the left and right arrows move backwards
+ * and forwards through the playback: one second at a time while
+ * playing, and one tick at a time while paused.
  */
 static int playbackgame(gamespec *gs)
 {
-    int	render, lastrendered, n;
+    char	msg[64];
+    int		render, lastrendered, n;
 
+    if (preparecheckpoints(seekmemory)) {
+	sprintf(msg, "%ld KB used for seeking",
+		(checkpointmemory(NULL) + 1023) / 1024);
+	setdisplaymsg(msg, 1000, 0);
+    }
     drawscreen(TRUE);
 
     gs->status = 0;
@@ -1094,6 +1112,12 @@ static int playbackgame(gamespec *gs)
 	    break;
 	render = waitfortick();
 	switch (input(FALSE)) {
+	  case CmdWest:
+	    seekgamestate(ticksplayed() - TICKS_PER_SECOND);
+	    break;
+	  case CmdEast:
+	    seekgamestate(ticksplayed() + TICKS_PER_SECOND);
+	    break;
 	  case CmdVolumeUp:	changevolume(+2, TRUE);		break;
 	  case CmdVolumeDown:	changevolume(-2, TRUE);		break;
 	  case CmdPrevLevel:	changecurrentgame(gs, -1);	goto quitloop;
@@ -1107,6 +1131,14 @@ static int playbackgame(gamespec *gs)
 	    setdisplaymsg("(paused)", 1, 1);
 	    for (;;) {
 		switch (input(TRUE)) {
+		  case CmdWest:
+		    seekgamestate(ticksplayed() - 1);
+		    drawscreen(TRUE);
+		    continue;
+		  case CmdEast:
+		    seekgamestate(ticksplayed() + 1);
+		    drawscreen(TRUE);
+		    continue;
 		  case CmdQuit:		exit(0);
 		  case CmdPauseGame:	break;
 		  default:		continue;
@@ -1162,7 +1194,6 @@ static int verifyplayback(gamespec *gs)
 	n = doturn(CmdNone);
 	if (n)
 	    break;
-	advancetick();
 	switch (input(FALSE)) {
 	  case CmdPrevLevel:	changecurrentgame(gs, -1);	goto quitloop;
 	  case CmdNextLevel:	changecurrentgame(gs, +1);	goto quitloop;
@@ -1249,49 +1280,6 @@ static int runcurrentlevel(gamespec *gs)
     return ret;
 }
 
-/* Quickly play back all of the user's solutions in the series without
- * rendering or using the timer or the keyboard. If display is TRUE,
- * the solutions that cannot be verified are reported to stdout. The
- * return value is the number of invalid solutions found.
- */
-static int batchverify(gameseries *series, int display)
-{
-    gamesetup  *game;
-    int		valid = 0, invalid = 0;
-    int		i, f;
-
-    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
-	if (!hassolution(game))
-	    continue;
-	if (initgamestate(game, series->ruleset, FALSE) && prepareplayback()) {
-	    setgameplaymode(BeginVerify);
-	    while (!(f = doturn(CmdNone)))
-		advancetick();
-	    setgameplaymode(EndVerify);
-	    if (f > 0) {
-		++valid;
-		checksolution();
-	    } else {
-		++invalid;
-		game->sgflags |= SGF_REPLACEABLE;
-		if (display)
-		    printf("Solution for level %d is invalid\n", game->number);
-	    }
-	}
-	endgamestate();
-    }
-
-    if (display) {
-	if (valid + invalid == 0) {
-	    printf("No solutions were found.\n");
-	} else {
-	    printf("  Valid solutions:%4d\n", valid);
-	    printf("Invalid solutions:%4d\n", invalid);
-	}
-    }
-    return invalid;
-}
-
 /*
  * Game selection functions
  */
@@ -1565,6 +1553,13 @@ static int processoption(int opt, char const *val, void *data)
       case 't':	    start->listtimes = TRUE;			    break;
       case 'b':	    start->batchverify = TRUE;			    break;
       case 'm':	    start->mudsucking = nparse(val, 1, 10);	    break;
+      case 'j':	    start->jobs = nparse(val, 1, MAX_VERIFY_JOBS);  break;
+      case 'C':	    start->nocache = !start->nocache;		    break;
+      case 'M':	    seekmemory = nparse(val, 64, 1 << 20) * 1024L;  break;
+      case 'o':	    start->renderdir = val;			    break;
+      case 'e':	    start->render.step = nparse(val, 1, 999999);    break;
+      case 'f':	    start->render.first = nparse(val, 0, 999999);   break;
+      case 'u':	    start->render.last = nparse(val, 0, 999999);    break;
       case 'h':	    printtable(stdout, yowzitch);      exit(EXIT_SUCCESS);
       case 'V':	    printtable(stdout, vourzhon);      exit(EXIT_SUCCESS);
       case 'v':	    puts(VERSION);		       exit(EXIT_SUCCESS);
@@ -1595,8 +1590,11 @@ static int getsettingsfromcmdline(int argc, char *argv[], startupdata *start)
 	{ "histogram",		 0 , 'H', 0 },
 	{ "help",		'h', 'h', 0 },
 	{ "initial-levelset",	 0 , 'i', 1 },
+	{ "jobs",		'j', 'j', 1 },
 	{ "levelset-dir",	'L', 'L', 1 },
 	{ "list-levelsets",	'l', 'l', 0 },
+	{ "no-cache",		 0 , 'C', 0 },
+	{ "seek-memory",	'M', 'M', 1 },
 #ifndef NDEBUG
 	{ "mud-sucking",	'm', 'm', 1 },
 #endif
@@ -1606,6 +1604,10 @@ static int getsettingsfromcmdline(int argc, char *argv[], startupdata *start)
 	{ "quiet",		'q', 'q', 0 },
 	{ "resource-dir",	'R', 'R', 1 },
 	{ "read-only",		'r', 'r', 0 },
+	{ "render",		 0 , 'o', 1 },
+	{ "render-every",	 0 , 'e', 1 },
+	{ "render-from",	 0 , 'f', 1 },
+	{ "render-to",		 0 , 'u', 1 },
 	{ "save-dir",		'S', 'S', 1 },
 	{ "list-scores",	's', 's', 0 },
 	{ "list-times",		't', 't', 0 },
@@ -1625,6 +1627,10 @@ static int getsettingsfromcmdline(int argc, char *argv[], startupdata *start)
     start->seriesdir = NULL;
     start->seriesdatdir = NULL;
     start->savedir = NULL;
+    start->renderdir = NULL;
+    start->render.first = 0;
+    start->render.last = -1;
+    start->render.step = 1;
     start->listdirs = FALSE;
     start->listseries = FALSE;
     start->listscores = FALSE;
@@ -1637,13 +1643,17 @@ static int getsettingsfromcmdline(int argc, char *argv[], startupdata *start)
     start->volumelevel = -1;
     start->soundbufsize = -1;
     start->mudsucking = 1;
+    start->jobs = 1;
+    start->nocache = FALSE;
 
     if (readoptions(optlist, argc, argv, processoption, start)) {
 	fprintf(stderr, "Try --help for more information.\n");
 	return FALSE;
     }
-    if (start->readonly)
+    if (start->readonly) {
 	setreadonly();
+	setcachereadonly();
+    }
     if (start->pedantic)
 	setpedanticmode();
 
@@ -1733,7 +1743,7 @@ static int getsettings(int argc, char *argv[], startupdata *start)
     if (!getsettingsfrominitfile(start))
 	return FALSE;
     if (start->listscores || start->listtimes || start->batchverify
-					      || start->levelnum) {
+			  || start->renderdir || start->levelnum) {
 	if (!*start->filename) {
 	    errmsg(NULL, "no level set specified");
 	    return FALSE;
@@ -1747,8 +1757,8 @@ static int getsettings(int argc, char *argv[], startupdata *start)
 static int initializesystem(startupdata const *start)
 {
     setmudsuckingfactor(start->mudsucking);
-    if (!oshwinitialize(silence, start->soundbufsize,
-			start->showhistogram, start->fullscreen))
+    if (!oshwinitialize(silence, start->soundbufsize, start->showhistogram,
+			start->fullscreen, start->renderdir != NULL))
 	return FALSE;
     if (!initresources())
 	return FALSE;
@@ -1771,8 +1781,10 @@ static void shutdownsystem(void)
  * listseries option is TRUE, the available series are displayed on
  * stdout and the program exits. Otherwise, if listscores or listtimes
  * is TRUE, the scores or times for a single series is display on
- * stdout and the program exits. (These options need to be checked for
- * before initializing the graphics subsystem.) Otherwise, the
+ * stdout and the program exits. If renderdir is set, the playbacks of
+ * the series' solutions are rendered to image files and the program
+ * exits. (These options need to be checked for before initializing
+ * the graphics subsystem.) Otherwise, the
  * selectseriesandlevel() function handles the rest of the work. Note
  * that this function is only called during the initial startup; if
  * the user returns to the series list later on, the choosegame()
@@ -1809,9 +1821,20 @@ static int choosegameatstartup(gamespec *gs, startupdata const *start)
 	    errmsg(series.list[0].filebase, "cannot read level set");
 	    return -1;
 	}
+	if (start->renderdir) {
+	    if (!initializesystem(start)) {
+		errmsg(NULL, "cannot initialize program due to previous"
+			     " errors");
+		return -1;
+	    }
+	    return renderseries(series.list, start->levelnum,
+				start->renderdir, &start->render) ? 0 : -1;
+	}
 	if (start->batchverify) {
-	    n = batchverify(series.list, !silence && !start->listtimes
-						  && !start->listscores);
+	    n = batchverify(series.list, start->jobs,
+			    !silence && !start->listtimes
+				     && !start->listscores,
+			    !start->nocache);
 	    if (silence)
 		exit(n > 100 ? 100 : n);
 	    else if (!start->listtimes && !start->listscores)
@@ -1838,6 +1861,11 @@ static int choosegameatstartup(gamespec *gs, startupdata const *start)
 	}
     }
 
+    if (start->renderdir) {
+	errmsg(NULL, "more than one level set matches");
+	return -1;
+    }
+
     if (!initializesystem(start)) {
 	errmsg(NULL, "cannot initialize program due to previous errors");
 	return -1;
@@ -0,0 +1,307 @@
+/* twsolve.c: Searching for solutions to the levels of a level set.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* This program searches for the quickest solution to each level in a
+ * level set that the user has not already solved, by trying every
+ * sequence of moves in turn. It can only hope to finish on small or
+ * simple levels, so the search is limited by a memory budget. Any
+ * solutions found are added to the user's solution file, exactly as
+ * if they had been played. Like twverify, it is linked with the null
+ * OS/hardware layer.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"series.h"
+#include	"solution.h"
+#include	"play.h"
+#include	"solve.h"
+#include	"cmdline.h"
+#include	"ver.h"
+
+/* The online help.
+ */
+static char const *usage =
+    "Usage: twsolve [OPTIONS] LEVELSET [LEVEL]\n"
+    "Search for solutions to the unsolved levels in a level set, and\n"
+    "add them to the user's solution file.\n"
+    "\n"
+    "  -D, --data-dir=DIR      Read data files from DIR\n"
+    "  -L, --levelset-dir=DIR  Read level sets from DIR\n"
+    "  -S, --save-dir=DIR      Read and write solution files in DIR\n"
+    "  -j, --jobs=N            Search on N threads at once\n"
+    "  -m, --memory=N          Use no more than N megabytes per level\n"
+    "                          (default 256)\n"
+    "  -s, --step=N            Hold each move for N ticks (default 2\n"
+    "                          under MS and 4 under Lynx)\n"
+    "  -t, --time=N            Give up on solutions longer than N\n"
+    "                          seconds\n"
+    "  -a, --all               Search solved levels too, and keep any\n"
+    "                          faster solutions found\n"
+    "  -n, --dry-run           Do not save the solutions found\n"
+    "  -P, --pedantic          Use pedantic Lynx rules\n"
+    "  -h, --help              Display this help and exit\n"
+    "  -v, --version           Display the version and exit\n"
+    "\n"
+    "If LEVEL is given, only that level is searched. The search tries\n"
+    "every move at every step, so the solutions found are the quickest\n"
+    "ones that only change direction on those ticks.\n";
+
+/* The exit status used when the level set cannot be searched at all.
+ */
+#define	EXIT_CANNOTSOLVE	101
+
+/* The values that the user can set on the command line.
+ */
+typedef	struct solvedata {
+    char       *filename;	/* the level set */
+    char const *seriesdir;	/* the level set directory (-L) */
+    char const *seriesdatdir;	/* the data file directory (-D) */
+    char const *savedir;	/* the solution file directory (-S) */
+    int		level;		/* the one level to search, or zero */
+    int		jobs;		/* the number of threads to use */
+    int		memory;		/* the memory budget, in megabytes */
+    int		step;		/* the ticks per move, or zero */
+    int		seconds;	/* the longest solution wanted, or zero */
+    int		all;		/* TRUE to search solved levels too */
+    int		dryrun;		/* TRUE to leave the solution file alone */
+    int		pedantic;	/* TRUE for pedantic Lynx rules */
+} solvedata;
+
+/* Allocate and assemble a directory path based on a root location, a
+ * default subdirectory name, and an optional override value.
+ */
+static char const *choosepath(char const *root, char const *dirname,
+			      char const *override)
+{
+    char       *dir;
+
+    dir = getpathbuffer();
+    if (override && *override)
+	strcpy(dir, override);
+    else
+	combinepath(dir, root, dirname);
+    return dir;
+}
+
+/* Set the directories used for finding level sets and solution files,
+ * using the same defaults as the main program.
+ */
+static void initdirs(solvedata const *data)
+{
+    char const *root;
+    char const *dir;
+    char const *save = data->savedir;
+
+    if (!save && (dir = getenv("TWORLDSAVEDIR")) && *dir)
+	save = dir;
+    if (!(root = getenv("TWORLDDIR")) || !*root) {
+#ifdef ROOTDIR
+	root = ROOTDIR;
+#else
+	root = ".";
+#endif
+    }
+
+    setseriesdir(choosepath(root, "sets", data->seriesdir));
+    setseriesdatdir(choosepath(root, "data", data->seriesdatdir));
+#ifdef SAVEDIR
+    setsavedir(choosepath(SAVEDIR, ".", save));
+#else
+    if ((dir = getenv("HOME")) && *dir)
+	setsavedir(choosepath(dir, ".tworld", save));
+    else
+	setsavedir(choosepath(root, "save", save));
+#endif
+}
+
+/* Basic number-parsing function that silently clamps input to a valid
+ * value.
+ */
+static int nparse(char const *str, int min, int max)
+{
+    int n;
+
+    parseint(str, &n, min);
+    return n < min ? min : n > max ? max : n;
+}
+
+/* Handle one option/argument from the command line.
+ */
+static int processoption(int opt, char const *val, void *ptr)
+{
+    solvedata  *data = ptr;
+
+    switch (opt) {
+      case 0:
+	if (data->level) {
+	    fprintf(stderr, "too many arguments: %s\n", val);
+	    return 1;
+	} else if (*data->filename) {
+	    data->level = nparse(val, 1, 999);
+	} else {
+	    sprintf(data->filename, "%.*s", getpathbufferlen(), val);
+	}
+	break;
+      case 'D':	    data->seriesdatdir = val;			    break;
+      case 'L':	    data->seriesdir = val;			    break;
+      case 'S':	    data->savedir = val;			    break;
+      case 'j':	    data->jobs = nparse(val, 1, MAX_SOLVE_JOBS);    break;
+      case 'm':	    data->memory = nparse(val, 1, 0x7FFFFFFF >> 20);  break;
+      case 's':	    data->step = nparse(val, 1, 16);		    break;
+      case 't':	    data->seconds = nparse(val, 0, 999);	    break;
+      case 'a':	    data->all = !data->all;			    break;
+      case 'n':	    data->dryrun = !data->dryrun;		    break;
+      case 'P':	    data->pedantic = !data->pedantic;		    break;
+      case 'h':	    fputs(usage, stdout);	       exit(EXIT_SUCCESS);
+      case 'v':	    puts(VERSION);		       exit(EXIT_SUCCESS);
+      case ':':
+	fprintf(stderr, "option requires an argument: %s\n", val);
+	return 1;
+      case '=':
+	fprintf(stderr, "option does not take an argument: %s\n", val);
+	return 1;
+      default:
+	fprintf(stderr, "unrecognized option: %s\n", val);
+	return 1;
+    }
+    return 0;
+}
+
+/* Parse the command line.
+ */
+static int getsettings(int argc, char *argv[], solvedata *data)
+{
+    static option const optlist[] = {
+	{ "all",		'a', 'a', 0 },
+	{ "data-dir",		'D', 'D', 1 },
+	{ "dry-run",		'n', 'n', 0 },
+	{ "help",		'h', 'h', 0 },
+	{ "jobs",		'j', 'j', 1 },
+	{ "levelset-dir",	'L', 'L', 1 },
+	{ "memory",		'm', 'm', 1 },
+	{ "pedantic",		'P', 'P', 0 },
+	{ "save-dir",		'S', 'S', 1 },
+	{ "step",		's', 's', 1 },
+	{ "time",		't', 't', 1 },
+	{ "version",		'v', 'v', 0 },
+	{ 0, 0, 0, 0 }
+    };
+
+    data->filename = getpathbuffer();
+    *data->filename = '\0';
+    data->seriesdir = NULL;
+    data->seriesdatdir = NULL;
+    data->savedir = NULL;
+    data->level = 0;
+    data->jobs = 1;
+    data->memory = 256;
+    data->step = 0;
+    data->seconds = 0;
+    data->all = FALSE;
+    data->dryrun = FALSE;
+    data->pedantic = FALSE;
+
+    if (readoptions(optlist, argc, argv, processoption, data)) {
+	fprintf(stderr, "Try --help for more information.\n");
+	return FALSE;
+    }
+    if (!*data->filename) {
+	fputs(usage, stderr);
+	return FALSE;
+    }
+    if (data->pedantic)
+	setpedanticmode();
+    initdirs(data);
+    return TRUE;
+}
+
+/* Search one level and report the outcome. TRUE is returned if a
+ * solution was found.
+ */
+static int solveone(gamesetup *game, int ruleset, solveparams const *params)
+{
+    static char const *outcomes[] = {
+	"solved", "no solution", "no solution within the time limit",
+	"out of memory", "cannot be played"
+    };
+
+    solveresult	result;
+    time_t	start;
+
+    start = time(NULL);
+    solvelevel(game, ruleset, params, &result);
+    printf("Level %3d: %s", game->number, outcomes[result.outcome]);
+    if (result.outcome == Solve_Solved)
+	printf(" in %d.%02d seconds", result.ticks / TICKS_PER_SECOND,
+	       (result.ticks % TICKS_PER_SECOND) * (100 / TICKS_PER_SECOND));
+    printf(" (%ld positions, %ld KB, %.0f s)\n", result.states,
+	   result.memory / 1024, difftime(time(NULL), start));
+    fflush(stdout);
+    return result.outcome == Solve_Solved;
+}
+
+/* Load the level set, search its levels, and save the solutions.
+ */
+int main(int argc, char *argv[])
+{
+    solvedata	data;
+    solveparams	params;
+    gameseries *list;
+    tablespec	table;
+    int		searched, solved;
+    int		count;
+    int		n;
+
+    if (!getsettings(argc, argv, &data))
+	return EXIT_CANNOTSOLVE;
+    if (data.dryrun)
+	setreadonly();
+
+    if (!createserieslist(data.filename, &list, &count, &table))
+	return EXIT_CANNOTSOLVE;
+    if (count != 1) {
+	errmsg(data.filename, count ? "more than one level set matches"
+				    : "no level sets found");
+	return EXIT_CANNOTSOLVE;
+    }
+    if (!readseriesfile(list)) {
+	errmsg(list->filebase, "cannot read level set");
+	return EXIT_CANNOTSOLVE;
+    }
+
+    params.jobs = data.jobs;
+    params.step = data.step ? data.step
+			    : list->ruleset == Ruleset_Lynx ? 4 : 2;
+    params.maxticks = data.seconds * TICKS_PER_SECOND;
+    params.budget = (long)data.memory << 20;
+
+    searched = solved = 0;
+    for (n = 0 ; n < list->count ; ++n) {
+	if (data.level && list->games[n].number != data.level)
+	    continue;
+	if (!data.all && !data.level && hassolution(list->games + n))
+	    continue;
+	++searched;
+	if (solveone(list->games + n, list->ruleset, &params)) {
+	    ++solved;
+	    savesolutions(list);
+	}
+    }
+    if (data.level && !searched)
+	errmsg(list->filebase, "no level %d", data.level);
+    else
+	printf("Solved %d of %d levels searched.\n", solved, searched);
+
+    freeserieslist(list, count, &table);
+    shutdowngamestate();
+    return searched && solved == searched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,251 @@
+/* twverify.c: Verifying solution files without a user interface.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+/* This program plays back every solution in a solution file and
+ * reports the ones that fail, exactly as "tworld --batch-verify"
+ * does. It is linked with the null OS/hardware layer instead of SDL,
+ * so it can be run on machines without a display, and it never
+ * initializes the graphics, sound, or keyboard. The solution file is
+ * never modified.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"series.h"
+#include	"solution.h"
+#include	"play.h"
+#include	"verify.h"
+#include	"cmdline.h"
+#include	"ver.h"
+
+/* The online help.
+ */
+static char const *usage =
+    "Usage: twverify [OPTIONS] LEVELSET [SOLUTIONFILE]\n"
+    "       twverify [OPTIONS] SOLUTIONFILE\n"
+    "Play back the solutions for a level set and report the invalid ones.\n"
+    "\n"
+    "  -D, --data-dir=DIR      Read data files from DIR\n"
+    "  -L, --levelset-dir=DIR  Read level sets from DIR\n"
+    "  -S, --save-dir=DIR      Read solution files from DIR\n"
+    "  -j, --jobs=N            Verify on N threads at once\n"
+    "      --no-cache          Play back every solution, instead of\n"
+    "                          reusing the results of earlier runs\n"
+    "  -P, --pedantic          Use pedantic Lynx rules\n"
+    "  -q, --quiet             Report only through the exit status\n"
+    "  -h, --help              Display this help and exit\n"
+    "  -v, --version           Display the version and exit\n"
+    "\n"
+    "The results are remembered in the solution file directory, so\n"
+    "that unchanged solutions need not be played back again.\n"
+    "The exit status is the number of invalid solutions (at most 100),\n"
+    "or 101 if the level set could not be read.\n";
+
+/* The exit status used when nothing could be verified.
+ */
+#define	EXIT_CANNOTVERIFY	101
+
+/* The values that the user can set on the command line.
+ */
+typedef	struct verifydata {
+    char       *filename;	/* the level set or solution file */
+    char       *savefilename;	/* the solution file, if given */
+    char const *seriesdir;	/* the level set directory (-L) */
+    char const *seriesdatdir;	/* the data file directory (-D) */
+    char const *savedir;	/* the solution file directory (-S) */
+    int		jobs;		/* the number of threads to use */
+    int		nocache;	/* TRUE to ignore earlier results */
+    int		pedantic;	/* TRUE for pedantic Lynx rules */
+    int		quiet;		/* TRUE to suppress the report */
+} verifydata;
+
+/* Allocate and assemble a directory path based on a root location, a
+ * default subdirectory name, and an optional override value.
+ */
+static char const *choosepath(char const *root, char const *dirname,
+			      char const *override)
+{
+    char       *dir;
+
+    dir = getpathbuffer();
+    if (override && *override)
+	strcpy(dir, override);
+    else
+	combinepath(dir, root, dirname);
+    return dir;
+}
+
+/* Set the directories used for finding level sets and solution files,
+ * using the same defaults as the main program.
+ */
+static void initdirs(verifydata const *data)
+{
+    char const *root;
+    char const *dir;
+    char const *save = data->savedir;
+
+    if (!save && (dir = getenv("TWORLDSAVEDIR")) && *dir)
+	save = dir;
+    if (!(root = getenv("TWORLDDIR")) || !*root) {
+#ifdef ROOTDIR
+	root = ROOTDIR;
+#else
+	root = ".";
+#endif
+    }
+
+    setseriesdir(choosepath(root, "sets", data->seriesdir));
+    setseriesdatdir(choosepath(root, "data", data->seriesdatdir));
+#ifdef SAVEDIR
+    setsavedir(choosepath(SAVEDIR, ".", save));
+#else
+    if ((dir = getenv("HOME")) && *dir)
+	setsavedir(choosepath(dir, ".tworld", save));
+    else
+	setsavedir(choosepath(root, "save", save));
+#endif
+}
+
+/* Basic number-parsing function that silently clamps input to a valid
+ * value.
+ */
+static int nparse(char const *str, int min, int max)
+{
+    int n;
+
+    parseint(str, &n, min);
+    return n < min ? min : n > max ? max : n;
+}
+
+/* Handle one option/argument from the command line.
+ */
+static int processoption(int opt, char const *val, void *ptr)
+{
+    verifydata *data = ptr;
+
+    switch (opt) {
+      case 0:
+	if (data->savefilename) {
+	    fprintf(stderr, "too many arguments: %s\n", val);
+	    return 1;
+	} else if (*data->filename) {
+	    data->savefilename = getpathbuffer();
+	    sprintf(data->savefilename, "%.*s", getpathbufferlen(), val);
+	} else {
+	    sprintf(data->filename, "%.*s", getpathbufferlen(), val);
+	}
+	break;
+      case 'D':	    data->seriesdatdir = val;			    break;
+      case 'L':	    data->seriesdir = val;			    break;
+      case 'S':	    data->savedir = val;			    break;
+      case 'j':	    data->jobs = nparse(val, 1, MAX_VERIFY_JOBS);   break;
+      case 'C':	    data->nocache = !data->nocache;		    break;
+      case 'P':	    data->pedantic = !data->pedantic;		    break;
+      case 'q':	    data->quiet = !data->quiet;			    break;
+      case 'h':	    fputs(usage, stdout);	       exit(EXIT_SUCCESS);
+      case 'v':	    puts(VERSION);		       exit(EXIT_SUCCESS);
+      case ':':
+	fprintf(stderr, "option requires an argument: %s\n", val);
+	return 1;
+      case '=':
+	fprintf(stderr, "option does not take an argument: %s\n", val);
+	return 1;
+      default:
+	fprintf(stderr, "unrecognized option: %s\n", val);
+	return 1;
+    }
+    return 0;
+}
+
+/* Parse the command line.
+ */
+static int getsettings(int argc, char *argv[], verifydata *data)
+{
+    static option const optlist[] = {
+	{ "data-dir",		'D', 'D', 1 },
+	{ "help",		'h', 'h', 0 },
+	{ "jobs",		'j', 'j', 1 },
+	{ "levelset-dir",	'L', 'L', 1 },
+	{ "no-cache",		 0 , 'C', 0 },
+	{ "pedantic",		'P', 'P', 0 },
+	{ "quiet",		'q', 'q', 0 },
+	{ "save-dir",		'S', 'S', 1 },
+	{ "version",		'v', 'v', 0 },
+	{ 0, 0, 0, 0 }
+    };
+
+    char	buf[256];
+
+    data->filename = getpathbuffer();
+    *data->filename = '\0';
+    data->savefilename = NULL;
+    data->seriesdir = NULL;
+    data->seriesdatdir = NULL;
+    data->savedir = NULL;
+    data->jobs = 1;
+    data->nocache = FALSE;
+    data->pedantic = FALSE;
+    data->quiet = FALSE;
+
+    if (readoptions(optlist, argc, argv, processoption, data)) {
+	fprintf(stderr, "Try --help for more information.\n");
+	return FALSE;
+    }
+    if (!*data->filename) {
+	fputs(usage, stderr);
+	return FALSE;
+    }
+    if (data->pedantic)
+	setpedanticmode();
+    initdirs(data);
+
+    if (!data->savefilename) {
+	if (loadsolutionsetname(data->filename, buf) > 0) {
+	    data->savefilename = getpathbuffer();
+	    strcpy(data->savefilename, data->filename);
+	    strcpy(data->filename, buf);
+	}
+    }
+    return TRUE;
+}
+
+/* Load the level set and its solutions, and verify them.
+ */
+int main(int argc, char *argv[])
+{
+    verifydata	data;
+    gameseries *list;
+    tablespec	table;
+    int		count;
+    int		n;
+
+    if (!getsettings(argc, argv, &data))
+	return EXIT_CANNOTVERIFY;
+    setreadonly();
+
+    if (!createserieslist(data.filename, &list, &count, &table))
+	return EXIT_CANNOTVERIFY;
+    if (count != 1) {
+	errmsg(data.filename, count ? "more than one level set matches"
+				    : "no level sets found");
+	return EXIT_CANNOTVERIFY;
+    }
+    if (data.savefilename)
+	list->savefilename = data.savefilename;
+    if (!readseriesfile(list)) {
+	errmsg(list->filebase, "cannot read level set");
+	return EXIT_CANNOTVERIFY;
+    }
+
+    n = batchverify(list, data.jobs, !data.quiet, !data.nocache);
+    freeserieslist(list, count, &table);
+    shutdowngamestate();
+    return n > 100 ? 100 : n;
+}
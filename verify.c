@@ -0,0 +1,498 @@
+/* verify.c: Checking the user's solutions without a user interface.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<pthread.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"play.h"
+#include	"solution.h"
+#include	"verify.h"
+
+/* The levels that one worker thread has yet to verify, as a range of
+ * indexes into the series.
+ */
+typedef	struct verifyworker {
+    struct verifybatch *batch;		/* the batch this worker is part of */
+    int			next;		/* the next level to verify */
+    int			end;		/* one past the last level to verify */
+    pthread_t		thread;		/* the worker's thread */
+} verifyworker;
+
+/* The data shared by all of the worker threads during a batch
+ * verification.
+ */
+typedef	struct verifybatch {
+    gameseries	       *series;		/* the levels being verified */
+    signed char	       *results;	/* the outcome for each level */
+    errlog	       *logs;		/* messages issued for each level */
+    verifyworker       *workers;	/* the array of workers */
+    int			jobs;		/* the number of workers */
+    pthread_mutex_t	lock;		/* protects the workers' ranges */
+} verifybatch;
+
+/* Play back the user's solution for a single level, in the currently
+ * selected game, without rendering or using the timer or the
+ * keyboard. The return value is positive if the solution is valid,
+ * negative if it is invalid, and zero if it could not be played back.
+ */
+int verifylevel(gamesetup *game, int ruleset)
+{
+    int	f = 0;
+
+    if (initgamestate(game, ruleset, FALSE) && prepareplayback()) {
+	setgameplaymode(BeginVerify);
+	while (!(f = doturn(CmdNone))) ;
+	setgameplaymode(EndVerify);
+	if (f > 0)
+	    checksolution();
+	else
+	    game->sgflags |= SGF_REPLACEABLE;
+    }
+    endgamestate();
+    return f;
+}
+
+/*
+ * Remembering the results of earlier runs.
+ */
+
+/* The file in the user's save directory that records the outcome of
+ * every solution verified on earlier runs. A result is only reused if
+ * the level, the solution, the ruleset, and the version of the game
+ * logic are all unchanged, in which case playing the solution again
+ * could not turn out any differently. The file holds no solutions,
+ * so it is kept up to date unless the caches are read-only.
+ */
+#define	VERIFYCACHE_NAME	".verifycache"
+#define	VERIFYCACHE_SIG		"tworld verify cache 1"
+
+/* What identifies one verification.
+ */
+typedef	struct verifykey {
+    unsigned long	build;		/* the version of the game logic */
+    unsigned long	levelhash;	/* the hash of the level's data */
+    unsigned long	solutioncrc;	/* the CRC-32 of the solution data */
+    int			ruleset;	/* the ruleset played under */
+    int			lynxfixes;	/* TRUE if the level was altered */
+} verifykey;
+
+/* The outcome of one verification.
+ */
+typedef	struct verifyentry {
+    verifykey		key;		/* what was verified */
+    int			valid;		/* positive if valid, else negative */
+    int			besttime;	/* the solution's corrected time */
+} verifyentry;
+
+/* The contents of the cache file.
+ */
+typedef	struct verifycache {
+    verifyentry	       *list;		/* the entries, sorted by key */
+    int			count;		/* the number of entries */
+    int			allocated;	/* the size of the array */
+    int			changed;	/* TRUE if the file needs rewriting */
+} verifycache;
+
+/* Return the CRC-32 of a block of data.
+ */
+static unsigned long solutioncrc(unsigned char const *data,
+				 unsigned long size)
+{
+    static unsigned long	crctable[256];
+    unsigned long		crc, c;
+    int				n, k;
+
+    if (!crctable[1]) {
+	for (n = 0 ; n < 256 ; ++n) {
+	    c = n;
+	    for (k = 0 ; k < 8 ; ++k)
+		c = c & 1 ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+	    crctable[n] = c;
+	}
+    }
+    crc = 0xFFFFFFFFUL;
+    while (size--)
+	crc = crctable[(crc ^ *data++) & 255] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFUL;
+}
+
+/* A callback function to compare two cache entries by their keys.
+ */
+static int verifyentrycmp(void const *a, void const *b)
+{
+    verifykey const    *ka = &((verifyentry const*)a)->key;
+    verifykey const    *kb = &((verifyentry const*)b)->key;
+
+    if (ka->levelhash != kb->levelhash)
+	return ka->levelhash < kb->levelhash ? -1 : +1;
+    if (ka->solutioncrc != kb->solutioncrc)
+	return ka->solutioncrc < kb->solutioncrc ? -1 : +1;
+    if (ka->build != kb->build)
+	return ka->build < kb->build ? -1 : +1;
+    if (ka->ruleset != kb->ruleset)
+	return ka->ruleset - kb->ruleset;
+    return ka->lynxfixes - kb->lynxfixes;
+}
+
+/* Add an entry to the cache, without sorting it into place.
+ */
+static void addverifyentry(verifycache *cache, verifyentry const *entry)
+{
+    if (cache->count >= cache->allocated) {
+	cache->allocated = cache->allocated ? 2 * cache->allocated : 256;
+	xalloc(cache->list, cache->allocated * sizeof *cache->list);
+    }
+    cache->list[cache->count++] = *entry;
+}
+
+/* Read the cache file from the user's save directory. Entries made by
+ * other builds of the game logic can never be used again, and so are
+ * dropped. The cache is left empty if the file is absent or
+ * unrecognized; a damaged entry causes it and the entries after it
+ * to be ignored.
+ */
+static void loadverifycache(verifycache *cache, unsigned long build)
+{
+    fileinfo		file;
+    verifyentry		entry;
+    char const	       *savedir;
+    char		buf[256];
+    int			n;
+
+    memset(cache, 0, sizeof *cache);
+    savedir = getsavedir();
+    if (!savedir || !*savedir)
+	return;
+    clearfileinfo(&file);
+    if (!openfileindir(&file, savedir, VERIFYCACHE_NAME, "r", NULL))
+	return;
+
+    n = sizeof buf - 1;
+    if (!filegetline(&file, buf, &n, NULL))
+	n = 0;
+    buf[n] = '\0';
+    if (!strcmp(buf, VERIFYCACHE_SIG)) {
+	for (;;) {
+	    n = sizeof buf - 1;
+	    if (!filegetline(&file, buf, &n, NULL))
+		break;
+	    buf[n] = '\0';
+	    if (sscanf(buf, "%lx %d %d %lx %lx %d %d", &entry.key.build,
+			    &entry.key.ruleset, &entry.key.lynxfixes,
+			    &entry.key.levelhash, &entry.key.solutioncrc,
+			    &entry.valid, &entry.besttime) < 7)
+		break;
+	    if (entry.key.build != build)
+		cache->changed = TRUE;
+	    else
+		addverifyentry(cache, &entry);
+	}
+    } else {
+	cache->changed = TRUE;
+    }
+    fileclose(&file, NULL);
+    if (cache->count > 1)
+	qsort(cache->list, cache->count, sizeof *cache->list,
+	      verifyentrycmp);
+}
+
+/* Write the cache to the user's save directory, if it has changed.
+ * The entries are sorted and duplicates removed first.
+ */
+static void saveverifycache(verifycache *cache)
+{
+    fileinfo	file;
+    char const *savedir;
+    char       *path;
+    char       *tmpname;
+    char	buf[256];
+    int		f, i, n;
+
+    if (!cache->changed)
+	return;
+    if (cache->count > 1)
+	qsort(cache->list, cache->count, sizeof *cache->list,
+	      verifyentrycmp);
+    for (i = n = 0 ; i < cache->count ; ++i)
+	if (!n || verifyentrycmp(cache->list + i, cache->list + n - 1))
+	    cache->list[n++] = cache->list[i];
+    cache->count = n;
+
+    savedir = getsavedir();
+    if (iscachereadonly() || !savedir || !*savedir || !finddir(savedir))
+	return;
+    if (!(path = getpathforfileindir(savedir, VERIFYCACHE_NAME)))
+	return;
+    tmpname = NULL;
+    xalloc(tmpname, strlen(path) + 5);
+    sprintf(tmpname, "%s.tmp", path);
+
+    clearfileinfo(&file);
+    f = fileopen(&file, tmpname, "w", NULL);
+    if (f) {
+	n = sprintf(buf, "%s\n", VERIFYCACHE_SIG);
+	f = filewrite(&file, buf, n, NULL);
+	for (i = 0 ; f && i < cache->count ; ++i) {
+	    n = sprintf(buf, "%08lx %d %d %08lx %08lx %d %d\n",
+			cache->list[i].key.build, cache->list[i].key.ruleset,
+			cache->list[i].key.lynxfixes,
+			cache->list[i].key.levelhash,
+			cache->list[i].key.solutioncrc,
+			cache->list[i].valid, cache->list[i].besttime);
+	    f = filewrite(&file, buf, n, NULL);
+	}
+	if (f) {
+	    filereplace(&file, path, NULL);
+	} else {
+	    fileclose(&file, NULL);
+	    remove(tmpname);
+	}
+    }
+    free(tmpname);
+    free(path);
+}
+
+/* Fill in the key that identifies the verification of a level's
+ * solution.
+ */
+static void makeverifykey(gameseries const *series, gamesetup const *game,
+			  unsigned long build, verifykey *key)
+{
+    key->build = build;
+    key->levelhash = game->levelhash;
+    key->solutioncrc = solutioncrc(game->solutiondata, game->solutionsize);
+    key->ruleset = series->ruleset;
+    key->lynxfixes = (series->gsflags & GSF_LYNXFIXES) ? TRUE : FALSE;
+}
+
+/* Look up each solution in the series in the cache, and store the
+ * result of every one found, just as verifylevel() would have. The
+ * keys of all the solutions are stored in keys. The number of
+ * solutions found is returned.
+ */
+static int usecachedresults(verifycache const *cache, gameseries *series,
+			    verifykey *keys, signed char *results)
+{
+    verifyentry const  *entry;
+    verifyentry		probe;
+    gamesetup	       *game;
+    unsigned long	build;
+    int			hits = 0;
+    int			i;
+
+    build = enginebuildid();
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	if (!hassolution(game))
+	    continue;
+	makeverifykey(series, game, build, keys + i);
+	if (!cache->count)
+	    continue;
+	probe.key = keys[i];
+	entry = bsearch(&probe, cache->list, cache->count,
+			sizeof *cache->list, verifyentrycmp);
+	if (!entry)
+	    continue;
+	results[i] = entry->valid;
+	if (entry->valid > 0)
+	    game->besttime = entry->besttime;
+	else
+	    game->sgflags |= SGF_REPLACEABLE;
+	++hits;
+    }
+    return hits;
+}
+
+/*
+ * Verifying levels in parallel.
+ */
+
+/* Return the index of the next level for the given worker to verify,
+ * or -1 if no work remains. A worker that runs out of levels of its
+ * own steals the latter half of the largest remaining range, so that
+ * one slow level does not hold up the levels queued behind it.
+ */
+static int takelevel(verifyworker *worker)
+{
+    verifybatch	       *batch = worker->batch;
+    verifyworker       *victim;
+    int			i, n;
+
+    pthread_mutex_lock(&batch->lock);
+    if (worker->next >= worker->end) {
+	victim = NULL;
+	for (i = 0 ; i < batch->jobs ; ++i)
+	    if (!victim || batch->workers[i].end - batch->workers[i].next
+					> victim->end - victim->next)
+		victim = batch->workers + i;
+	n = victim->end - victim->next;
+	if (n > 0) {
+	    worker->end = victim->end;
+	    victim->end -= (n + 1) / 2;
+	    worker->next = victim->end;
+	}
+    }
+    n = worker->next < worker->end ? worker->next++ : -1;
+    pthread_mutex_unlock(&batch->lock);
+    return n;
+}
+
+/* The body of a worker thread. Each worker plays back its levels in a
+ * game of its own. The messages issued for each level are held back,
+ * so that they can be shown in the order of the levels.
+ */
+static void *verifythread(void *data)
+{
+    verifyworker       *worker = data;
+    gameseries	       *series = worker->batch->series;
+    gameplay	       *gp;
+    int			n;
+
+    gp = creategameplay();
+    selectgameplay(gp);
+    while ((n = takelevel(worker)) >= 0) {
+	if (hassolution(series->games + n) && !worker->batch->results[n]) {
+	    holdmessages(worker->batch->logs + n);
+	    worker->batch->results[n] = verifylevel(series->games + n,
+						    series->ruleset);
+	    holdmessages(NULL);
+	}
+    }
+    destroygameplay(gp);
+    return NULL;
+}
+
+/* Verify every level of the series, distributing the levels among
+ * the given number of worker threads. The outcome for each level is
+ * stored in the results array. FALSE is returned if the threads could
+ * not be started.
+ */
+static int runverifybatch(gameseries *series, signed char *results, int jobs)
+{
+    verifybatch	batch;
+    int		i, n;
+
+    batch.series = series;
+    batch.results = results;
+    batch.jobs = jobs;
+    batch.workers = malloc(jobs * sizeof *batch.workers);
+    batch.logs = calloc(series->count, sizeof *batch.logs);
+    if (!batch.workers || !batch.logs)
+	memerrexit();
+    pthread_mutex_init(&batch.lock, NULL);
+
+    for (i = 0 ; i < jobs ; ++i) {
+	batch.workers[i].batch = &batch;
+	batch.workers[i].next = (series->count * i) / jobs;
+	batch.workers[i].end = (series->count * (i + 1)) / jobs;
+    }
+    for (n = 0 ; n < jobs ; ++n) {
+	if (pthread_create(&batch.workers[n].thread, NULL,
+			   verifythread, batch.workers + n)) {
+	    errmsg(NULL, "unable to start verification thread");
+	    break;
+	}
+    }
+    if (n < jobs) {
+	pthread_mutex_lock(&batch.lock);
+	for (i = 0 ; i < jobs ; ++i)
+	    batch.workers[i].end = batch.workers[i].next;
+	pthread_mutex_unlock(&batch.lock);
+    }
+    for (i = 0 ; i < n ; ++i)
+	pthread_join(batch.workers[i].thread, NULL);
+    for (i = 0 ; i < series->count ; ++i)
+	showheldmessages(batch.logs + i);
+
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.workers);
+    free(batch.logs);
+    return n == jobs;
+}
+
+/* Quickly play back all of the user's solutions in the series without
+ * rendering or using the timer or the keyboard. If jobs is greater
+ * than one, the levels are divided among that many threads. If
+ * usecache is TRUE, the results of earlier runs are reused where
+ * possible, and the new results are remembered. If display is TRUE,
+ * the solutions that cannot be verified are reported to stdout. The
+ * return value is the number of invalid solutions found.
+ */
+int batchverify(gameseries *series, int jobs, int display, int usecache)
+{
+    verifycache		cache;
+    verifyentry		entry;
+    gamesetup	       *game;
+    verifykey	       *keys = NULL;
+    signed char	       *results;
+    int			valid = 0, invalid = 0, hits = 0, misses = 0;
+    int			i, n;
+
+    results = calloc(series->count + 1, 1);
+    if (!results)
+	memerrexit();
+    if (usecache) {
+	keys = calloc(series->count + 1, sizeof *keys);
+	if (!keys)
+	    memerrexit();
+	loadverifycache(&cache, enginebuildid());
+	hits = usecachedresults(&cache, series, keys, results);
+    }
+    if (jobs > series->count)
+	jobs = series->count;
+    if (jobs <= 1 || !runverifybatch(series, results, jobs)) {
+	for (i = 0, game = series->games ; i < series->count ; ++i, ++game)
+	    if (hassolution(game) && !results[i])
+		results[i] = verifylevel(game, series->ruleset);
+    }
+    if (usecache) {
+	n = cache.count;
+	for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	    if (!hassolution(game) || !results[i])
+		continue;
+	    entry.key = keys[i];
+	    if (n && bsearch(&entry, cache.list, n, sizeof *cache.list,
+			     verifyentrycmp))
+		continue;
+	    entry.valid = results[i];
+	    entry.besttime = game->besttime;
+	    addverifyentry(&cache, &entry);
+	    cache.changed = TRUE;
+	    ++misses;
+	}
+	saveverifycache(&cache);
+	free(cache.list);
+	free(keys);
+    }
+
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	if (results[i] > 0) {
+	    ++valid;
+	} else if (results[i] < 0) {
+	    ++invalid;
+	    if (display)
+		printf("Solution for level %d is invalid\n", game->number);
+	}
+    }
+    free(results);
+
+    if (display) {
+	if (valid + invalid == 0) {
+	    printf("No solutions were found.\n");
+	} else {
+	    printf("  Valid solutions:%4d\n", valid);
+	    printf("Invalid solutions:%4d\n", invalid);
+	    if (usecache) {
+		printf("   Cached results:%4d\n", hits);
+		printf(" Uncached results:%4d\n", misses);
+	    }
+	}
+    }
+    return invalid;
+}
@@ -0,0 +1,36 @@
+/* verify.h: Checking the user's solutions without a user interface.
+ *
+ * Copyright (C) 2001-2006 by Brian Raiter, under the GNU General Public
+ * License. No warranty. See COPYING for details.
+ */
+
+#ifndef	_verify_h_
+#define	_verify_h_
+
+#include	"defs.h"
+
+/* The most threads that batch verification will use.
+ */
+#define	MAX_VERIFY_JOBS		64
+
+/* Play back the user's solution for a single level, in the calling
+ * thread's selected game. The return value is positive if the
+ * solution is valid, in which case the level's best time is updated,
+ * negative if it is invalid, and zero if it could not be played back.
+ */
+extern int verifylevel(gamesetup *game, int ruleset);
+
+/* Quickly play back all of the user's solutions in the series without
+ * rendering or using the timer or the keyboard. If jobs is greater
+ * than one, the levels are divided among that many threads. If
+ * usecache is TRUE, a solution that was verified on an earlier run,
+ * with the same level data and the same version of the game logic, is
+ * not played again; the earlier result is used instead. If display
+ * is TRUE, the solutions that cannot be verified are reported to
+ * stdout, along with the number of results taken from the cache. The
+ * return value is the number of invalid solutions found.
+ */
+extern int batchverify(gameseries *series, int jobs, int display,
+		       int usecache);
+
+#endif